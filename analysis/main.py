@@ -40,6 +40,29 @@ def computeMPKI(path):
 
     return (misses/intructions) * 1000
 
+def computeDRAMEnergy(path):
+    # Total DRAM energy in pJ over all memory controllers (DDR only), from the last stats dump
+    f = h5py.File(path, "r")
+
+    dset = f["stats"]["root"]
+    stats = dset[-1]
+
+    mems = [name for name in stats.dtype.names if name.startswith("mem-") and "power" in stats[name].dtype.names]
+    return np.sum([np.sum(stats[m]["power"]["energy"]) for m in mems])
+
+def loadTraceSummary(prefix):
+    # Loads the CSVs written by zsim's analyzetrace tool (<prefix>.{rd,wss,rw,sharing}.csv)
+    # In rd and rw, child == -1 is the global summary; in rd, bucket == -1 counts cold accesses
+    return {kind: pd.read_csv(prefix + "." + kind + ".csv") for kind in ["rd", "wss", "rw", "sharing"]}
+
+def computeRDCurve(summary, child=-1):
+    # Fraction of non-cold accesses with reuse distance below each bucket's upper bound (in lines),
+    # i.e., an LRU hit-rate curve over capacity
+    rd = summary["rd"]
+    rd = rd[(rd["child"] == child) & (rd["bucket"] >= 0)].sort_values("bucket")
+    total = rd["accesses"].sum()
+    return (rd["minLines"] * 2).clip(lower=1).values, (rd["accesses"].cumsum() / max(total, 1)).values
+
 def computeSpeedUp(replc1, replc2):
     return replc1 / replc2
 
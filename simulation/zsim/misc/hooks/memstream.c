@@ -0,0 +1,106 @@
+/* Memory-intensive microbenchmark to stress the memory controller models.
+ *   lbm: D3Q19-like stencil, each cell reads 19 neighbors spread over 3
+ *        planes of a large grid and writes a second grid (many concurrent
+ *        streams, mixed reads and writes)
+ *   libquantum: toggles a bit in every element of a large array of 16-byte
+ *        structs (one read-modify-write stream)
+ * Usage: memstream <lbm|libquantum> [MB per array] [iterations]
+ * The simulated region is marked with ROI hooks.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zsim_hooks.h"
+
+typedef struct {
+    uint64_t state;
+    double amplitude;
+} qnode;
+
+static double lbm(uint64_t bytes, uint32_t iters) {
+    uint64_t dim = 64;  // cells per row; planes are dim*dim cells
+    uint64_t cells = bytes/sizeof(double);
+    uint64_t plane = dim*dim;
+    double* src = (double*)malloc(cells*sizeof(double));
+    double* dst = (double*)malloc(cells*sizeof(double));
+    for (uint64_t i = 0; i < cells; i++) src[i] = dst[i] = (double)(i & 255);
+
+    // 19 neighbors: the cell, 6 faces and 12 edges of a 3x3x3 cube
+    int64_t offs[19];
+    uint32_t n = 0;
+    for (int64_t z = -1; z <= 1; z++) {
+        for (int64_t y = -1; y <= 1; y++) {
+            for (int64_t x = -1; x <= 1; x++) {
+                int64_t dist = (x != 0) + (y != 0) + (z != 0);
+                if (dist <= 2) offs[n++] = z*plane + y*dim + x;
+            }
+        }
+    }
+
+    zsim_roi_begin();
+    for (uint32_t it = 0; it < iters; it++) {
+        for (uint64_t i = plane + dim + 1; i < cells - plane - dim - 1; i++) {
+            double sum = 0.0;
+            for (uint32_t k = 0; k < 19; k++) sum += src[i + offs[k]];
+            dst[i] = sum*(1.0/19.0);
+        }
+        double* tmp = src;
+        src = dst;
+        dst = tmp;
+        zsim_heartbeat();
+    }
+    zsim_roi_end();
+
+    double res = src[cells/2];
+    free(src);
+    free(dst);
+    return res;
+}
+
+static double libquantum(uint64_t bytes, uint32_t iters) {
+    uint64_t nodes = bytes/sizeof(qnode);
+    qnode* reg = (qnode*)malloc(nodes*sizeof(qnode));
+    for (uint64_t i = 0; i < nodes; i++) {
+        reg[i].state = i;
+        reg[i].amplitude = 1.0;
+    }
+
+    zsim_roi_begin();
+    for (uint32_t it = 0; it < iters; it++) {
+        uint64_t control = 1ul << (it % 16);
+        uint64_t target = 1ul << ((it + 5) % 16);
+        for (uint64_t i = 0; i < nodes; i++) {
+            if (reg[i].state & control) reg[i].state ^= target;  // like quantum_toffoli/cnot
+        }
+        zsim_heartbeat();
+    }
+    zsim_roi_end();
+
+    double res = (double)reg[nodes/2].state;
+    free(reg);
+    return res;
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <lbm|libquantum> [MB per array] [iterations]\n", argv[0]);
+        return 1;
+    }
+    uint64_t mb = (argc > 2)? strtoul(argv[2], NULL, 0) : 64;
+    uint32_t iters = (argc > 3)? strtoul(argv[3], NULL, 0) : 4;
+    uint64_t bytes = mb << 20;
+
+    double res;
+    if (strcmp(argv[1], "lbm") == 0) {
+        res = lbm(bytes, iters);
+    } else if (strcmp(argv[1], "libquantum") == 0) {
+        res = libquantum(bytes, iters);
+    } else {
+        printf("Unknown mode %s\n", argv[1]);
+        return 1;
+    }
+    printf("memstream %s done (%.3f)\n", argv[1], res);
+    return 0;
+}
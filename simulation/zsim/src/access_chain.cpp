@@ -0,0 +1,77 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "access_chain.h"
+#include "event_recorder.h"
+#include "timing_event.h"
+
+AccessChain::Point AccessChain::delay(Point p, uint32_t cycles) {
+    if (!evRec) return {nullptr, p.cycle + cycles};
+    DelayEvent* dEv = new (evRec) DelayEvent(cycles);
+    dEv->setMinStartCycle(p.cycle);
+    link(p, dEv, p.cycle);
+    return {dEv, p.cycle + cycles};
+}
+
+AccessChain::Point AccessChain::append(Point p, uint64_t reqCycle, uint64_t respCycle) {
+    assert(reqCycle >= p.cycle && respCycle >= reqCycle);
+    if (!evRec) return {nullptr, respCycle};
+    if (!evRec->hasRecord()) return delay(p, respCycle - p.cycle);  // e.g., a fixed-latency memory
+    TimingRecord r = evRec->popRecord();
+    assert(r.reqCycle == reqCycle && r.respCycle == respCycle);
+    link(p, r.startEvent, r.reqCycle);
+    return {r.endEvent, r.respCycle};
+}
+
+AccessChain::Point AccessChain::append(Point p, TimingEvent* ev, uint32_t minLatency) {
+    if (!evRec) return {nullptr, p.cycle + minLatency};
+    ev->setMinStartCycle(p.cycle);
+    link(p, ev, p.cycle);
+    return {ev, p.cycle + minLatency};
+}
+
+void AccessChain::finish(const MemReq& req, Point end) {
+    if (!evRec) return;
+    assert(startEv && end.ev);
+    TimingRecord tr = {req.lineAddr, req.cycle, end.cycle, req.type, startEv, end.ev};
+    evRec->pushRecord(tr);
+}
+
+void AccessChain::link(Point p, TimingEvent* ev, uint64_t evCycle) {
+    assert(evCycle >= p.cycle);
+    TimingEvent* first = ev;
+    if (evCycle > p.cycle) {
+        DelayEvent* dEv = new (evRec) DelayEvent(evCycle - p.cycle);
+        dEv->setMinStartCycle(p.cycle);
+        dEv->addChild(ev, evRec);
+        first = dEv;
+    }
+    if (p.ev) {
+        p.ev->addChild(first, evRec);
+    } else {
+        assert(!startEv);  // only one chain can start the access
+        startEv = first;
+    }
+}
@@ -0,0 +1,68 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACCESS_CHAIN_H_
+#define ACCESS_CHAIN_H_
+
+#include <stdint.h>
+#include "memory_hierarchy.h"
+
+class EventRecorder;
+class TimingEvent;
+
+/* Builds the timing record of an access made of several sub-accesses (e.g.,
+ * DRAM cache tiers, or NoC traversals around a cache access): each
+ * sub-access's record runs after a point (an earlier event), with delays to
+ * match the bound-phase cycles. Without an event recorder, it just tracks
+ * cycles.
+ */
+class AccessChain {
+    public:
+        struct Point {
+            TimingEvent* ev;  // nullptr at the start of the access
+            uint64_t cycle;
+        };
+
+    private:
+        EventRecorder* const evRec;
+        TimingEvent* startEv;
+
+    public:
+        explicit AccessChain(EventRecorder* _evRec) : evRec(_evRec), startEv(nullptr) {}
+
+        Point begin(uint64_t cycle) const {return {nullptr, cycle};}
+        Point delay(Point p, uint32_t cycles);
+        // Chains the record of the sub-access that was just made (from reqCycle to respCycle) after p
+        Point append(Point p, uint64_t reqCycle, uint64_t respCycle);
+        // Chains an event that starts at p and takes at least minLatency cycles
+        Point append(Point p, TimingEvent* ev, uint32_t minLatency);
+        // Pushes the access's record, which ends at end
+        void finish(const MemReq& req, Point end);
+
+    private:
+        void link(Point p, TimingEvent* ev, uint64_t evCycle);
+};
+
+#endif  // ACCESS_CHAIN_H_
@@ -53,6 +53,21 @@ AccessTraceReader::AccessTraceReader(std::string _fname) : fname(_fname.c_str())
     H5Aread(ncAttr, H5T_NATIVE_UINT, &numChildren);
     H5Aclose(ncAttr);
 
+    // Older traces have no sample scale, they are never sampled
+    sampleScale = 1;
+    if (H5Aexists(fid, "sampleScale") > 0) {
+        hid_t ssAttr = H5Aopen(fid, "sampleScale", H5P_DEFAULT);
+        H5Aread(ssAttr, H5T_NATIVE_UINT, &sampleScale);
+        H5Aclose(ssAttr);
+        if (!sampleScale) panic("Trace file %s has an invalid sample scale (0)", fname.c_str());
+    }
+    sampledSets = 0;
+    if (H5Aexists(fid, "sampledSets") > 0) {
+        hid_t sAttr = H5Aopen(fid, "sampledSets", H5P_DEFAULT);
+        H5Aread(sAttr, H5T_NATIVE_UINT, &sampledSets);
+        H5Aclose(sAttr);
+    }
+
     curFrameRecord = 0;
     cur = 0;
     max = MIN(PT_CHUNKSIZE, numRecords);
@@ -86,7 +101,7 @@ void AccessTraceReader::nextChunk() {
 }
 
 
-AccessTraceWriter::AccessTraceWriter(g_string _fname, uint32_t numChildren) : fname(_fname) {
+AccessTraceWriter::AccessTraceWriter(g_string _fname, uint32_t numChildren, uint32_t sampleScale, uint32_t sampledSets) : fname(_fname) {
     // Create record structure
     hid_t accType = H5Tenum_create(H5T_NATIVE_USHORT);
     uint16_t val;
@@ -137,6 +152,17 @@ AccessTraceWriter::AccessTraceWriter(g_string _fname, uint32_t numChildren) : fn
     H5Awrite(ncAttr, H5T_NATIVE_UINT, &numChildren);
     H5Aclose(ncAttr);
 
+    assert(sampleScale > 0);
+    hid_t ssAttr = H5Acreate2(fid, "sampleScale", H5T_NATIVE_UINT, H5Screate(H5S_SCALAR), H5P_DEFAULT, H5P_DEFAULT);
+    H5Awrite(ssAttr, H5T_NATIVE_UINT, &sampleScale);
+    H5Aclose(ssAttr);
+
+    if (sampledSets) {
+        hid_t sAttr = H5Acreate2(fid, "sampledSets", H5T_NATIVE_UINT, H5Screate(H5S_SCALAR), H5P_DEFAULT, H5P_DEFAULT);
+        H5Awrite(sAttr, H5T_NATIVE_UINT, &sampledSets);
+        H5Aclose(sAttr);
+    }
+
     hid_t fAttr = H5Acreate2(fid, "finished", H5T_NATIVE_UINT, H5Screate(H5S_SCALAR), H5P_DEFAULT, H5P_DEFAULT);
     uint32_t finished = 0;
     H5Awrite(fAttr, H5T_NATIVE_UINT, &finished);
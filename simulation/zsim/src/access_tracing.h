@@ -29,7 +29,10 @@
 #include "g_std/g_string.h"
 #include "memory_hierarchy.h"
 
-/* HDF5-based classes read and write address traces in a consistent format */
+/* HDF5-based classes read and write address traces in a consistent format.
+ * Sampled traces (see sampletrace) record a sample scale: each kept record stands for that many records of the full trace.
+ * Set-sampled traces also record the number of sets of the cache they were renamed for (lineAddr % sampledSets indexing).
+ */
 
 struct AccessRecord {
     Address lineAddr;
@@ -58,6 +61,8 @@ class AccessTraceReader {
         uint64_t curFrameRecord;
         uint64_t numRecords;
         uint32_t numChildren; //i.e., how many parallel streams does this file contain?
+        uint32_t sampleScale; //1 for unsampled traces
+        uint32_t sampledSets; //0 unless set-sampled
 
     public:
         AccessTraceReader(std::string fname);
@@ -65,6 +70,8 @@ class AccessTraceReader {
         inline bool empty() const {return (cur == max);}
         uint32_t getNumChildren() const {return numChildren;}
         uint64_t getNumRecords() const {return numRecords;}
+        uint32_t getSampleScale() const {return sampleScale;}
+        uint32_t getSampledSets() const {return sampledSets;}
 
         inline AccessRecord read() {
             assert(cur < max);
@@ -86,7 +93,7 @@ class AccessTraceWriter : public GlobAlloc {
         g_string fname;
 
     public:
-        AccessTraceWriter(g_string fname, uint32_t numChildren);
+        AccessTraceWriter(g_string fname, uint32_t numChildren, uint32_t sampleScale = 1, uint32_t sampledSets = 0);
 
         inline void write(AccessRecord& acc) {
             buf[cur++] = {acc.lineAddr, acc.reqCycle, acc.latency, (uint16_t) acc.childId, (uint8_t) acc.type};
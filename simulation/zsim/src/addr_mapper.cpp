@@ -0,0 +1,86 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "addr_mapper.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "bithacks.h"
+#include "config.h"  // for Tokenize
+#include "log.h"
+
+AddrMapper::AddrMapper(const char* _mapping, std::initializer_list<FieldSpec> specs) {
+    std::vector<std::string> tokens;
+    Tokenize(_mapping, tokens, ":");
+    if (tokens.size() != specs.size()) panic("Invalid address mapping %s, need %ld fields separated by colons", _mapping, specs.size());
+    std::reverse(tokens.begin(), tokens.end());  // want lowest digits first
+
+    allPow2 = true;
+    for (const FieldSpec& s : specs) {
+        if (!s.size) panic("Field %s in address mapping %s has size 0", s.name, _mapping);
+        if (!isPow2(s.size)) allPow2 = false;
+        Field f;
+        f.name = s.name;
+        f.size = s.size;
+        f.stride = 0;
+        f.shift = f.bits = 0;
+        f.hashed = s.hashed && s.size > 1;
+        fields.push_back(f);
+    }
+
+    uint64_t stride = 1;
+    for (const std::string& t : tokens) {
+        auto it = std::find_if(fields.begin(), fields.end(), [&t](const Field& f) { return t == f.name.c_str(); });
+        if (it == fields.end()) panic("Invalid token %s in address mapping %s", t.c_str(), _mapping);
+        if (it->stride) panic("Repeated field %s in address mapping %s", t.c_str(), _mapping);
+        it->stride = stride;
+        if (allPow2) {
+            it->shift = ilog2(stride);
+            it->bits = ilog2(it->size);
+        }
+        stride *= it->size;
+    }
+    topStride = stride;
+    topShift = allPow2? ilog2(stride) : 0;
+}
+
+g_string AddrMapper::toString() const {
+    std::vector<const Field*> sorted;
+    for (const Field& f : fields) sorted.push_back(&f);
+    std::sort(sorted.begin(), sorted.end(), [](const Field* a, const Field* b) { return a->stride > b->stride; });
+
+    std::stringstream ss;
+    ss << "top";
+    for (const Field* f : sorted) {
+        ss << ":" << f->name << (f->hashed? "^" : "");
+        if (allPow2) {
+            if (f->bits) ss << "[" << f->shift + f->bits - 1 << ":" << f->shift << "]";
+        } else {
+            ss << "[x" << f->size << "]";
+        }
+    }
+    return g_string(ss.str().c_str());
+}
@@ -0,0 +1,118 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADDR_MAPPER_H_
+#define ADDR_MAPPER_H_
+
+#include <initializer_list>
+#include <stdint.h>
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "memory_hierarchy.h"
+
+/* Table-driven address mapper, used to interleave channels (SplitAddrMemory)
+ * and to split controller addresses into DRAM coordinates (DDRMemory).
+ *
+ * A mapping is a colon-separated list of field names, most significant
+ * first (e.g., "rank:col:bank"). Each field is a digit of a mixed-radix
+ * decomposition of the line address, so field sizes need not be powers of
+ * two (e.g., 3 channels); whatever is above the highest field (e.g., the
+ * row) is the top. Hashed fields are permuted with the top: with
+ * power-of-two sizes, they are XORed with a fold of the top bits, as in
+ * permutation-based interleaving (Zhang et al., MICRO'00); otherwise, a
+ * multiplicative hash of the top is added modulo the field size. Either way,
+ * power-of-two strides spread across channels and banks, and the mapping
+ * stays a bijection, so removing a field yields a dense address.
+ */
+class AddrMapper : public GlobAlloc {
+    public:
+        struct FieldSpec {
+            const char* name;
+            uint64_t size;
+            bool hashed;
+        };
+
+    private:
+        struct Field {
+            g_string name;
+            uint64_t size;
+            uint64_t stride;  // product of the sizes of lower fields
+            uint32_t shift, bits;  // only used if allPow2
+            bool hashed;
+        };
+
+        g_vector<Field> fields;  // in FieldSpec order
+        uint64_t topStride;
+        uint32_t topShift;  // only used if allPow2
+        bool allPow2;  // all fields are powers of two, so we can use shifts and masks
+
+    public:
+        // Every field in specs must appear exactly once in mapping; fields are then accessed by their index in specs
+        AddrMapper(const char* _mapping, std::initializer_list<FieldSpec> specs);
+
+        inline Address top(Address lineAddr) const {
+            return allPow2? lineAddr >> topShift : lineAddr / topStride;
+        }
+
+        inline uint64_t get(Address lineAddr, uint32_t f) const {
+            const Field& fd = fields[f];
+            uint64_t v = allPow2? (lineAddr >> fd.shift) & (fd.size - 1) : (lineAddr / fd.stride) % fd.size;
+            if (fd.hashed) {
+                Address t = top(lineAddr);
+                v = allPow2? v ^ fold(t, fd.bits) : (v + ((t * 0x9E3779B97F4A7C15ul) >> 32) % fd.size) % fd.size;
+            }
+            return v;
+        }
+
+        // Address without field f, e.g., the controller address once the channel is chosen
+        inline Address remove(Address lineAddr, uint32_t f) const {
+            const Field& fd = fields[f];
+            if (allPow2) {
+                Address low = lineAddr & ((1ul << fd.shift) - 1);
+                return ((lineAddr >> (fd.shift + fd.bits)) << fd.shift) | low;
+            } else {
+                return (lineAddr / (fd.stride*fd.size))*fd.stride + lineAddr % fd.stride;
+            }
+        }
+
+        inline uint64_t getSize(uint32_t f) const { return fields[f].size; }
+        inline uint32_t getNumFields() const { return fields.size(); }
+
+        // e.g., "top:rank[21:20]:col[19:3]:bank^[2:0]"
+        g_string toString() const;
+
+    private:
+        static inline uint64_t fold(uint64_t v, uint32_t bits) {
+            uint64_t h = 0;
+            while (v) {
+                h ^= v & ((1ul << bits) - 1);
+                v >>= bits;
+            }
+            return h;
+        }
+};
+
+#endif  // ADDR_MAPPER_H_
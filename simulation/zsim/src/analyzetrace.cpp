@@ -0,0 +1,351 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Streams an access trace once and summarizes it: reuse (LRU stack) distance
+ * histograms globally and per child (each child's distances are measured
+ * within its own access stream), working-set size over fixed cycle
+ * windows, per-child access type mix, and sharing degree across children.
+ * Results are written as CSV files (<prefix>.rd.csv, <prefix>.wss.csv,
+ * <prefix>.rw.csv, <prefix>.sharing.csv) that analysis/main.py can load.
+ *
+ * Parallelization: lines are hash-partitioned into one shard per thread. The
+ * reader splits each batch of records by shard while persistent workers
+ * process the previous batch, synchronizing on a barrier. Working-set sizes, type mixes and sharing degrees are
+ * exact. Stack distances are computed within each shard and scaled by the
+ * number of shards (spatial sampling, as in SHARDS, FAST'15). The default is
+ * a single thread, which gives exact distances.
+ */
+
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "access_tracing.h"
+#include "bithacks.h"
+#include "galloc.h"
+#include "log.h"
+
+// pb_ds pulls in <cassert>; include it after log.h so it does not clash with our assert
+#include <ext/pb_ds/assoc_container.hpp>  // NOLINT
+#include <ext/pb_ds/tree_policy.hpp>  // NOLINT
+
+using namespace std;
+
+#define BATCH_RECORDS (1024*1024u)
+#define RD_BUCKETS 48  // log2 buckets; bucket 0 is distance 0, bucket b covers [2^(b-1), 2^b)
+
+// Order-statistics tree of last-access timestamps; the stack distance of an
+// access is the number of distinct lines touched since the previous access
+// to the same line, i.e., the number of timestamps greater than its own
+typedef __gnu_pbds::tree<uint64_t, __gnu_pbds::null_type, less<uint64_t>,
+        __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update> TimestampTree;
+
+// Returns the stack distance of an access to a line last touched at lastTime,
+// and moves the line to the top of the stack (timestamp curTime)
+static uint64_t touch(TimestampTree& stack, uint64_t lastTime, uint64_t curTime) {
+    uint64_t dist = stack.size() - stack.order_of_key(lastTime + 1);
+    stack.erase(lastTime);
+    stack.insert(curTime);
+    return dist;
+}
+
+struct ChildSummary {
+    uint64_t rdHist[RD_BUCKETS];
+    uint64_t coldAccs;
+    uint64_t typeCounts[4];  // indexed by AccessType
+
+    ChildSummary() : coldAccs(0) {
+        for (uint32_t i = 0; i < RD_BUCKETS; i++) rdHist[i] = 0;
+        for (uint32_t i = 0; i < 4; i++) typeCounts[i] = 0;
+    }
+
+    void merge(const ChildSummary& other) {
+        for (uint32_t i = 0; i < RD_BUCKETS; i++) rdHist[i] += other.rdHist[i];
+        coldAccs += other.coldAccs;
+        for (uint32_t i = 0; i < 4; i++) typeCounts[i] += other.typeCounts[i];
+    }
+
+    void recordDistance(uint64_t dist) {
+        uint32_t bucket = dist? MIN(ilog2(dist) + 1, (uint32_t)RD_BUCKETS - 1) : 0;
+        rdHist[bucket]++;
+    }
+};
+
+class TraceShard {
+    private:
+        struct LineInfo {
+            uint64_t lastTime;
+            uint64_t lastWindow;
+            uint64_t sharers;  // bitmask of children that touched the line
+            uint64_t accesses;
+        };
+
+        // Each child's own reuse stack, so its distances ignore other children's accesses
+        struct ChildStack {
+            unordered_map<Address, uint64_t> lastTimes;
+            TimestampTree lastAccesses;
+            uint64_t curTime;
+
+            ChildStack() : curTime(0) {}
+        };
+
+        const uint32_t numShards;
+        const uint64_t windowCycles;
+
+        unordered_map<Address, LineInfo> lines;
+        TimestampTree lastAccesses;
+        uint64_t curTime;
+        vector<ChildStack> childStacks;
+
+    public:
+        ChildSummary global;
+        vector<ChildSummary> children;
+        vector<uint64_t> windowLines;
+
+        TraceShard(uint32_t _numShards, uint32_t numChildren, uint64_t _windowCycles)
+            : numShards(_numShards), windowCycles(_windowCycles), curTime(0), childStacks(numChildren), children(numChildren) {}
+
+        static uint32_t shardOf(Address lineAddr, uint32_t numShards) {
+            // Low line bits are typically set bits; mix them so shards get similar loads
+            return (uint32_t)((lineAddr * 0x9E3779B97F4A7C15ul) >> 32) % numShards;
+        }
+
+        // batch holds only this shard's records (see readBatch)
+        void process(const vector<AccessRecord>& batch) {
+            for (const AccessRecord& acc : batch) access(acc);
+        }
+
+        // Fills in degree -> (lines, accesses)
+        void sharingSummary(vector<uint64_t>& degLines, vector<uint64_t>& degAccs) const {
+            for (auto& kv : lines) {
+                uint32_t deg = __builtin_popcountl(kv.second.sharers);
+                degLines[deg]++;
+                degAccs[deg] += kv.second.accesses;
+            }
+        }
+
+    private:
+        void access(const AccessRecord& acc) {
+            assert(acc.childId < children.size());
+            ChildSummary& cs = children[acc.childId];
+            cs.typeCounts[acc.type]++;
+            global.typeCounts[acc.type]++;
+            if (!IsGet(acc.type)) return;  // writebacks do not change the reuse stream
+
+            uint64_t window = acc.reqCycle / windowCycles;
+            if (window >= windowLines.size()) windowLines.resize(window + 1, 0);
+
+            auto it = lines.find(acc.lineAddr);
+            if (it == lines.end()) {
+                LineInfo li = {curTime, window, 1ul << acc.childId, 1};
+                lines[acc.lineAddr] = li;
+                lastAccesses.insert(curTime);
+                global.coldAccs++;
+                windowLines[window]++;
+            } else {
+                LineInfo& li = it->second;
+                global.recordDistance(touch(lastAccesses, li.lastTime, curTime) * numShards);
+                if (li.lastWindow != window) {
+                    li.lastWindow = window;
+                    windowLines[window]++;
+                }
+                li.lastTime = curTime;
+                li.sharers |= 1ul << acc.childId;
+                li.accesses++;
+            }
+            curTime++;
+
+            ChildStack& stack = childStacks[acc.childId];
+            auto cit = stack.lastTimes.find(acc.lineAddr);
+            if (cit == stack.lastTimes.end()) {
+                stack.lastTimes[acc.lineAddr] = stack.curTime;
+                stack.lastAccesses.insert(stack.curTime);
+                cs.coldAccs++;
+            } else {
+                cs.recordDistance(touch(stack.lastAccesses, cit->second, stack.curTime) * numShards);
+                cit->second = stack.curTime;
+            }
+            stack.curTime++;
+        }
+};
+
+// Reads up to BATCH_RECORDS records, split by shard; returns how many were read
+static uint64_t readBatch(AccessTraceReader& tr, vector< vector<AccessRecord> >& batch) {
+    uint32_t numShards = batch.size();
+    for (vector<AccessRecord>& b : batch) b.clear();
+    uint64_t records = 0;
+    while (!tr.empty() && records < BATCH_RECORDS) {
+        AccessRecord acc = tr.read();
+        batch[(numShards == 1)? 0 : TraceShard::shardOf(acc.lineAddr, numShards)].push_back(acc);
+        records++;
+    }
+    return records;
+}
+
+// Reusable barrier between the reader and the shard workers
+class BatchBarrier {
+    private:
+        mutex m;
+        condition_variable cv;
+        const uint32_t parties;
+        uint32_t waiting;
+        uint64_t generation;
+
+    public:
+        explicit BatchBarrier(uint32_t _parties) : parties(_parties), waiting(0), generation(0) {}
+
+        void wait() {
+            unique_lock<mutex> lk(m);
+            uint64_t gen = generation;
+            if (++waiting == parties) {
+                waiting = 0;
+                generation++;
+                cv.notify_all();
+            } else {
+                cv.wait(lk, [this, gen]() { return generation != gen; });
+            }
+        }
+};
+
+static FILE* openCsv(const string& prefix, const char* suffix, const char* header) {
+    string fname = prefix + suffix;
+    FILE* f = fopen(fname.c_str(), "w");
+    if (!f) panic("Could not open %s for writing", fname.c_str());
+    fprintf(f, "%s\n", header);
+    return f;
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc < 3 || argc > 5) {
+        info("Summarizes an access trace: reuse distances, working set, access mix and sharing");
+        info("Usage: %s <trace> <output_prefix> [threads] [window_cycles]", argv[0]);
+        info("  threads > 1 hash-partitions lines and estimates stack distances (default 1, exact)");
+        exit(1);
+    }
+
+    uint32_t numThreads = (argc > 3)? strtoul(argv[3], nullptr, 0) : 1;
+    uint64_t windowCycles = (argc > 4)? strtoul(argv[4], nullptr, 0) : 1000000;
+    if (!numThreads) numThreads = 1;
+    if (!windowCycles) panic("window_cycles must be > 0");
+    string prefix = argv[2];
+
+    gm_init(32<<20 /*32 MB, only used by the trace reader*/);
+    AccessTraceReader tr(argv[1]);
+    uint32_t numChildren = tr.getNumChildren();
+    if (numChildren > 64) panic("Sharing analysis supports up to 64 children, trace has %d", numChildren);
+    info("Analyzing %ld records from %d children with %d threads, %ld-cycle windows", tr.getNumRecords(), numChildren, numThreads, windowCycles);
+    if (numThreads > 1) warn("Reuse distances are approximate: sampled over %d line shards and scaled by %d", numThreads, numThreads);
+
+    vector<TraceShard*> shards;
+    for (uint32_t i = 0; i < numThreads; i++) shards.push_back(new TraceShard(numThreads, numChildren, windowCycles));
+
+    // Double-buffered: read and split the next batch while workers chew on the current one.
+    // Each round, workers and reader meet at the barrier twice: to start on cur, and when done with it
+    vector< vector<AccessRecord> > bufs[2] = {vector< vector<AccessRecord> >(numThreads), vector< vector<AccessRecord> >(numThreads)};
+    vector< vector<AccessRecord> >* cur = &bufs[0];
+    vector< vector<AccessRecord> >* next = &bufs[1];
+    bool finished = false;
+    BatchBarrier barrier(numThreads + 1);
+    vector<thread> workers;
+    for (uint32_t i = 0; i < numThreads; i++) {
+        workers.push_back(thread([&, i]() {
+            while (true) {
+                barrier.wait();
+                if (finished) return;
+                shards[i]->process((*cur)[i]);
+                barrier.wait();
+            }
+        }));
+    }
+
+    uint64_t curRecords = readBatch(tr, *cur);
+    uint64_t processed = 0;
+    while (curRecords) {
+        barrier.wait();
+        uint64_t nextRecords = readBatch(tr, *next);
+        barrier.wait();
+        processed += curRecords;
+        printf("Processed %3ld%%\r", processed*100/tr.getNumRecords());
+        fflush(stdout);
+        swap(cur, next);
+        curRecords = nextRecords;
+    }
+    finished = true;
+    barrier.wait();
+    for (thread& w : workers) w.join();
+    printf("\n");
+
+    // Merge shards
+    ChildSummary global;
+    vector<ChildSummary> children(numChildren);
+    vector<uint64_t> windowLines;
+    vector<uint64_t> degLines(65, 0), degAccs(65, 0);
+    for (TraceShard* s : shards) {
+        global.merge(s->global);
+        for (uint32_t c = 0; c < numChildren; c++) children[c].merge(s->children[c]);
+        if (s->windowLines.size() > windowLines.size()) windowLines.resize(s->windowLines.size(), 0);
+        for (uint32_t w = 0; w < s->windowLines.size(); w++) windowLines[w] += s->windowLines[w];
+        s->sharingSummary(degLines, degAccs);
+    }
+    // Reuse distances: child -1 is the global histogram, bucket -1 holds cold (first-touch) accesses,
+    // global or by that child
+    FILE* f = openCsv(prefix, ".rd.csv", "child,bucket,minLines,accesses");
+    auto dumpRd = [f](int32_t child, const ChildSummary& cs) {
+        fprintf(f, "%d,-1,-1,%ld\n", child, cs.coldAccs);
+        for (uint32_t b = 0; b < RD_BUCKETS; b++) {
+            fprintf(f, "%d,%d,%ld,%ld\n", child, b, b? (1ul << (b-1)) : 0ul, cs.rdHist[b]);
+        }
+    };
+    dumpRd(-1, global);
+    for (uint32_t c = 0; c < numChildren; c++) dumpRd(c, children[c]);
+    fclose(f);
+
+    f = openCsv(prefix, ".wss.csv", "window,startCycle,lines");
+    for (uint32_t w = 0; w < windowLines.size(); w++) fprintf(f, "%d,%ld,%ld\n", w, w*windowCycles, windowLines[w]);
+    fclose(f);
+
+    f = openCsv(prefix, ".rw.csv", "child,GETS,GETX,PUTS,PUTX,readFraction");
+    auto dumpRw = [f](int32_t child, const ChildSummary& cs) {
+        uint64_t reads = cs.typeCounts[GETS];
+        uint64_t writes = cs.typeCounts[GETX] + cs.typeCounts[PUTX];
+        fprintf(f, "%d,%ld,%ld,%ld,%ld,%.4f\n", child, cs.typeCounts[GETS], cs.typeCounts[GETX], cs.typeCounts[PUTS], cs.typeCounts[PUTX],
+                (reads + writes)? ((double)reads)/(reads + writes) : 0.0);
+    };
+    dumpRw(-1, global);
+    for (uint32_t c = 0; c < numChildren; c++) dumpRw(c, children[c]);
+    fclose(f);
+
+    f = openCsv(prefix, ".sharing.csv", "degree,lines,accesses");
+    for (uint32_t d = 1; d <= numChildren; d++) fprintf(f, "%d,%ld,%ld\n", d, degLines[d], degAccs[d]);
+    fclose(f);
+
+    info("Wrote %s.{rd,wss,rw,sharing}.csv", prefix.c_str());
+    for (TraceShard* s : shards) delete s;
+    return 0;
+}
@@ -49,6 +49,7 @@
 #include "locks.h"
 #include "log.h"
 #include "mtrand.h"
+#include "rdtsc.h"
 
 // Configure futex timeouts (die rather than deadlock)
 #define TIMEOUT_LENGTH 20 //seconds
@@ -88,6 +89,11 @@ class Barrier : public GlobAlloc {
 
         uint32_t phaseCount; //INTERNAL, for LEFT->OFFLINE bookkeeping overhead reduction purposes
 
+        //Cumulative counts, sampled by the phase length controller
+        uint64_t syncs; //protected by schedLock
+        uint64_t leaves; //protected by schedLock
+        volatile uint64_t waitCycles; //host cycles threads spent blocked in sync(); updated atomically, outside schedLock
+
         uint32_t pad[16];
 
         /* NOTE(dsm): I was initially misled that having a single lock protecting the barrier was a performance hog, and coded a lock-free version.
@@ -115,6 +121,9 @@ class Barrier : public GlobAlloc {
             runningThreads = 0;
             leftThreads = 0;
             phaseCount = 0;
+            syncs = 0;
+            leaves = 0;
+            waitCycles = 0;
             //barrierLock = 0;
         }
 
@@ -165,6 +174,7 @@ class Barrier : public GlobAlloc {
         //Must be called with schedLock held
         void leave(uint32_t tid) {
             DEBUG_BARRIER("[%d] Leaving, runningThreads %d", tid, runningThreads);
+            leaves++;
             if (threadList[tid].state == RUNNING) {
                 threadList[tid].state = LEFT;
                 leftThreads++;
@@ -181,6 +191,8 @@ class Barrier : public GlobAlloc {
         void sync(uint32_t tid, lock_t* schedLock) {
             DEBUG_BARRIER("[%d] Sync", tid);
             assert_msg(threadList[tid].state == RUNNING, "[%d] sync: state was supposed to be %d, it is %d", tid, RUNNING, threadList[tid].state);
+            uint64_t startTsc = rdtsc();
+            syncs++;
             threadList[tid].futexWord = 1;
             threadList[tid].state = WAITING;
             runningThreads--;
@@ -195,8 +207,13 @@ class Barrier : public GlobAlloc {
                 //The thread that wakes us up changes this
                 assert(threadList[tid].state == RUNNING);
             }
+            __sync_fetch_and_add(&waitCycles, rdtsc() - startTsc);
         }
 
+        uint64_t getSyncs() const {return syncs;}
+        uint64_t getLeaves() const {return leaves;}
+        uint64_t getWaitCycles() const {return waitCycles;}
+
     private:
         inline void checkEndPhase(uint32_t tid) {
             if (curThreadIdx == runListSize && runningThreads == 0) {
@@ -24,6 +24,7 @@
  */
 
 #include "cache.h"
+#include "checkpoint.h"
 #include "hash.h"
 
 #include "event_recorder.h"
@@ -58,6 +59,22 @@ void Cache::initCacheStats(AggregateStat* cacheStat) {
     rp->initStats(cacheStat);
 }
 
+void Cache::saveState(CheckpointWriter& cw) {
+    cw.write(numLines);
+    array->saveState(cw);
+    cc->saveState(cw);
+    rp->saveState(cw);
+}
+
+void Cache::loadState(CheckpointReader& cr) {
+    uint32_t ckptLines;
+    cr.read(ckptLines);
+    if (ckptLines != numLines) panic("[%s] Checkpoint has %d lines, cache has %d", name.c_str(), ckptLines, numLines);
+    array->loadState(cr);
+    cc->loadState(cr);
+    rp->loadState(cr);
+}
+
 uint64_t Cache::access(MemReq& req) {
     uint64_t respCycle = req.cycle;
     bool skipAccess = cc->startAccess(req); //may need to skip access due to races (NOTE: may change req.type!)
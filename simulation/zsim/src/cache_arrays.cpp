@@ -24,6 +24,7 @@
  */
 
 #include "cache_arrays.h"
+#include "checkpoint.h"
 #include "hash.h"
 #include "repl_policies.h"
 
@@ -64,6 +65,14 @@ void SetAssocArray::postinsert(const Address lineAddr, const MemReq* req, uint32
     rp->update(candidate, req);
 }
 
+void SetAssocArray::saveState(CheckpointWriter& cw) {
+    cw.writeArray(array, numLines);
+}
+
+void SetAssocArray::loadState(CheckpointReader& cr) {
+    cr.readArray(array, numLines);
+}
+
 
 /* ZCache implementation */
 
@@ -95,6 +104,16 @@ void ZArray::initStats(AggregateStat* parentStat) {
     parentStat->append(objStats);
 }
 
+void ZArray::saveState(CheckpointWriter& cw) {
+    cw.writeArray(array, numLines);
+    cw.writeArray(lookupArray, numLines); //swaps scramble the position -> lineId mapping
+}
+
+void ZArray::loadState(CheckpointReader& cr) {
+    cr.readArray(array, numLines);
+    cr.readArray(lookupArray, numLines);
+}
+
 int32_t ZArray::lookup(const Address lineAddr, const MemReq* req, bool updateReplacement) {
     /* Be defensive: If the line is 0, panic instead of asserting. Now this can
      * only happen on a segfault in the main program, but when we move to full
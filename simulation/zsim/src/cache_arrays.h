@@ -49,6 +49,10 @@ class CacheArray : public GlobAlloc {
         virtual void postinsert(const Address lineAddr, const MemReq* req, uint32_t lineId) = 0;
 
         virtual void initStats(AggregateStat* parent) {}
+
+        //Warm-up checkpoints: save/restore tags (see checkpoint.h)
+        virtual void saveState(CheckpointWriter& cw) {panic("This cache array does not support checkpoints");}
+        virtual void loadState(CheckpointReader& cr) {panic("This cache array does not support checkpoints");}
 };
 
 class ReplPolicy;
@@ -71,6 +75,9 @@ class SetAssocArray : public CacheArray {
         int32_t lookup(const Address lineAddr, const MemReq* req, bool updateReplacement);
         uint32_t preinsert(const Address lineAddr, const MemReq* req, Address* wbLineAddr);
         void postinsert(const Address lineAddr, const MemReq* req, uint32_t candidate);
+
+        void saveState(CheckpointWriter& cw);
+        void loadState(CheckpointReader& cr);
 };
 
 /* The cache array that started this simulator :) */
@@ -106,6 +113,9 @@ class ZArray : public CacheArray {
         uint32_t getLastCandIdx() const {return lastCandIdx;}
 
         void initStats(AggregateStat* parentStat);
+
+        void saveState(CheckpointWriter& cw);
+        void loadState(CheckpointReader& cr);
 };
 
 // Simple wrapper classes and iterators for candidates in each case; simplifies replacement policy interface without sacrificing performance
@@ -0,0 +1,87 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "checkpoint.h"
+#include "memory_hierarchy.h"
+#include "trace_driver.h"
+#include "zsim.h"
+
+#define CKPT_MAGIC "zsim-checkpoint-v1"
+
+void Checkpointer::endOfPhase() {
+    if (unlikely(savePhase && zinfo->numPhases + 1 == savePhase)) save(saveFile.c_str());
+}
+
+void Checkpointer::save(const char* fname) {
+    //We're called at the end of a phase, before numPhases is incremented
+    uint64_t phases = zinfo->numPhases + 1;
+    uint64_t cycles = zinfo->globPhaseCycles + zinfo->phaseLength;
+    info("Saving checkpoint to %s after %ld phases (%ld cycles)", fname, phases, cycles);
+
+    CheckpointWriter cw(fname);
+    cw.writeTag(CKPT_MAGIC);
+    cw.write(phases);
+    cw.write(cycles);
+    cw.write((uint32_t)caches.size());
+    for (BaseCache* c : caches) {
+        cw.writeTag(c->getName());
+        c->saveState(cw);
+    }
+
+    cw.write(zinfo->traceDriven);
+    if (zinfo->traceDriven) zinfo->traceDriver->saveState(cw);
+    info("Checkpoint saved");
+}
+
+void Checkpointer::restore(const char* fname) {
+    CheckpointReader cr(fname);
+    cr.checkTag(CKPT_MAGIC);
+    uint64_t phases, cycles;
+    cr.read(phases);
+    cr.read(cycles);
+    uint32_t numCaches;
+    cr.read(numCaches);
+    if (numCaches != caches.size()) panic("Checkpoint %s has %d caches, system has %ld", fname, numCaches, caches.size());
+    for (BaseCache* c : caches) {
+        cr.checkTag(c->getName());
+        c->loadState(cr);
+    }
+
+    bool traceDriven;
+    cr.read(traceDriven);
+    if (traceDriven != zinfo->traceDriven) panic("Checkpoint %s was taken on a %s run, cannot restore it on a %s run", fname,
+            traceDriven? "trace-driven" : "execution-driven", zinfo->traceDriven? "trace-driven" : "execution-driven");
+    if (zinfo->traceDriven) {
+        // Replay resumes where the checkpoint was taken
+        zinfo->traceDriver->loadState(cr);
+        zinfo->numPhases = phases;
+        zinfo->globPhaseCycles = cycles;
+        info("Restored checkpoint %s, resuming trace replay at phase %ld (%ld cycles)", fname, phases, cycles);
+    } else {
+        // The program re-executes (e.g., fast-forwards to the same point), but starts with warm caches
+        info("Restored checkpoint %s (taken after %ld phases), caches start warm", fname, phases);
+    }
+    if (!cr.eof()) panic("Checkpoint %s has trailing data (different configuration?)", fname);
+}
@@ -0,0 +1,156 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "log.h"
+
+/* Warm-up checkpoints: the memory hierarchy's long-lived state (cache tags,
+ * coherence state and replacement state) is dumped to a file at the end of a
+ * given phase, and later runs with the same hierarchy can restore it at
+ * initialization instead of re-simulating the warm-up.
+ *
+ * The format is a flat binary stream. Each component writes its state in a
+ * fixed order, and readers check sizes and section names as they go, so
+ * restoring on a different hierarchy fails loudly instead of silently.
+ */
+
+class CheckpointWriter {
+    private:
+        FILE* f;
+        g_string fname;
+
+    public:
+        explicit CheckpointWriter(const char* _fname) : fname(_fname) {
+            f = fopen(_fname, "wb");
+            if (!f) panic("Could not open checkpoint %s for writing", _fname);
+        }
+
+        ~CheckpointWriter() {
+            if (fclose(f) != 0) panic("Error closing checkpoint %s", fname.c_str());
+        }
+
+        void write(const void* buf, size_t bytes) {
+            if (bytes && fwrite(buf, bytes, 1, f) != 1) panic("Error writing checkpoint %s", fname.c_str());
+        }
+
+        template <typename T> void write(const T& v) {
+            write(&v, sizeof(T));
+        }
+
+        //Arrays are prefixed by their element count, so readers can check they match
+        template <typename T> void writeArray(const T* array, uint64_t elems) {
+            write(elems);
+            write(array, elems*sizeof(T));
+        }
+
+        void writeString(const char* str) {
+            uint32_t len = strlen(str);
+            write(len);
+            write(str, len);
+        }
+
+        //Section names delimit components, to catch mismatched hierarchies on restore
+        void writeTag(const char* tag) {writeString(tag);}
+};
+
+class CheckpointReader {
+    private:
+        FILE* f;
+        g_string fname;
+
+    public:
+        explicit CheckpointReader(const char* _fname) : fname(_fname) {
+            f = fopen(_fname, "rb");
+            if (!f) panic("Could not open checkpoint %s", _fname);
+        }
+
+        ~CheckpointReader() {
+            fclose(f);
+        }
+
+        void read(void* buf, size_t bytes) {
+            if (bytes && fread(buf, bytes, 1, f) != 1) panic("Checkpoint %s is truncated or corrupted", fname.c_str());
+        }
+
+        template <typename T> void read(T& v) {
+            read(&v, sizeof(T));
+        }
+
+        template <typename T> void readArray(T* array, uint64_t elems) {
+            uint64_t ckptElems;
+            read(ckptElems);
+            if (ckptElems != elems) panic("Checkpoint %s has an array of %ld elements, expected %ld (different configuration?)", fname.c_str(), ckptElems, elems);
+            read(array, elems*sizeof(T));
+        }
+
+        g_string readString() {
+            uint32_t len;
+            read(len);
+            g_string str(len, ' ');
+            read(&str[0], len);
+            return str;
+        }
+
+        void checkTag(const char* tag) {
+            g_string ckptTag = readString();
+            if (ckptTag != tag) panic("Checkpoint %s does not match this system: expected %s, found %s", fname.c_str(), tag, ckptTag.c_str());
+        }
+
+        bool eof() {
+            int c = fgetc(f);
+            if (c == EOF) return true;
+            ungetc(c, f);
+            return false;
+        }
+};
+
+class BaseCache;
+
+class Checkpointer : public GlobAlloc {
+    private:
+        g_vector<BaseCache*> caches; //all caches in the system, in a fixed (init) order
+        uint64_t savePhase; //0 if we don't save a checkpoint
+        g_string saveFile;
+
+    public:
+        Checkpointer(const g_vector<BaseCache*>& _caches, uint64_t _savePhase, const char* _saveFile)
+            : caches(_caches), savePhase(_savePhase), saveFile(_saveFile) {}
+
+        //Called at the end of every phase; saves the checkpoint once savePhase phases have been simulated
+        void endOfPhase();
+
+        void save(const char* fname);
+        void restore(const char* fname);
+};
+
+#endif  // CHECKPOINT_H_
@@ -25,21 +25,11 @@
 
 #include "coherence_ctrls.h"
 #include "cache.h"
+#include "checkpoint.h"
 #include "network.h"
 
-/* Do a simple XOR block hash on address to determine its bank. Hacky for now,
- * should probably have a class that deals with this with a real hash function
- * (TODO)
- */
 uint32_t MESIBottomCC::getParentId(Address lineAddr) {
-    //Hash things a bit
-    uint32_t res = 0;
-    uint64_t tmp = lineAddr;
-    for (uint32_t i = 0; i < 4; i++) {
-        res ^= (uint32_t) ( ((uint64_t)0xffff) & tmp);
-        tmp = tmp >> 16;
-    }
-    return (res % parents.size());
+    return parentIdHash(lineAddr, parents.size());
 }
 
 
@@ -195,6 +185,14 @@ uint64_t MESIBottomCC::processNonInclusiveWriteback(Address lineAddr, AccessType
     return respCycle;
 }
 
+void MESIBottomCC::saveState(CheckpointWriter& cw) {
+    cw.writeArray(array, numLines);
+}
+
+void MESIBottomCC::loadState(CheckpointReader& cr) {
+    cr.readArray(array, numLines);
+}
+
 
 /* MESITopCC implementation */
 
@@ -341,3 +339,15 @@ uint64_t MESITopCC::processInval(Address lineAddr, uint32_t lineId, InvType type
     }
 }
 
+void MESITopCC::saveState(CheckpointWriter& cw) {
+    //Entries are POD; sharer bits index children, which must match on restore (checked through cache names)
+    cw.write((uint32_t)children.size());
+    cw.writeArray(array, numLines);
+}
+
+void MESITopCC::loadState(CheckpointReader& cr) {
+    uint32_t numChildren;
+    cr.read(numChildren);
+    if (numChildren != children.size()) panic("Checkpoint has %d children per cache, system has %ld", numChildren, children.size());
+    cr.readArray(array, numLines);
+}
@@ -59,6 +59,10 @@ class CC : public GlobAlloc {
         //Repl policy interface
         virtual uint32_t numSharers(uint32_t lineId) = 0;
         virtual bool isValid(uint32_t lineId) = 0;
+
+        //Warm-up checkpoints (see checkpoint.h)
+        virtual void saveState(CheckpointWriter& cw) = 0;
+        virtual void loadState(CheckpointReader& cr) = 0;
 };
 
 
@@ -74,6 +78,8 @@ class CC : public GlobAlloc {
  */
 
 class Cache;
+class CheckpointReader;
+class CheckpointWriter;
 class Network;
 
 /* NOTE: To avoid virtual function overheads, there is no BottomCC interface, since we only have a MESI controller for now */
@@ -154,6 +160,9 @@ class MESIBottomCC : public GlobAlloc {
 
         uint64_t processNonInclusiveWriteback(Address lineAddr, AccessType type, uint64_t cycle, MESIState* state, uint32_t srcId, uint32_t flags);
 
+        void saveState(CheckpointWriter& cw);
+        void loadState(CheckpointReader& cr);
+
         inline void lock() {
             futex_lock(&ccLock);
         }
@@ -169,6 +178,22 @@ class MESIBottomCC : public GlobAlloc {
 
         //Could extend with isExclusive, isDirty, etc, but not needed for now.
 
+        /* Do a simple XOR block hash on address to determine its bank. Hacky for now,
+         * should probably have a class that deals with this with a real hash function
+         * (TODO). Public so that other requestors (e.g., the trace driver) route
+         * lines to the same banks caches do.
+         */
+        static inline uint32_t parentIdHash(Address lineAddr, uint32_t numParents) {
+            //Hash things a bit
+            uint32_t res = 0;
+            uint64_t tmp = lineAddr;
+            for (uint32_t i = 0; i < 4; i++) {
+                res ^= (uint32_t) ( ((uint64_t)0xffff) & tmp);
+                tmp = tmp >> 16;
+            }
+            return (res % numParents);
+        }
+
     private:
         uint32_t getParentId(Address lineAddr);
 };
@@ -227,6 +252,9 @@ class MESITopCC : public GlobAlloc {
 
         uint64_t processInval(Address lineAddr, uint32_t lineId, InvType type, bool* reqWriteback, uint64_t cycle, uint32_t srcId);
 
+        void saveState(CheckpointWriter& cw);
+        void loadState(CheckpointReader& cr);
+
         inline void lock() {
             futex_lock(&ccLock);
         }
@@ -302,6 +330,16 @@ class MESICC : public CC {
             bcc->initStats(cacheStat);
         }
 
+        void saveState(CheckpointWriter& cw) {
+            bcc->saveState(cw);
+            tcc->saveState(cw);
+        }
+
+        void loadState(CheckpointReader& cr) {
+            bcc->loadState(cr);
+            tcc->loadState(cr);
+        }
+
         //Access methods
         bool startAccess(MemReq& req) {
             assert((req.type == GETS) || (req.type == GETX) || (req.type == PUTS) || (req.type == PUTX));
@@ -431,6 +469,9 @@ class MESITerminalCC : public CC {
             bcc->initStats(cacheStat);
         }
 
+        void saveState(CheckpointWriter& cw) {bcc->saveState(cw);}
+        void loadState(CheckpointReader& cr) {bcc->loadState(cr);}
+
         //Access methods
         bool startAccess(MemReq& req) {
             assert((req.type == GETS) || (req.type == GETX)); //no puts!
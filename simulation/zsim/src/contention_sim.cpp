@@ -25,7 +25,6 @@
 
 #include "contention_sim.h"
 #include <algorithm>
-#include <queue>
 #include <sstream>
 #include <string>
 #include <typeinfo>
@@ -33,8 +32,10 @@
 #include <vector>
 #include "log.h"
 #include "ooo_core.h"
+#include "rdtsc.h"
 #include "timing_core.h"
 #include "timing_event.h"
+#include "weave_profiler.h"
 #include "zsim.h"
 
 //Set to 1 to produce a post-mortem analysis log
@@ -45,12 +46,6 @@ bool ContentionSim::CompareEvents::operator()(TimingEvent* lhs, TimingEvent* rhs
     return lhs->cycle > rhs->cycle;
 }
 
-bool ContentionSim::CompareDomains::operator()(DomainData* d1, DomainData* d2) const {
-    uint64_t v1 = d1->queuePrio;
-    uint64_t v2 = d2->queuePrio;
-    return (v1 > v2);
-}
-
 
 void ContentionSim::SimThreadTrampoline(void* arg) {
     ContentionSim* csim = static_cast<ContentionSim*>(arg);
@@ -58,9 +53,13 @@ void ContentionSim::SimThreadTrampoline(void* arg) {
     csim->simThreadLoop(thid);
 }
 
-ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
+ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads, bool _batchEvents, uint32_t _rebalancePhases) {
     numDomains = _numDomains;
+    if (numDomains > INT16_MAX) panic("Too many weave domains (%d), TimingEvent supports up to %d", numDomains, INT16_MAX);
     numSimThreads = _numSimThreads;
+    batchEvents = _batchEvents;
+    rebalancePhases = _rebalancePhases;
+    phasesSinceRebalance = 0;
     threadsDone = 0;
     limit = 0;
     lastLimit = 0;
@@ -73,16 +72,30 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
         new (&domains[i].pq) PrioQueue<TimingEvent, PQ_BLOCKS>();
         domains[i].curCycle = 0;
         futex_init(&domains[i].pqLock);
+#if RECORD_PQ_TRACE
+        std::stringstream ss;
+        ss << "pqtrace-" << i << ".bin";
+        domains[i].pqTrace = fopen(ss.str().c_str(), "w");
+        if (!domains[i].pqTrace) panic("Could not open %s", ss.str().c_str());
+#endif
     }
 
-    if ((numDomains % numSimThreads) != 0) panic("numDomains(%d) must be a multiple of numSimThreads(%d) for now", numDomains, numSimThreads);
+    //Any number of threads works; home domains just balance the initial assignment (threads without them start by stealing)
+    if (numSimThreads > numDomains) warn("More contention simulation threads (%d) than domains (%d), %d threads will be mostly idle", numSimThreads, numDomains, numSimThreads - numDomains);
 
     for (uint32_t i = 0; i < numSimThreads; i++) {
         futex_init(&simThreads[i].wakeLock);
         futex_lock(&simThreads[i].wakeLock); //starts locked, so first actual call to lock blocks
-        simThreads[i].firstDomain = i*numDomains/numSimThreads;
-        simThreads[i].supDomain = (i+1)*numDomains/numSimThreads;
+        simThreads[i].homeDomains = gm_calloc<uint32_t>(numDomains);
+        simThreads[i].numHomeDomains = 0;
+        futex_init(&simThreads[i].queueLock);
+        simThreads[i].runQueue = gm_calloc<uint32_t>(numDomains);
+        simThreads[i].runQueueSize = 0;
     }
+    domainsLeft = 0;
+
+    channelDomains = gm_calloc<bool>(numDomains);
+    lastDomainTime = gm_calloc<uint64_t>(numDomains);
 
     futex_init(&waitLock);
     futex_lock(&waitLock); //wait lock must also start locked
@@ -98,9 +111,72 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
     }
 
     lastCrossing = gm_calloc<CrossingEventInfo>(numDomains*numDomains*MAX_THREADS); //TODO: refine... this allocs too much
+    crossingCounts = nullptr;
+}
+
+void ContentionSim::enableCrossingCounts() {
+    if (!crossingCounts) crossingCounts = gm_calloc<uint64_t>(numDomains*numDomains);
+}
+
+uint64_t ContentionSim::getCrossingStalls() const {
+    uint64_t stalls = 0;
+    for (uint32_t i = 0; i < numDomains; i++) stalls += domains[i].profCrossingStalls.get();
+    return stalls;
+}
+
+uint64_t ContentionSim::getCrossingRuns() const {
+    uint64_t runs = 0;
+    for (uint32_t i = 0; i < numDomains; i++) runs += domains[i].profEventTypes.count(EVT_CROSSING);
+    return runs;
+}
+
+void ContentionSim::assignHomeDomains(const uint64_t* loads) {
+    std::vector<uint64_t> threadLoads(numSimThreads, 0);
+    std::vector<uint32_t> threadChannels(numSimThreads, 0);
+    for (uint32_t i = 0; i < numSimThreads; i++) simThreads[i].numHomeDomains = 0;
+    auto addHome = [&](uint32_t t, uint32_t d) {
+        SimThreadData& th = simThreads[t];
+        th.homeDomains[th.numHomeDomains++] = d;
+        if (loads) threadLoads[t] += loads[d];
+        if (channelDomains[d]) threadChannels[t]++;
+    };
+
+    std::vector<uint32_t> channels, others;
+    for (uint32_t d = 0; d < numDomains; d++) (channelDomains[d]? channels : others).push_back(d);
+    if (loads) {
+        auto heavierFirst = [loads](uint32_t d1, uint32_t d2) {return loads[d1] > loads[d2];};
+        std::stable_sort(channels.begin(), channels.end(), heavierFirst);
+        std::stable_sort(others.begin(), others.end(), heavierFirst);
+    }
+
+    //Channel domains: fewest channels, then least loaded thread
+    for (uint32_t d : channels) {
+        uint32_t best = 0;
+        for (uint32_t t = 1; t < numSimThreads; t++) {
+            if (threadChannels[t] < threadChannels[best] ||
+                    (threadChannels[t] == threadChannels[best] && threadLoads[t] < threadLoads[best])) best = t;
+        }
+        addHome(best, d);
+    }
+
+    //Other domains: least loaded thread (LPT), or without loads, the same contiguous ranges as before
+    //channel domains existed (thread t gets [t*n/threads, (t+1)*n/threads))
+    if (loads) {
+        for (uint32_t d : others) addHome(std::min_element(threadLoads.begin(), threadLoads.end()) - threadLoads.begin(), d);
+    } else {
+        uint32_t n = others.size();
+        for (uint32_t t = 0; t < numSimThreads; t++) {
+            for (uint32_t i = t*n/numSimThreads; i < (t+1)*n/numSimThreads; i++) addHome(t, others[i]);
+        }
+    }
 }
 
 void ContentionSim::postInit() {
+    assignHomeDomains(nullptr); //channel domains are known now
+    if (zinfo->analyticalContention) {
+        skipContention = true; //components estimate contention in the bound phase
+        return;
+    }
     for (uint32_t i = 0; i < zinfo->numCores; i++) {
         TimingCore* tcore = dynamic_cast<TimingCore*>(zinfo->cores[i]);
         if (tcore) {
@@ -138,8 +214,46 @@ void ContentionSim::initStats(AggregateStat* parentStat) {
         new (&domains[i].profTime) ClockStat();
         domains[i].profTime.init("time", "Weave simulation time");
         domStat->append(&domains[i].profTime);
+        new (&domains[i].profEvents) Counter();
+        domains[i].profEvents.init("events", "Events simulated");
+        domStat->append(&domains[i].profEvents);
+        new (&domains[i].profSkips) Counter();
+        domains[i].profSkips.init("skips", "Phases skipped because the domain had no events to simulate");
+        domStat->append(&domains[i].profSkips);
+        new (&domains[i].profCrossingStalls) Counter();
+        domains[i].profCrossingStalls.init("xingStalls", "Crossing runs that stalled on their source domain");
+        domStat->append(&domains[i].profCrossingStalls);
+        new (&domains[i].profEventTypes) VectorCounter();
+        domains[i].profEventTypes.init("evTypes", "Events simulated by type", EVT_NUM_TYPES, timingEventTypeNames);
+        domStat->append(&domains[i].profEventTypes);
+        if (zinfo->weaveProfiler) zinfo->weaveProfiler->initStats(i, domStat);
         objStat->append(domStat);
     }
+    for (uint32_t i = 0; i < numSimThreads; i++) {
+        std::stringstream ss;
+        ss << "thread-" << i;
+        AggregateStat* thStat = new AggregateStat();
+        thStat->init(gm_strdup(ss.str().c_str()), "Simulation thread stats");
+        SimThreadData& th = simThreads[i];
+        new (&th.profEvents) Counter();
+        new (&th.profSteals) Counter();
+        new (&th.profWakeups) Counter();
+        new (&th.profTime) ClockStat();
+        new (&th.profIdleTime) ClockStat();
+        th.profEvents.init("events", "Events simulated");
+        th.profSteals.init("steals", "Domains stolen from other threads");
+        th.profWakeups.init("wakeups", "Phases simulated (threads without events to simulate are not woken up)");
+        th.profTime.init("time", "Weave simulation time");
+        th.profIdleTime.init("idle", "Weave time without a domain to simulate (busy time is time - idle)");
+        thStat->append(&th.profEvents);
+        thStat->append(&th.profSteals);
+        thStat->append(&th.profWakeups);
+        thStat->append(&th.profTime);
+        thStat->append(&th.profIdleTime);
+        objStat->append(thStat);
+    }
+    profRebalances.init("rebalances", "Times home domains were reassigned to threads by weave load");
+    objStat->append(&profRebalances);
     parentStat->append(objStat);
 }
 
@@ -157,16 +271,50 @@ void ContentionSim::simulatePhase(uint64_t limit) {
         if (ocore) ocore->cSimStart();
     }
 
+    /* Every domain with events before the limit starts the phase on its home
+     * thread. Domains without them are done: during the weave phase, domains
+     * only enqueue their own events, so they cannot get any, and we can
+     * fast-forward them to the limit right away. Threads without domains to
+     * simulate sleep through the phase.
+     */
+    uint32_t activeDomains = 0;
+    threadsWoken = 0;
+    for (uint32_t i = 0; i < numSimThreads; i++) {
+        SimThreadData& th = simThreads[i];
+        assert(th.runQueueSize == 0);
+        for (uint32_t h = 0; h < th.numHomeDomains; h++) {
+            uint32_t d = th.homeDomains[h];
+            DomainData& dom = domains[d];
+            if (dom.pq.size() && dom.pq.firstCycle() < limit) {
+                th.runQueue[th.runQueueSize++] = d;
+            } else {
+                dom.curCycle = limit;
+                dom.profSkips.inc();
+            }
+        }
+        activeDomains += th.runQueueSize;
+        th.awake = th.runQueueSize > 0;
+        if (th.awake) threadsWoken++;
+    }
+    domainsLeft = activeDomains;
+
+    if (zinfo->weaveProfiler) zinfo->weaveProfiler->startPhase(zinfo->numPhases);
+
     inCSim = true;
     __sync_synchronize();
 
-    //Wake up sim threads
+    //Wake up sim threads with work (NOTE: test awake, not the run queue, which threads already woken up may steal from)
     for (uint32_t i = 0; i < numSimThreads; i++) {
-        futex_unlock(&simThreads[i].wakeLock);
+        if (simThreads[i].awake) {
+            simThreads[i].profWakeups.inc();
+            futex_unlock(&simThreads[i].wakeLock);
+        }
     }
 
     //Sleep until phase is simulated
-    futex_lock_nospin(&waitLock);
+    if (threadsWoken) futex_lock_nospin(&waitLock);
+
+    if (zinfo->weaveProfiler) zinfo->weaveProfiler->endPhase();
 
     inCSim = false;
     __sync_synchronize();
@@ -179,6 +327,18 @@ void ContentionSim::simulatePhase(uint64_t limit) {
     }
 
     lastLimit = limit;
+
+    if (rebalancePhases && ++phasesSinceRebalance == rebalancePhases) {
+        std::vector<uint64_t> loads(numDomains);
+        for (uint32_t d = 0; d < numDomains; d++) {
+            uint64_t time = domains[d].profTime.get();
+            loads[d] = time - lastDomainTime[d];
+            lastDomainTime[d] = time;
+        }
+        assignHomeDomains(loads.data());
+        phasesSinceRebalance = 0;
+        profRebalances.inc();
+    }
     __sync_synchronize();
 }
 
@@ -187,7 +347,7 @@ void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) {
     assert(ev);
     assert_msg(cycle >= lastLimit, "Enqueued event before last limit! cycle %ld min %ld", cycle, lastLimit);
     //Hacky, but helpful to chase events scheduled too far ahead due to bugs (e.g., cycle -1). We should probably formalize this a bit more
-    assert_msg(cycle < lastLimit+10*zinfo->phaseLength+1000000, "Queued event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
+    assert_msg(cycle < lastLimit+10*zinfo->maxPhaseLength+1000000, "Queued event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
 
     assert_msg(cycle >= domains[ev->domain].curCycle, "Queued event goes back in time, cycle %ld curCycle %ld", cycle, domains[ev->domain].curCycle);
     ev->privCycle = cycle;
@@ -196,6 +356,7 @@ void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) {
     assert(ev->domain < (int32_t)numDomains);
 
     domains[ev->domain].pq.enqueue(ev, cycle);
+    recordPqOp(domains[ev->domain], cycle, false);
 }
 
 void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) {
@@ -208,10 +369,11 @@ void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) {
 
     assert_msg(cycle >= lastLimit, "Enqueued (synced) event before last limit! cycle %ld min %ld", cycle, lastLimit);
     //Hacky, but helpful to chase events scheduled too far ahead due to bugs (e.g., cycle -1). We should probably formalize this a bit more
-    assert_msg(cycle < lastLimit+10*zinfo->phaseLength+10000, "Queued  (synced) event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
+    assert_msg(cycle < lastLimit+10*zinfo->maxPhaseLength+10000, "Queued  (synced) event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
     ev->privCycle = cycle;
     assert(ev->numParents == 0);
     domains[ev->domain].pq.enqueue(ev, cycle);
+    recordPqOp(domains[ev->domain], cycle, false);
 
     futex_unlock(&domains[domain].pqLock);
 }
@@ -280,7 +442,7 @@ void ContentionSim::simThreadLoop(uint32_t thid) {
         //info("%d --- phase end", domain);
 
         uint32_t val = __sync_add_and_fetch(&threadsDone, 1);
-        if (val == numSimThreads) {
+        if (val == threadsWoken) {
             threadsDone = 0;
             futex_unlock(&waitLock); //unblock caller
         }
@@ -289,130 +451,192 @@ void ContentionSim::simThreadLoop(uint32_t thid) {
 }
 
 void ContentionSim::simulatePhaseThread(uint32_t thid) {
-    uint32_t thDomains = simThreads[thid].supDomain - simThreads[thid].firstDomain;
-    uint32_t numFinished = 0;
-
-    if (thDomains == 1) {
-        DomainData& domain = domains[simThreads[thid].firstDomain];
-        domain.profTime.start();
-        PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain.pq;
-        while (pq.size() && pq.firstCycle() < limit) {
-            uint64_t domCycle = domain.curCycle;
-            uint64_t cycle;
-            TimingEvent* te = pq.dequeue(cycle);
-            assert(cycle >= domCycle);
-            if (cycle != domCycle) {
-                domCycle = cycle;
-                domain.curCycle = cycle;
+    SimThreadData& th = simThreads[thid];
+    th.profTime.start();
+    bool idle = false;
+    while (domainsLeft) {
+        uint32_t domain;
+        bool found = takeDomain(thid, false, domain);
+        if (!found || domains[domain].prio) {
+            //Nothing runnable at home, so try to steal runnable work before polling a stalled domain
+            uint32_t stolen;
+            if (stealDomain(thid, found, stolen)) {
+                if (found) queueDomain(thid, domain);
+                domain = stolen;
+                found = true;
             }
-            te->run(cycle);
-            uint64_t newCycle = pq.size()? pq.firstCycle() : limit;
-            assert(newCycle >= domCycle);
-            if (newCycle != domCycle) domain.curCycle = newCycle;
-#if POST_MORTEM
-            simThreads[thid].logVec.push_back(std::make_pair(cycle, te));
-#endif
         }
-        domain.curCycle = limit;
-        domain.profTime.end();
+
+        if (!found) {
+            //Every unfinished domain is being simulated by another thread
+            if (!idle) {
+                idle = true;
+                th.profIdleTime.start();
+            }
+            continue;
+        }
+        if (idle) {
+            idle = false;
+            th.profIdleTime.end();
+        }
+
+        if (simulateDomain(thid, domain)) __sync_fetch_and_sub(&domainsLeft, 1);
+        else queueDomain(thid, domain);
+    }
+    if (idle) th.profIdleTime.end();
+    th.profTime.end();
 
 #if POST_MORTEM
-        //Post-mortem
-        if (limit % 10000000 == 0)  {
-            futex_lock(&postMortemLock); //serialize output
-            uint32_t uniqueEvs = 0;
-            std::unordered_map<TimingEvent*, std::string> evsSeen;
-            for (std::pair<uint64_t, TimingEvent*> p : simThreads[thid].logVec) {
-                uint64_t cycle = p.first;
-                TimingEvent* te = p.second;
-                std::string desc = evsSeen[te];
-                if (desc == "") { //non-existnt
-                    std::stringstream ss;
-                    ss << uniqueEvs << " " << typeid(*te).name();
-                    CrossingEvent* ce = dynamic_cast<CrossingEvent*>(te);
-                    if (ce) {
-                        ss << " slack " << (ce->preSlack + ce->postSlack) << " osc " << ce->origStartCycle << " cnt " << ce->simCount;
-                    }
-
-                    evsSeen[te] = ss.str();
-                    uniqueEvs++;
-                    desc = ss.str();
+    //Post-mortem
+    if (limit % 10000000 == 0)  {
+        futex_lock(&postMortemLock); //serialize output
+        uint32_t uniqueEvs = 0;
+        std::unordered_map<TimingEvent*, std::string> evsSeen;
+        for (std::pair<uint64_t, TimingEvent*> p : th.logVec) {
+            uint64_t cycle = p.first;
+            TimingEvent* te = p.second;
+            std::string desc = evsSeen[te];
+            if (desc == "") { //non-existnt
+                std::stringstream ss;
+                ss << uniqueEvs << " " << typeid(*te).name();
+                CrossingEvent* ce = dynamic_cast<CrossingEvent*>(te);
+                if (ce) {
+                    ss << " slack " << (ce->preSlack + ce->postSlack) << " osc " << ce->origStartCycle << " cnt " << ce->simCount;
                 }
-                info("[%d] %ld %s", thid, cycle, desc.c_str());
+
+                evsSeen[te] = ss.str();
+                uniqueEvs++;
+                desc = ss.str();
             }
-            futex_unlock(&postMortemLock);
+            info("[%d] %ld %s", thid, cycle, desc.c_str());
         }
-        simThreads[thid].logVec.clear();
+        futex_unlock(&postMortemLock);
+    }
+    th.logVec.clear();
 #endif
 
-    } else {
-        //info("XXX %d / %d %d %d", thid, thDomains, simThreads[thid].supDomain, simThreads[thid].firstDomain);
+    //info("Phase done");
+    __sync_synchronize();
+}
 
-        std::priority_queue<DomainData*, std::vector<DomainData*>, CompareDomains> domPq;
-        for (uint32_t i = simThreads[thid].firstDomain; i < simThreads[thid].supDomain; i++) {
-            domPq.push(&domains[i]);
+bool ContentionSim::simulateDomain(uint32_t thid, uint32_t d) {
+    DomainData& domain = domains[d];
+    SimThreadData& th = simThreads[thid];
+    PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain.pq;
+    WeaveProfiler* prof = zinfo->weaveProfiler;
+    domain.profTime.start();
+
+    /* Other domains only use curCycle as a lower bound on the cycle of our
+     * next event, so it's safe to publish it late. With batching, we publish
+     * it once per batch: a batch ends at the end of the 64-cycle block (or
+     * limit) where it started, or as soon as a crossing stalls, because its
+     * source domain may be waiting on our progress.
+     */
+    uint64_t batchEnd = 0; //exclusive
+    bool inBatch = false;
+    while (pq.size() && pq.firstCycle() < limit) {
+        uint64_t cycle;
+        TimingEvent* te = pq.dequeue(cycle);
+        recordPqOp(domain, cycle, true);
+        assert(cycle >= domain.curCycle);
+        if (!inBatch) {
+            batchEnd = batchEvents? MIN(limit, (cycle/64 + 1)*64) : 0;
+            inBatch = true;
         }
 
-        std::vector<DomainData*> sq1;
-        std::vector<DomainData*> sq2;
-
-        std::vector<DomainData*>& stalledQueue = sq1;
-        std::vector<DomainData*>& nextStalledQueue = sq2;
-
-        while (numFinished < thDomains) {
-            while (domPq.size()) {
-                DomainData* domain = domPq.top();
-                domPq.pop();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
-                if (!pq.size() || pq.firstCycle() > limit) {
-                    numFinished++;
-                    domain->curCycle = limit;
-                } else {
-                    //info("YYY %d %ld %ld %d", numFinished, domPq.size(), domain->curCycle, domain->prio);
-                    uint64_t cycle;
-                    TimingEvent* te = pq.dequeue(cycle);
-                    //uint64_t nextCycle = pq.size()? pq.firstCycle() : cycle;
-                    if (cycle != domain->curCycle) domain->curCycle = cycle;
-                    te->run(cycle);
-                    domain->curCycle = pq.size()? pq.firstCycle() : limit;
-                    domain->queuePrio = domain->curCycle;
-                    if (domain->prio == 0) domPq.push(domain);
-                    else stalledQueue.push_back(domain);
-                }
-            }
+        TimingEventType type = te->getType(); //te may be freed by run()
+        if (unlikely(prof != nullptr)) {
+            prof->eventRun(d, te, cycle);
+            uint64_t startTsc = rdtsc();
+            te->run(cycle);
+            prof->eventSimulated(d, type, rdtsc() - startTsc);
+        } else {
+            te->run(cycle);
+        }
+        th.profEvents.inc();
+        domain.profEvents.inc();
+        domain.profEventTypes.inc(type);
+#if POST_MORTEM
+        th.logVec.push_back(std::make_pair(cycle, te));
+#endif
 
-            while (stalledQueue.size()) {
-                DomainData* domain = stalledQueue.back();
-                stalledQueue.pop_back();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
-                if (!pq.size() || pq.firstCycle() > limit) {
-                    numFinished++;
-                    domain->curCycle = limit;
-                } else {
-                    //info("SSS %d %ld %ld", numFinished, stalledQueue.size(), domain->curCycle);
-                    uint64_t cycle;
-                    TimingEvent* te = pq.dequeue(cycle);
-                    if (cycle != domain->curCycle) domain->curCycle = cycle;
-                    te->state = EV_RUNNING;
-                    te->simulate(cycle);
-                    domain->curCycle = pq.size()? pq.firstCycle() : limit;
-                    domain->queuePrio = domain->curCycle;
-                    if (domain->prio == 0) domPq.push(domain);
-                    else nextStalledQueue.push_back(domain);
-                }
-                if (domPq.size()) break;
+        uint64_t newCycle = pq.size()? pq.firstCycle() : limit;
+        assert(newCycle >= cycle);
+        if (newCycle >= batchEnd || domain.prio) {
+            inBatch = false;
+            if (newCycle != domain.curCycle) domain.curCycle = newCycle;
+            //Stalled on a crossing: if other domains are waiting to run, let them; otherwise, keep polling
+            if (domain.prio && domainsQueued()) {
+                domain.profTime.end();
+                return false;
             }
-            if (!stalledQueue.size()) std::swap(stalledQueue, nextStalledQueue);
         }
     }
+    domain.curCycle = limit;
+    domain.profTime.end();
+    return true;
+}
 
-    //info("Phase done");
-    __sync_synchronize();
+bool ContentionSim::takeDomain(uint32_t thid, bool runnableOnly, uint32_t& domain) {
+    SimThreadData& th = simThreads[thid];
+    if (!th.runQueueSize) return false; //racy check avoids taking the lock on empty queues
+    futex_lock(&th.queueLock);
+    uint32_t best = th.runQueueSize; //invalid
+    for (uint32_t i = 0; i < th.runQueueSize; i++) {
+        DomainData& cand = domains[th.runQueue[i]];
+        if (runnableOnly && cand.prio) continue;
+        if (best == th.runQueueSize) {
+            best = i;
+        } else {
+            DomainData& cur = domains[th.runQueue[best]];
+            bool candFirst = (cand.prio == 0 && cur.prio != 0) ||
+                ((cand.prio == 0) == (cur.prio == 0) && cand.curCycle < cur.curCycle);
+            if (candFirst) best = i;
+        }
+    }
+    bool found = best < th.runQueueSize;
+    if (found) {
+        domain = th.runQueue[best];
+        th.runQueue[best] = th.runQueue[th.runQueueSize - 1];
+        th.runQueueSize--;
+    }
+    futex_unlock(&th.queueLock);
+    return found;
+}
+
+bool ContentionSim::stealDomain(uint32_t thid, bool runnableOnly, uint32_t& domain) {
+    for (uint32_t i = 1; i < numSimThreads; i++) {
+        uint32_t victim = (thid + i) % numSimThreads;
+        if (takeDomain(victim, runnableOnly, domain)) {
+            simThreads[thid].profSteals.inc();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ContentionSim::queueDomain(uint32_t thid, uint32_t domain) {
+    SimThreadData& th = simThreads[thid];
+    futex_lock(&th.queueLock);
+    assert(th.runQueueSize < numDomains);
+    th.runQueue[th.runQueueSize++] = domain;
+    futex_unlock(&th.queueLock);
+}
+
+bool ContentionSim::domainsQueued() const {
+    for (uint32_t i = 0; i < numSimThreads; i++) {
+        if (simThreads[i].runQueueSize) return true;
+    }
+    return false;
 }
 
 void ContentionSim::finish() {
     assert(!terminate);
     terminate = true;
     __sync_synchronize();
+    if (zinfo->weaveProfiler) zinfo->weaveProfiler->finish();
+#if RECORD_PQ_TRACE
+    for (uint32_t i = 0; i < numDomains; i++) fclose(domains[i].pqTrace);
+#endif
 }
 
@@ -28,6 +28,7 @@
 
 #include <functional>
 #include <stdint.h>
+#include <stdio.h>
 #include <vector>
 #include "bithacks.h"
 #include "event_recorder.h"
@@ -43,6 +44,10 @@
 #define PROFILE_CROSSINGS 0
 //#define PROFILE_CROSSINGS 1
 
+//Set to 1 to record every domain's event queue operations to pqtrace-<domain>.bin, to replay them with pqbench
+#define RECORD_PQ_TRACE 0
+//#define RECORD_PQ_TRACE 1
+
 class TimingEvent;
 class DelayEvent;
 class CrossingEvent;
@@ -62,6 +67,8 @@ class ContentionSim : public GlobAlloc {
 
         CrossingEventInfo* lastCrossing; //indexed by [srcId*doms*doms + srcDom*doms + dstDom]
 
+        uint64_t* crossingCounts; //completed crossings, indexed by [dstDom*doms + srcDom]; only allocated when profiling domains
+
         struct DomainData : public GlobAlloc {
             PrioQueue<TimingEvent, PQ_BLOCKS> pq;
 
@@ -71,12 +78,19 @@ class ContentionSim : public GlobAlloc {
             lock_t pqLock; //used on phase 1 enqueues
             //lock_t domainLock; //used by simulation thread
 
-            uint32_t prio;
-            uint64_t queuePrio;
+            uint32_t prio; //0 if runnable, != 0 if its first event is a crossing waiting on its source domain
 
             PAD();
 
             ClockStat profTime;
+            Counter profEvents;
+            Counter profSkips;
+            Counter profCrossingStalls;
+            VectorCounter profEventTypes; //indexed by TimingEventType
+
+#if RECORD_PQ_TRACE
+            FILE* pqTrace; //one uint64_t per op, cycle << 1 | isDequeue
+#endif
 
 #if PROFILE_CROSSINGS
             VectorCounter profIncomingCrossingSims;
@@ -85,14 +99,38 @@ class ContentionSim : public GlobAlloc {
 #endif
         };
 
-        struct CompareDomains : public std::binary_function<DomainData*, DomainData*, bool> {
-             bool operator()(DomainData* d1, DomainData* d2) const;
-        };
-
+        /* Domains are simulated by a pool of threads with work stealing. Each
+         * thread has a run queue of domains that are not finished for this
+         * phase and not being simulated; at the start of every phase, it holds
+         * the thread's home domains. A thread simulates one domain at a time,
+         * and gives it up when the domain finishes the phase or stalls on a
+         * crossing while other domains are waiting to run. Threads without
+         * runnable domains steal them from other threads' queues. Since a
+         * domain is only simulated by one thread at a time and crossings poll
+         * their source domain's curCycle, this works with any thread count.
+         *
+         * Home domains are assigned between phases. Memory channel domains
+         * (sys.mem.separateDomains) receive crossings from every core, so they
+         * are spread across threads first; the rest are split in contiguous
+         * ranges. With sim.weaveRebalancePhases, the assignment is redone
+         * periodically from the weave time each domain took (channel domains
+         * still first, then longest-first onto the least loaded thread).
+         */
         struct SimThreadData {
             lock_t wakeLock; //used to sleep/wake up simulation thread
-            uint32_t firstDomain;
-            uint32_t supDomain; //supreme, ie first not included
+            uint32_t* homeDomains; //queued on this thread at the start of each phase; numDomains entries
+            uint32_t numHomeDomains;
+
+            lock_t queueLock; //protects the run queue, which other threads steal from
+            uint32_t* runQueue; //numDomains entries
+            volatile uint32_t runQueueSize;
+            bool awake; //woken up for the current phase (had home domains with events)
+
+            Counter profEvents;
+            Counter profSteals;
+            Counter profWakeups;
+            ClockStat profTime;
+            ClockStat profIdleTime;
 
             std::vector<std::pair<uint64_t, TimingEvent*> > logVec;
         };
@@ -106,6 +144,13 @@ class ContentionSim : public GlobAlloc {
         uint32_t numDomains;
         uint32_t numSimThreads;
         bool skipContention;
+        bool batchEvents; //if set, domains publish curCycle once per batch of events instead of once per event
+
+        bool* channelDomains; //memory channel domains, spread across threads
+        uint32_t rebalancePhases; //0 to keep the initial home domains
+        uint32_t phasesSinceRebalance;
+        uint64_t* lastDomainTime; //domain weave time at the last rebalance
+        Counter profRebalances;
 
         PAD();
 
@@ -116,6 +161,8 @@ class ContentionSim : public GlobAlloc {
         volatile bool terminate;
 
         volatile uint32_t threadsDone;
+        uint32_t threadsWoken; //threads simulating the current phase; the rest sleep through it
+        volatile uint32_t domainsLeft; //domains not yet done with the current phase
         volatile uint32_t threadTicket; //used only at init
 
         volatile bool inCSim; //true when inside contention simulation
@@ -126,7 +173,7 @@ class ContentionSim : public GlobAlloc {
         lock_t postMortemLock;
 
     public:
-        ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads);
+        ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads, bool _batchEvents, uint32_t _rebalancePhases);
 
         void initStats(AggregateStat* parentStat);
 
@@ -151,6 +198,30 @@ class ContentionSim : public GlobAlloc {
 
         void setPrio(uint32_t domain, uint32_t prio) {domains[domain].prio = prio;}
 
+        //Called at init by memory controllers that have their own domain
+        void setChannelDomain(uint32_t domain) {
+            assert(domain < numDomains);
+            channelDomains[domain] = true;
+        }
+
+        //Load profiling, used by DomainMapper
+        void enableCrossingCounts();
+        uint64_t getDomainTime(uint32_t domain) const {return domains[domain].profTime.get();}
+        uint64_t getDomainEvents(uint32_t domain) const {return domains[domain].profEvents.get();}
+        uint64_t getCrossings(uint32_t srcDomain, uint32_t dstDomain) const {
+            return crossingCounts? crossingCounts[dstDomain*numDomains + srcDomain] : 0;
+        }
+
+        //Called by the thread simulating dstDomain, so each row has a single writer
+        void countCrossing(uint32_t srcDomain, uint32_t dstDomain) {
+            if (unlikely(crossingCounts != nullptr)) crossingCounts[dstDomain*numDomains + srcDomain]++;
+        }
+
+        //Crossing runs that had to wait on their source domain, used by the phase length controller
+        void countCrossingStall(uint32_t dstDomain) {domains[dstDomain].profCrossingStalls.inc();}
+        uint64_t getCrossingStalls() const;
+        uint64_t getCrossingRuns() const;
+
 #if PROFILE_CROSSINGS
         void profileCrossing(uint32_t srcDomain, uint32_t dstDomain, uint32_t count) {
             domains[dstDomain].profIncomingCrossings.inc(srcDomain);
@@ -160,9 +231,28 @@ class ContentionSim : public GlobAlloc {
 #endif
 
     private:
+        inline void recordPqOp(DomainData& domain, uint64_t cycle, bool isDequeue) {
+#if RECORD_PQ_TRACE
+            uint64_t rec = (cycle << 1) | (isDequeue? 1 : 0);
+            fwrite(&rec, sizeof(rec), 1, domain.pqTrace);
+#endif
+        }
+
+        //Assigns home domains to threads; with loads, balances them, otherwise uses the static assignment
+        void assignHomeDomains(const uint64_t* loads);
+
         void simThreadLoop(uint32_t thid);
         void simulatePhaseThread(uint32_t thid);
 
+        //Returns true if the domain finished the phase, false if it gave up on a stalled crossing
+        bool simulateDomain(uint32_t thid, uint32_t domain);
+
+        //Run queue ops; take picks runnable domains before stalled ones, then the one with the lowest curCycle
+        bool takeDomain(uint32_t thid, bool runnableOnly, uint32_t& domain);
+        bool stealDomain(uint32_t thid, bool runnableOnly, uint32_t& domain);
+        void queueDomain(uint32_t thid, uint32_t domain);
+        bool domainsQueued() const;
+
         static void SimThreadTrampoline(void* arg);
 };
 
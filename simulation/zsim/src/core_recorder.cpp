@@ -38,7 +38,7 @@ class TimingCoreEvent : public TimingEvent {
 
     public:
         //NOTE: Only the first TimingCoreEvent after a thread join needs to be in a domain, hence the default parameter. Because these are inherently sequential and have a fixed delay, subsequent events can inherit the parent's domain, reducing domain xings and improving slack and performance
-        TimingCoreEvent(uint64_t _delay, uint64_t _origStartCycle, CoreRecorder* _cRec, int32_t domain = -1) : TimingEvent(0, _delay, domain), origStartCycle(_origStartCycle), cRec(_cRec) {}
+        TimingCoreEvent(uint64_t _delay, uint64_t _origStartCycle, CoreRecorder* _cRec, int32_t domain = -1) : TimingEvent(0, _delay, domain), origStartCycle(_origStartCycle), cRec(_cRec) {setType(EVT_CORE);}
 
         void simulate(uint64_t _startCycle) {
             startCycle = _startCycle;
@@ -64,6 +64,16 @@ CoreRecorder::CoreRecorder(uint32_t _domain, g_string& _name)
 
 
 uint64_t CoreRecorder::notifyJoin(uint64_t curCycle) {
+    if (unlikely(zinfo->analyticalContention)) {
+        //No events or weave phase, so we only keep cycle accounting; there is no DRAINING state
+        assert(state == HALTED);
+        curCycle = MAX(curCycle, zinfo->globPhaseCycles);
+        assert(lastUnhaltedCycle <= curCycle);
+        totalHaltedCycles += curCycle - lastUnhaltedCycle;
+        state = RUNNING;
+        return curCycle;
+    }
+
     if (state == HALTED) {
         assert(!prevRespEvent);
         curCycle = zinfo->globPhaseCycles; //start at beginning of the phase
@@ -95,6 +105,11 @@ uint64_t CoreRecorder::notifyJoin(uint64_t curCycle) {
 
 void CoreRecorder::notifyLeave(uint64_t curCycle) {
     assert(state == RUNNING);
+    if (unlikely(zinfo->analyticalContention)) {
+        lastUnhaltedCycle = curCycle;
+        state = HALTED;
+        return;
+    }
     state = DRAINING;
     assert(prevRespEvent);
     //Taper off the event
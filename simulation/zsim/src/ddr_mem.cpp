@@ -26,11 +26,10 @@
 #include "ddr_mem.h"
 #include <algorithm>
 #include <string>
-#include <vector>
 #include "bithacks.h"
-#include "config.h"  // for Tokenize
 #include "contention_sim.h"
 #include "event_recorder.h"
+#include "mem_ctrls.h"
 #include "timing_event.h"
 #include "zsim.h"
 
@@ -43,13 +42,15 @@ class DDRMemoryAccEvent : public TimingEvent {
         DDRMemory* mem;
         Address addr;
         bool write;
+        uint32_t srcId;
 
     public:
-        DDRMemoryAccEvent(DDRMemory* _mem, bool _isWrite, Address _addr, int32_t domain, uint32_t preDelay, uint32_t postDelay)
-            : TimingEvent(preDelay, postDelay, domain), mem(_mem), addr(_addr), write(_isWrite) {}
+        DDRMemoryAccEvent(DDRMemory* _mem, bool _isWrite, Address _addr, uint32_t _srcId, int32_t domain, uint32_t preDelay, uint32_t postDelay)
+            : TimingEvent(preDelay, postDelay, domain), mem(_mem), addr(_addr), write(_isWrite), srcId(_srcId) {setType(EVT_MEM_ACCESS);}
 
         Address getAddr() const {return addr;}
         bool isWrite() const {return write;}
+        uint32_t getSrcId() const {return srcId;}
 
         void simulate(uint64_t startCycle) {
             mem->enqueue(this, startCycle);
@@ -67,6 +68,8 @@ class RefreshEvent : public TimingEvent, public GlobAlloc {
             TimingEvent(0, 0, domain), mem(_mem), refInterval(_refInterval)
         {
             setMinStartCycle(0);
+            setType(EVT_MEM_REFRESH);
+            setParentDoneKind(PD_VIRTUAL);
             zinfo->contentionSim->enqueueSynced(this, 0);
         }
 
@@ -101,6 +104,8 @@ class SchedEvent : public TimingEvent, public GlobAlloc {
 
         SchedEvent(DDRMemory* _mem, int32_t domain) : TimingEvent(0, 0, domain), mem(_mem) {
             setMinStartCycle(0);
+            setType(EVT_MEM_SCHED);
+            setParentDoneKind(PD_VIRTUAL);
             setRunning();
             hold();
             state = IDLE;
@@ -151,12 +156,13 @@ class SchedEvent : public TimingEvent, public GlobAlloc {
 /* Init & bound phase functionality */
 
 DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerChannel, uint32_t _banksPerRank,
-        uint32_t _sysFreqMHz, const char* tech, const char* addrMapping, uint32_t _controllerSysLatency,
-        uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage,
-        uint32_t _domain, g_string& _name)
+        uint32_t _sysFreqMHz, const char* tech, const char* addrMapping, bool bankHash, uint32_t _controllerSysLatency,
+        uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage, uint32_t _powerDownCycles,
+        uint32_t _writeBufferSize, DDRSchedPolicy* _sched, uint32_t _domain, g_string& _name)
     : lineSize(_lineSize), ranksPerChannel(_ranksPerChannel), banksPerRank(_banksPerRank),
       controllerSysLatency(_controllerSysLatency), queueDepth(_queueDepth), rowHitLimit(_rowHitLimit),
-      deferredWrites(_deferredWrites), closedPage(_closedPage), domain(_domain), name(_name)
+      deferredWrites(_deferredWrites), closedPage(_closedPage), powerDownCycles(_powerDownCycles),
+      writeBufferSize(_writeBufferSize), domain(_domain), sched(_sched), name(_name)
 {
     sysFreqKHz = 1000 * _sysFreqMHz;
     initTech(tech);  // sets all tXX and memFreqKHz
@@ -164,6 +170,7 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
         panic("You may need to tweak the scheduling code, which works with system cycles." \
             "With these frequencies, events (which run on system cycles) can't hit us every memory cycle.");
     }
+    if (banksPerRank % bankGroups) panic("%s: %d banks/rank can't be split in %d bank groups (tech %s)", name.c_str(), banksPerRank, bankGroups, tech);
 
     minRdLatency = controllerSysLatency + memToSysCycle(tCL+tBL-1);
     minWrLatency = controllerSysLatency;
@@ -173,9 +180,17 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
 
     rdQueue.init(queueDepth);
     wrQueue.init(queueDepth);
+    nextArrivalSeq = 0;
+    nextWcbSeq = 0;
+    if (writeBufferSize && !deferredWrites) panic("%s: the write-combining buffer needs deferred writes", name.c_str());
 
-    info("%s: domain %d, %d ranks/ch %d banks/rank, tech %s, boundLat %d rd / %d wr",
-            name.c_str(), domain, ranksPerChannel, banksPerRank, tech, minRdLatency, minWrLatency);
+    numSources = std::max(1u, zinfo->numCores);
+    srcQueuedReads.resize(numSources, 0);
+    srcBankQueuedReads.resize(numSources*ranksPerChannel*banksPerRank, 0);
+    srcInterfCycles.resize(numSources, 0);
+
+    info("%s: domain %d, %d ranks/ch %d banks/rank (%d groups), tech %s (gear %d), boundLat %d rd / %d wr",
+            name.c_str(), domain, ranksPerChannel, banksPerRank, bankGroups, tech, gear, minRdLatency, minWrLatency);
 
     minRespCycle = tCL + tBL + 1; // We subtract tCL + tBL from this on some checks; this avoids overflows
 
@@ -185,44 +200,42 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
     rankActWindows.resize(ranksPerChannel);
     for (uint32_t i = 0; i < ranksPerChannel; i++) rankActWindows[i].init(4);  // we only model FAW; for TAW (other technologies) change this to 2
 
-    // We get line addresses, and for a 64-byte line, there are _colSize/(JEDEC_BUS_WIDTH/8) lines/page
-    uint32_t colBits = ilog2(_colSize/(JEDEC_BUS_WIDTH/8)*64/lineSize);
-    uint32_t bankBits = ilog2(banksPerRank);
-    uint32_t rankBits = ilog2(ranksPerChannel);
+    GroupTiming gt = {0, 0};
+    groupTimings.resize(ranksPerChannel*bankGroups, gt);
+    rankLastActCycles.resize(ranksPerChannel, 0);
 
-    // Parse config string, has to be some combination of rank, bank, and col separated by semicolons
-    // (row is always MSB bits, since we don't actually know how many bits it is to begin with...)
-    std::vector<std::string> tokens;
-    Tokenize(addrMapping, tokens, ":");
-    if (tokens.size() != 3) panic("Invalid addrMapping %s, need all row/col/rank tokens separated by colons", addrMapping);
-    std::reverse(tokens.begin(), tokens.end()); // want lowest bits first
-
-    colMask = rankMask = bankMask = 0;
-    uint32_t startBit = 0;
-    auto computeShiftAndMask = [&startBit, addrMapping](const std::string& field, const uint32_t fieldBits, uint32_t& shift, uint32_t& mask) {
-        if (mask) panic("Repeated field %s in addrMapping %s", field.c_str(), addrMapping);
-        shift = startBit;
-        mask = (1 << fieldBits) - 1;
-        startBit += fieldBits;
-    };
-    for (auto t : tokens) {
-        if (t == "col")       computeShiftAndMask(t, colBits,  colShift,  colMask);
-        else if (t == "rank") computeShiftAndMask(t, rankBits, rankShift, rankMask);
-        else if (t == "bank") computeShiftAndMask(t, bankBits, bankShift, bankMask);
-        else panic("Invalid token %s in addrMapping %s (only row/col/rank)", t.c_str(), addrMapping);
-    }
-    rowShift = startBit;  // row has no mask
+    RankPower rp = {0, 0, 0};  // all banks start closed
+    rankPower.resize(ranksPerChannel, rp);
 
-    info("%s: Address mapping %s row %d:%ld col %d:%d rank %d:%d bank %d:%d",
-            name.c_str(), addrMapping, 63, rowShift, ilog2(colMask << colShift), colShift,
-            ilog2(rankMask << rankShift), rankShift, ilog2(bankMask << bankShift), bankShift);
+    // We get line addresses, and for a 64-byte line, there are _colSize/(busWidth/8) lines/page
+    uint32_t colLines = _colSize/(busWidth/8)*64/lineSize;
 
-    // Weave phase events
-    new RefreshEvent(this, memToSysCycle(tREFI), domain);
+    // Mapping has to be some combination of rank, bank, and col separated by colons
+    // (row is always MSB bits, since we don't actually know how many bits it is to begin with...)
+    // With bankHash, rank and bank indexes are XORed with the row bits
+    addrMapper = new AddrMapper(addrMapping, {
+            {"col", colLines, false},
+            {"rank", ranksPerChannel, bankHash},
+            {"bank", banksPerRank, bankHash}});
+
+    info("%s: Address mapping %s (%s)", name.c_str(), addrMapping, addrMapper->toString().c_str());
 
     nextSchedCycle = -1ul;
     nextSchedEvent = nullptr;
     eventFreelist = nullptr;
+
+    if (zinfo->analyticalContention) {
+        // No weave phase: model the data bus as an M/D/1 server that refreshes take their share of,
+        // and track open rows in the bound phase to charge row misses
+        burstSysCycles = std::max(1ul, tBL*sysFreqKHz/memFreqKHz);
+        busModel = new MD1Model(1.0 - ((double)tRFC)/tREFI, burstSysCycles);
+        boundOpenRows.resize(ranksPerChannel*banksPerRank, -1ul);
+        rowMissSysCycles = memToSysCycle(closedPage? tRCD : tRP + tRCD);
+    } else {
+        busModel = nullptr;
+        // Weave phase events
+        new RefreshEvent(this, memToSysCycle(tREFI), domain);
+    }
 }
 
 void DDRMemory::initStats(AggregateStat* parentStat) {
@@ -234,7 +247,83 @@ void DDRMemory::initStats(AggregateStat* parentStat) {
     profTotalWrLat.init("wrlat", "Total latency experienced by write requests"); memStats->append(&profTotalWrLat);
     profReadHits.init("rdhits", "Read row hits"); memStats->append(&profReadHits);
     profWriteHits.init("wrhits", "Write row hits"); memStats->append(&profWriteHits);
+    profSchedCalls.init("schedCalls", "Scheduling decisions"); memStats->append(&profSchedCalls);
+    profSchedEvals.init("schedEvals", "Bank timing constraint evaluations by the scheduler"); memStats->append(&profSchedEvals);
+    profBankAccs.init("bankAccs", "Requests per bank (rank*banksPerRank + bank)", ranksPerChannel*banksPerRank); memStats->append(&profBankAccs);
+    if (writeBufferSize) {
+        AggregateStat* wcbStats = new AggregateStat();
+        wcbStats->init("wcb", "Write-combining buffer stats");
+        profWcbWrites.init("writes", "Writes received"); wcbStats->append(&profWcbWrites);
+        profWcbMerges.init("merges", "Writes merged with a buffered write to the same line"); wcbStats->append(&profWcbMerges);
+        profWcbBatches.init("batches", "Row batches drained to the write queue"); wcbStats->append(&profWcbBatches);
+        profWcbBatchWrites.init("batchWrites", "Writes drained in row batches"); wcbStats->append(&profWcbBatchWrites);
+        auto mergeRate = [this]() { return profWcbWrites.get()? 1000*profWcbMerges.get()/profWcbWrites.get() : 0; };
+        auto mergeRateStat = makeLambdaStat(mergeRate);
+        mergeRateStat->init("mergeRate", "Fraction of writes merged (x1000)");
+        wcbStats->append(mergeRateStat);
+        // Row hit rate of issued writes; compare against writeBufferSize = 0 to see the buffer's improvement
+        auto wrHitRate = [this]() { return profWrites.get()? 1000*profWriteHits.get()/profWrites.get() : 0; };
+        auto wrHitRateStat = makeLambdaStat(wrHitRate);
+        wrHitRateStat->init("wrHitRate", "Row hit rate of issued writes (x1000)");
+        wcbStats->append(wrHitRateStat);
+        memStats->append(wcbStats);
+    }
     latencyHist.init("mlh", "latency histogram for memory requests", NUMBINS); memStats->append(&latencyHist);
+
+    // Per-core bandwidth shares and slowdowns
+    profCoreReqs.init("coreReqs", "Requests served per core", numSources); memStats->append(&profCoreReqs);
+    profCoreRdLat.init("coreRdLat", "Total read latency per core", numSources); memStats->append(&profCoreRdLat);
+    profCoreRdInterf.init("coreRdInterf", "Read latency caused by other cores' requests, per core", numSources); memStats->append(&profCoreRdInterf);
+    auto bwShare = [this](uint32_t s) {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < numSources; i++) total += profCoreReqs.count(i);
+        return total? 1000*profCoreReqs.count(s)/total : 0;
+    };
+    auto bwShareStat = makeLambdaVectorStat(bwShare, numSources);
+    bwShareStat->init("coreBwShare", "Share of requests served per core (x1000)");
+    memStats->append(bwShareStat);
+    auto slowdown = [this](uint32_t s) {
+        uint64_t lat = profCoreRdLat.count(s);
+        uint64_t aloneLat = lat - profCoreRdInterf.count(s);
+        return aloneLat? 1000*lat/aloneLat : 1000;
+    };
+    auto slowdownStat = makeLambdaVectorStat(slowdown, numSources);
+    slowdownStat->init("coreSlowdown", "Estimated memory latency slowdown per core vs running alone (x1000)");
+    memStats->append(slowdownStat);
+
+    // DRAM commands, power state residency and energy, per rank
+    AggregateStat* powerStats = new AggregateStat();
+    powerStats->init("power", "DRAM power and energy stats, per rank");
+    profRankActs.init("act", "ACT commands", ranksPerChannel); powerStats->append(&profRankActs);
+    profRankPres.init("pre", "PRE commands (incl. auto-precharges and refresh precharges)", ranksPerChannel); powerStats->append(&profRankPres);
+    profRankRds.init("rd", "RD commands", ranksPerChannel); powerStats->append(&profRankRds);
+    profRankWrs.init("wr", "WR commands", ranksPerChannel); powerStats->append(&profRankWrs);
+    profRankRefs.init("ref", "REF commands", ranksPerChannel); powerStats->append(&profRankRefs);
+    profRankActStby.init("actStby", "Cycles in active standby (some bank open)", ranksPerChannel); powerStats->append(&profRankActStby);
+    profRankPreStby.init("preStby", "Cycles in precharge standby (all banks closed)", ranksPerChannel); powerStats->append(&profRankPreStby);
+    profRankActPdn.init("actPdn", "Cycles in active power-down", ranksPerChannel); powerStats->append(&profRankActPdn);
+    profRankPrePdn.init("prePdn", "Cycles in precharge power-down", ranksPerChannel); powerStats->append(&profRankPrePdn);
+
+    const char* energyNames[] = {"actPreEnergy", "rdWrEnergy", "refEnergy", "bgEnergy"};
+    const char* energyDescs[] = {"ACT/PRE energy (pJ)", "RD/WR burst energy (pJ)", "Refresh energy (pJ)", "Background (standby and power-down) energy (pJ)"};
+    for (uint32_t c = 0; c < NUM_ENERGY_COMPONENTS; c++) {
+        auto energy = [this, c](uint32_t r) { return (uint64_t)getRankEnergy(r, (EnergyComponent)c); };
+        auto energyStat = makeLambdaVectorStat(energy, ranksPerChannel);
+        energyStat->init(energyNames[c], energyDescs[c]);
+        powerStats->append(energyStat);
+    }
+    auto totalEnergy = [this](uint32_t r) {
+        double e = 0.0;
+        for (uint32_t c = 0; c < NUM_ENERGY_COMPONENTS; c++) e += getRankEnergy(r, (EnergyComponent)c);
+        return (uint64_t)e;
+    };
+    auto totalEnergyStat = makeLambdaVectorStat(totalEnergy, ranksPerChannel);
+    totalEnergyStat->init("energy", "Total DRAM energy (pJ)");
+    powerStats->append(totalEnergyStat);
+    memStats->append(powerStats);
+
+    sched->initStats(memStats);
+    if (busModel) busModel->initStats(memStats);
     parentStat->append(memStats);
 }
 
@@ -261,9 +350,11 @@ uint64_t DDRMemory::access(MemReq& req) {
     } else {
         bool isWrite = (req.type == PUTX);
         uint64_t respCycle = req.cycle + (isWrite? minWrLatency : minRdLatency);
-        if (zinfo->eventRecorders[req.srcId]) {
+        if (busModel) {
+            respCycle += analyticalAccess(req.lineAddr, isWrite);
+        } else if (zinfo->eventRecorders[req.srcId]) {
             DDRMemoryAccEvent* memEv = new (zinfo->eventRecorders[req.srcId]) DDRMemoryAccEvent(this,
-                    isWrite, req.lineAddr, domain, preDelay, isWrite? postDelayWr : postDelayRd);
+                    isWrite, req.lineAddr, req.srcId, domain, preDelay, isWrite? postDelayWr : postDelayRd);
             memEv->setMinStartCycle(req.cycle);
             TimingRecord tr = {req.lineAddr, req.cycle, respCycle, req.type, memEv, memEv};
             zinfo->eventRecorders[req.srcId]->pushRecord(tr);
@@ -273,6 +364,41 @@ uint64_t DDRMemory::access(MemReq& req) {
     }
 }
 
+// Returns the latency to add to the minimum one. Bank state is updated without locks, since this is only an estimate
+uint64_t DDRMemory::analyticalAccess(Address lineAddr, bool isWrite) {
+    AddrLoc loc = mapLineAddr(lineAddr);
+    profBankAccs.atomicInc(loc.rank*banksPerRank + loc.bank);
+    uint64_t& openRow = boundOpenRows[loc.rank*banksPerRank + loc.bank];
+    bool rowHit = !closedPage && openRow == loc.row;
+    openRow = loc.row;
+
+    // Commands for the energy model (there is no residency; see getRankEnergy())
+    if (!rowHit) {
+        profRankActs.atomicInc(loc.rank);
+        profRankPres.atomicInc(loc.rank);
+    }
+    (isWrite? profRankWrs : profRankRds).atomicInc(loc.rank);
+
+    uint32_t busDelay = busModel->getDelay();
+    busModel->record(burstSysCycles);
+
+    if (isWrite) {
+        // Writes are posted, they only add load
+        profWrites.atomicInc();
+        profTotalWrLat.atomicInc(minWrLatency);
+        if (rowHit) profWriteHits.atomicInc();
+        return 0;
+    } else {
+        uint32_t extraDelay = busDelay + (rowHit? 0 : rowMissSysCycles);
+        uint32_t scDelay = minRdLatency + extraDelay;
+        profReads.atomicInc();
+        profTotalRdLat.atomicInc(scDelay);
+        if (rowHit) profReadHits.atomicInc();
+        latencyHist.atomicInc(std::min(NUMBINS-1, scDelay/BINSIZE));
+        return extraDelay;
+    }
+}
+
 /* Weave phase functionality */
 
 //Address mapping:
@@ -281,10 +407,10 @@ uint64_t DDRMemory::access(MemReq& req) {
 // Change or reorder to define your own mappings
 DDRMemory::AddrLoc DDRMemory::mapLineAddr(Address lineAddr) {
     AddrLoc l;
-    l.col  = (lineAddr >> colShift)  & colMask;
-    l.rank = (lineAddr >> rankShift) & rankMask;
-    l.bank = (lineAddr >> bankShift) & bankMask;
-    l.row  = lineAddr >> rowShift;
+    l.col  = addrMapper->get(lineAddr, COL_FIELD);
+    l.rank = addrMapper->get(lineAddr, RANK_FIELD);
+    l.bank = addrMapper->get(lineAddr, BANK_FIELD);
+    l.row  = addrMapper->top(lineAddr);
 
     //info("0x%lx r%ld:c%d b%d:r%d", lineAddr, l.row, l.col, l.bank, l.rank);
     assert(l.rank < ranksPerChannel);
@@ -297,6 +423,11 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
     uint64_t memCycle = sysToMemCycle(sysCycle);
     DEBUG("%ld: enqueue() addr 0x%lx wr %d", memCycle, ev->getAddr(), ev->isWrite());
 
+    if (writeBufferSize && ev->isWrite()) {
+        bufferWrite(ev, memCycle, sysCycle);
+        return;
+    }
+
     // Create request
     Request ovfReq;
     bool overflow = rdQueue.full() || wrQueue.full();
@@ -306,6 +437,12 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
     req->addr = ev->getAddr();
     req->loc = mapLineAddr(ev->getAddr());
     req->write = ev->isWrite();
+    req->srcId = ev->getSrcId();
+    req->bankId = req->loc.rank*banksPerRank + req->loc.bank;
+    req->marked = false;
+    req->buffered = false;
+    profBankAccs.inc(req->bankId);
+    assert(req->srcId < numSources);
 
     req->arrivalCycle = memCycle;
     req->startSysCycle = sysCycle;
@@ -321,30 +458,109 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
         // If needed, schedule an event to handle this new request
         if (!req->prev /* first in bank */) {
             uint64_t minSchedCycle = std::max(memCycle, minRespCycle - tCL - tBL);
-            if (nextSchedCycle > minSchedCycle) minSchedCycle = std::max(minSchedCycle, findMinCmdCycle(*req));
-            if (nextSchedCycle > minSchedCycle) {
-                if (nextSchedEvent) nextSchedEvent->annul();
-                if (eventFreelist) {
-                    nextSchedEvent = eventFreelist;
-                    eventFreelist = eventFreelist->next;
-                    nextSchedEvent->next = nullptr;
-                } else {
-                    nextSchedEvent = new SchedEvent(this, domain);
-                }
-                DEBUG("queued %ld", minSchedCycle);
+            if (nextSchedCycle > minSchedCycle) minSchedCycle = std::max(minSchedCycle, getHeadMinCmdCycle(banks[req->loc.rank][req->loc.bank], useWrQueue));
+            scheduleTick(minSchedCycle, sysCycle);
+        }
+    }
+}
+
+void DDRMemory::scheduleTick(uint64_t minSchedCycle, uint64_t sysCycle) {
+    if (nextSchedCycle > minSchedCycle) {
+        if (nextSchedEvent) nextSchedEvent->annul();
+        if (eventFreelist) {
+            nextSchedEvent = eventFreelist;
+            eventFreelist = eventFreelist->next;
+            nextSchedEvent->next = nullptr;
+        } else {
+            nextSchedEvent = new SchedEvent(this, domain);
+        }
+        DEBUG("queued %ld", minSchedCycle);
+
+        // Under memFreq < sysFreq/2, sysToMemCycle translates back to the same memCycle
+        uint64_t enqSysCycle = std::max(matchingMemToSysCycle(minSchedCycle), sysCycle);
+        nextSchedEvent->enqueue(enqSysCycle);
+        nextSchedCycle = minSchedCycle;
+    }
+}
+
+void DDRMemory::bufferWrite(DDRMemoryAccEvent* ev, uint64_t memCycle, uint64_t sysCycle) {
+    // Writes are posted, so respond right away
+    uint64_t respCycle = memToSysCycle(memCycle) + minWrLatency;
+    ev->done(respCycle - preDelay - postDelayWr);
 
-                // Under memFreq < sysFreq/2, sysToMemCycle translates back to the same memCycle
-                uint64_t enqSysCycle = std::max(matchingMemToSysCycle(minSchedCycle), sysCycle);
-                nextSchedEvent->enqueue(enqSysCycle);
-                nextSchedCycle = minSchedCycle;
+    profWcbWrites.inc();
+    Address addr = ev->getAddr();
+    if (wcbLines.count(addr)) {
+        // Overwrites a buffered write; never reaches DRAM
+        profWcbMerges.inc();
+        return;
+    }
+
+    Request req;
+    req.addr = addr;
+    req.loc = mapLineAddr(addr);
+    req.write = true;
+    req.srcId = ev->getSrcId();
+    req.bankId = req.loc.rank*banksPerRank + req.loc.bank;
+    req.marked = false;
+    req.buffered = true;
+    req.arrivalCycle = memCycle;
+    req.startSysCycle = sysCycle;
+    req.ev = nullptr;
+    profBankAccs.inc(req.bankId);
+    assert(req.srcId < numSources);
+
+    wcbLines.insert(addr);
+    WCBRow& row = wcbRows[req.loc.row*ranksPerChannel*banksPerRank + req.bankId];
+    if (row.reqs.empty()) row.firstSeq = nextWcbSeq++;
+    row.reqs.push_back(req);
+
+    if (wcbLines.size() >= writeBufferSize) {
+        uint64_t minSchedCycle = drainWriteBuffer(memCycle, writeBufferSize/2);
+        if (minSchedCycle != -1ul) scheduleTick(minSchedCycle, sysCycle);
+    } else if (nextSchedCycle == -1ul) {
+        // Controller is idle, so no tick would drain this write; schedule one
+        scheduleTick(std::max(memCycle, minRespCycle - tCL - tBL), sysCycle);
+    }
+}
+
+// Moves buffered writes to the write queue, a row at a time, fullest rows
+// first, until targetSize writes remain or the write queue fills up. Returns
+// the first cycle any new bank queue head can issue, or -1 if there are none.
+uint64_t DDRMemory::drainWriteBuffer(uint64_t memCycle, uint32_t targetSize) {
+    uint64_t minSchedCycle = -1ul;
+    while (wcbLines.size() > targetSize && !wrQueue.full()) {
+        assert(!wcbRows.empty());
+        auto best = wcbRows.begin();
+        for (auto it = wcbRows.begin(); it != wcbRows.end(); it++) {
+            size_t sz = it->second.reqs.size();
+            size_t bestSz = best->second.reqs.size();
+            if (sz > bestSz || (sz == bestSz && it->second.firstSeq < best->second.firstSeq)) best = it;
+        }
+
+        g_vector<Request>& reqs = best->second.reqs;
+        uint32_t batchWrites = std::min(reqs.size(), queueDepth - wrQueue.size());
+        for (uint32_t i = 0; i < batchWrites; i++) {
+            Request* req = wrQueue.alloc();
+            *req = reqs[i];
+            wcbLines.erase(req->addr);
+            queue(req, memCycle);
+            if (!req->prev /*first in bank queue*/) {
+                minSchedCycle = std::min(minSchedCycle, getHeadMinCmdCycle(banks[req->loc.rank][req->loc.bank], true));
             }
         }
+        reqs.erase(reqs.begin(), reqs.begin() + batchWrites);
+        if (reqs.empty()) wcbRows.erase(best);
+        profWcbBatches.inc();
+        profWcbBatchWrites.inc(batchWrites);
     }
+    if (minSchedCycle != -1ul) minSchedCycle = std::max(minSchedCycle, std::max(memCycle, minRespCycle - tCL - tBL));
+    return minSchedCycle;
 }
 
 void DDRMemory::queue(Request* req, uint64_t memCycle) {
-    // If it's a write, respond to it immediately
-    if (req->write) {
+    // If it's a write, respond to it immediately (unless it comes from the write-combining buffer, which already did)
+    if (req->write && req->ev) {
         auto ev = req->ev;
         req->ev = nullptr;
 
@@ -354,16 +570,24 @@ void DDRMemory::queue(Request* req, uint64_t memCycle) {
     }
 
     req->arrivalCycle = memCycle;  // if this comes from the overflow queue, update
+    req->arrivalSeq = nextArrivalSeq++;
 
     // Test: Skip writes
 #if 0
     if (req->write) {
         assert(wrQueue.size() == 1);
-        wrQueue.remove(wrQueue.begin());
+        wrQueue.free(req);
         return;
     }
 #endif
 
+    sched->arrived(*req, memCycle);
+    if (!req->write) {
+        srcQueuedReads[req->srcId]++;
+        srcBankQueuedReads[req->srcId*ranksPerChannel*banksPerRank + req->bankId]++;
+        req->interfSnapshot = srcInterfCycles[req->srcId];
+    }
+
     // Alloc in per-bank queue, in FR order
     Bank& bank = banks[req->loc.rank][req->loc.bank];
     InList<Request>& q = (deferredWrites && req->write)? bank.wrReqs : bank.rdReqs;
@@ -384,7 +608,7 @@ void DDRMemory::queue(Request* req, uint64_t memCycle) {
     Request* m = q.back();
     while (m) {
         if (m->loc.row == req->loc.row) {
-            if (m->rowHitSeq < rowHitLimit) {
+            if (m->rowHitSeq < rowHitLimit || req->buffered /*keep buffered row batches together*/) {
                 // queue after last same-row access
                 req->rowHitSeq = m->rowHitSeq + 1;
                 q.insertAfter(m, req);
@@ -412,14 +636,25 @@ void DDRMemory::queue(Request* req, uint64_t memCycle) {
              req->rowHitSeq = bank.curRowHits + 1;
             q.push_front(req);
         } else {
-            // ... and row is closed or has too many hits, maintain FCFS
+            // ... and row is closed or has too many hits, maintain FCFS among requests of equal priority
             req->rowHitSeq = 0;
-            q.push_back(req);
+            uint64_t prio = sched->priority(*req, memCycle);
+            Request* pos = q.back();  // we go after pos, which ends a row hit group
+            while (pos) {
+                Request* groupStart = pos;
+                while (groupStart->rowHitSeq != 0 && groupStart->prev) groupStart = groupStart->prev;
+                if (!groupStart->prev /*head's group*/ || sched->priority(*groupStart, memCycle) <= prio) break;
+                pos = groupStart->prev;
+            }
+            if (pos && pos != q.back()) q.insertAfter(pos, req);
+            else q.push_back(req);
         }
     }
 #if 0
     printQ("POST");
 #endif
+
+    if (!req->prev) bank.headStale[&q == &bank.wrReqs] = true;  // new head
 }
 
 // For external ticks
@@ -441,7 +676,7 @@ uint64_t DDRMemory::tick(uint64_t sysCycle) {
         // This request may be schedulable before trySchedule's minSchedCycle
         if (!req->prev /*first in bank queue*/) {
             uint64_t minQueuedSchedCycle = std::max(memCycle, minRespCycle - tCL - tBL);
-            if (minSchedCycle > minQueuedSchedCycle) minSchedCycle = std::max(minQueuedSchedCycle, findMinCmdCycle(*req));
+            if (minSchedCycle > minQueuedSchedCycle) minSchedCycle = std::max(minQueuedSchedCycle, getHeadMinCmdCycle(banks[req->loc.rank][req->loc.bank], useWrQueue));
             if (minSchedCycle > minQueuedSchedCycle) {
                 DEBUG("Overflowed request lowered minSchedCycle %ld -> %ld (memCycle %ld)", minSchedCycle, minQueuedSchedCycle, memCycle);
                 minSchedCycle = minQueuedSchedCycle;
@@ -449,6 +684,11 @@ uint64_t DDRMemory::tick(uint64_t sysCycle) {
         }
     }
 
+    // Controller is idle, drain the write-combining buffer
+    if (rdQueue.empty() && wrQueue.empty() && !wcbLines.empty()) {
+        minSchedCycle = std::min(minSchedCycle, drainWriteBuffer(memCycle, 0));
+    }
+
     nextSchedCycle = minSchedCycle;
     if (nextSchedCycle == -1ul) {
         nextSchedEvent = nullptr;
@@ -470,6 +710,7 @@ void DDRMemory::recycleEvent(SchedEvent* ev) {
 uint64_t DDRMemory::findMinCmdCycle(const Request& r) const {
     const Bank& bank = banks[r.loc.rank][r.loc.bank];
     uint64_t minCmdCycle = std::max(r.arrivalCycle, bank.lastCmdCycle + 1);
+    if (bankGroups > 1) minCmdCycle = std::max(minCmdCycle, groupTimings[groupIdx(r.loc)].lastCmdCycle + tCCD_L);
     if (r.loc.row == bank.openRow && bank.open) {
         // Row buffer hit
     } else {
@@ -483,11 +724,37 @@ uint64_t DDRMemory::findMinCmdCycle(const Request& r) const {
         }
         uint64_t actCycle = std::max(r.arrivalCycle, std::max(preCycle + tRP, bank.lastActCycle + tRRD));
         actCycle = std::max(actCycle, rankActWindows[r.loc.rank].minActCycle() + tFAW);
-        minCmdCycle = actCycle + tRCD;
+        if (bankGroups > 1) {
+            actCycle = std::max(actCycle, std::max(rankLastActCycles[r.loc.rank] + tRRD, groupTimings[groupIdx(r.loc)].lastActCycle + tRRD_L));
+        }
+        minCmdCycle = std::max(minCmdCycle, actCycle + tRCD);
     }
     return minCmdCycle;
 }
 
+void DDRMemory::chargeInterference(const Request& r, uint32_t serviceCycles) {
+    uint32_t numBanks = ranksPerChannel*banksPerRank;
+    for (uint32_t s = 0; s < numSources; s++) {
+        if (s == r.srcId || !srcQueuedReads[s]) continue;
+        srcInterfCycles[s] += srcBankQueuedReads[s*numBanks + r.bankId]? serviceCycles : tBL;
+    }
+}
+
+uint64_t DDRMemory::getHeadMinCmdCycle(Bank& bank, bool isWriteQueue) {
+    if (bank.headStale[isWriteQueue]) {
+        const Request* head = (isWriteQueue? bank.wrReqs : bank.rdReqs).front();
+        assert(head);
+        bank.headMinCmdCycle[isWriteQueue] = findMinCmdCycle(*head);
+        bank.headStale[isWriteQueue] = false;
+        profSchedEvals.inc();
+    }
+    return bank.headMinCmdCycle[isWriteQueue];
+}
+
+void DDRMemory::invalidateHeads(Bank& bank) {
+    bank.headStale[0] = bank.headStale[1] = true;
+}
+
 uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     /* Implement FR-FCFS scheduling to maximize bus utilization
      *
@@ -512,25 +779,28 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
 
     RequestQueue<Request>& queue = isWriteQueue? wrQueue : rdQueue;
     assert(!queue.empty());
+    profSchedCalls.inc();
+    sched->update(curCycle);
 
+    // Only the head of each bank queue can issue; pick the ready one with the
+    // lowest priority, then the earliest-arrived. Head timing constraints are
+    // cached per bank, so this is O(banks) regardless of queue depth.
     Request* r = nullptr;
-    RequestQueue<Request>::iterator ir = queue.begin();
+    uint64_t rPrio = -1ul;
     uint64_t minSchedCycle = -1ul;
-    while (ir != queue.end()) {
-        //Bank& bank = banks[(*ir)->loc.rank][(*ir)->loc.bank];
-        //if ((isWriteQueue? bank.wrReqs : bank.rdReqs).front() == *ir) {
-        if (!(*ir)->prev) {  // FASTAH!
-            uint64_t minCmdCycle = findMinCmdCycle(**ir);
+    for (auto& rankBanks : banks) {
+        for (auto& b : rankBanks) {
+            Request* head = (isWriteQueue? b.wrReqs : b.rdReqs).front();
+            if (!head) continue;
+            uint64_t minCmdCycle = getHeadMinCmdCycle(b, isWriteQueue);
             minSchedCycle = std::min(minSchedCycle, minCmdCycle);
-            if (minCmdCycle <= curCycle) {
-                r = *ir;
-                break;
+            if (minCmdCycle > curCycle) continue;
+            uint64_t prio = sched->priority(*head, curCycle);
+            if (!r || prio < rPrio || (prio == rPrio && head->arrivalSeq < r->arrivalSeq)) {
+                r = head;
+                rPrio = prio;
             }
-            //DEBUG("Skipping 0x%lx, not ready %ld", (*ir)->ev->getAddr(), minCmdCycle);
-        } else {
-            //DEBUG("Skipping 0x%lx, not first", (*ir)->ev->getAddr());
         }
-        ir.inc();
     }
 
     if (!r) {
@@ -550,7 +820,9 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     // without column access or data bus constraints
     uint64_t minCmdCycle = std::max(curCycle, minRespCycle - tCL);
     if (lastCmdWasWrite && !r->write) minCmdCycle = std::max(minCmdCycle, minRespCycle + tWTR);
+    if (bankGroups > 1) minCmdCycle = std::max(minCmdCycle, groupTimings[groupIdx(r->loc)].lastCmdCycle + tCCD_L);
     bool rowHit = false;
+    uint32_t serviceCycles = tBL;  // how long this request holds the bank
     if (r->loc.row == bank.openRow && bank.open) {
         // Row buffer hit
         rowHit = true;
@@ -567,15 +839,30 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
 
         uint64_t actCycle = std::max(r->arrivalCycle, std::max(preCycle + tRP, bank.lastActCycle + tRRD));
         actCycle = std::max(actCycle, rankActWindows[r->loc.rank].minActCycle() + tFAW);
+        if (bankGroups > 1) {
+            GroupTiming& gt = groupTimings[groupIdx(r->loc)];
+            actCycle = std::max(actCycle, std::max(rankLastActCycles[r->loc.rank] + tRRD, gt.lastActCycle + tRRD_L));
+            gt.lastActCycle = std::max(gt.lastActCycle, actCycle);
+            rankLastActCycles[r->loc.rank] = std::max(rankLastActCycles[r->loc.rank], actCycle);
+        }
 
         // Record ACT
+        RankPower& rp = rankPower[r->loc.rank];
+        advancePower(r->loc.rank, actCycle);
+        if (preIssued) profRankPres.inc(r->loc.rank);
+        else rp.openBanks++;
+        profRankActs.inc(r->loc.rank);
+        rp.lastBusyCycle = std::max(rp.lastBusyCycle, actCycle);
+
         bank.open = true;
         bank.openRow = r->loc.row;
         if (preIssued) bank.minPreCycle = preCycle + tRAS;
         rankActWindows[r->loc.rank].addActivation(actCycle);
         bank.lastActCycle = actCycle;
+        for (auto& b : banks[r->loc.rank]) invalidateHeads(b);  // ACT window changed
 
         minCmdCycle = std::max(minCmdCycle, actCycle + tRCD);
+        serviceCycles += tRCD + (preIssued? tRP : 0);
     }
 
     // Figure out data bus constraints, find actual time at which command is issued
@@ -583,10 +870,20 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     minRespCycle = cmdCycle + tCL + tBL;
     lastCmdWasWrite = r->write;
 
+    RankPower& rp = rankPower[r->loc.rank];
+    advancePower(r->loc.rank, cmdCycle);
+    (r->write? profRankWrs : profRankRds).inc(r->loc.rank);
+    rp.lastBusyCycle = std::max(rp.lastBusyCycle, minRespCycle);
+
     // Record PRE
     // if closed-page, close (auto-precharge) if no more row buffer hits
     // if open-page, minPreCycle is used for row buffer misses
-    if (closedPage && !(r->next && r->next->rowHitSeq != 0)) bank.open = false;
+    if (closedPage && !(r->next && r->next->rowHitSeq != 0)) {
+        bank.open = false;
+        assert(rp.openBanks);
+        rp.openBanks--;
+        profRankPres.inc(r->loc.rank);
+    }
     bank.minPreCycle = std::max(
             bank.minPreCycle,  // for mixed read and write commands, minPreCycle may not be monotonic without this
             std::max(bank.lastActCycle + tRAS,  // RAS constraint
@@ -596,6 +893,11 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     // Record RD or WR
     assert(bank.lastCmdCycle < cmdCycle);
     bank.lastCmdCycle = cmdCycle;
+    if (bankGroups > 1) {
+        GroupTiming& gt = groupTimings[groupIdx(r->loc)];
+        gt.lastCmdCycle = std::max(gt.lastCmdCycle, cmdCycle);
+        for (uint32_t b = r->loc.bank % bankGroups; b < banksPerRank; b += bankGroups) invalidateHeads(banks[r->loc.rank][b]);  // tCCD_L
+    }
     bank.curRowHits = r->rowHitSeq;
 
     // Issue response
@@ -615,6 +917,10 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
         if (rowHit) profReadHits.inc();
         uint32_t bucket = std::min(NUMBINS-1, scDelay/BINSIZE);
         latencyHist.inc(bucket, 1);
+
+        uint64_t interfSysCycles = (srcInterfCycles[r->srcId] - r->interfSnapshot)*sysFreqKHz/memFreqKHz;
+        profCoreRdLat.inc(r->srcId, scDelay);
+        profCoreRdInterf.inc(r->srcId, std::min((uint64_t)scDelay, interfSysCycles));
     } else {
         uint32_t scDelay = memToSysCycle(minRespCycle) + controllerSysLatency - r->startSysCycle;
         profWrites.inc();
@@ -624,9 +930,19 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
 
     DEBUG("Served 0x%lx lat %ld clocks", r->addr, minRespCycle-curCycle);
 
+    profCoreReqs.inc(r->srcId);
+    chargeInterference(*r, serviceCycles);
+    sched->served(*r, cmdCycle, serviceCycles);
+    if (!r->write) {
+        srcQueuedReads[r->srcId]--;
+        srcBankQueuedReads[r->srcId*ranksPerChannel*banksPerRank + r->bankId]--;
+    }
+
     // Dequeue this req
-    queue.remove(ir);
+    assert(r == (isWriteQueue? bank.wrReqs : bank.rdReqs).front());
     (isWriteQueue? bank.wrReqs : bank.rdReqs).pop_front();
+    queue.free(r);
+    invalidateHeads(bank);
 
     return (rdQueue.empty() && wrQueue.empty())? -1ul : minRespCycle - tCL;
 }
@@ -643,12 +959,22 @@ void DDRMemory::refresh(uint64_t sysCycle) {
 
     uint64_t refreshDoneCycle = minRefreshCycle + tRFC;
     assert(tRFC >= tRP);
+    for (uint32_t rank = 0; rank < ranksPerChannel; rank++) {
+        // All ranks refresh together; open banks are precharged first
+        RankPower& rp = rankPower[rank];
+        advancePower(rank, minRefreshCycle);
+        profRankPres.inc(rank, rp.openBanks);
+        profRankRefs.inc(rank);
+        rp.openBanks = 0;
+        rp.lastBusyCycle = std::max(rp.lastBusyCycle, refreshDoneCycle);
+    }
     for (auto& rankBanks : banks) {
         for (auto& bank : rankBanks) {
             // Close and force the ACT to happen at least at tRFC
             // PRE <-tRP-> ACT, so discount tRP
             bank.minPreCycle = refreshDoneCycle - tRP;
             bank.open = false;
+            invalidateHeads(bank);
         }
     }
 
@@ -656,17 +982,157 @@ void DDRMemory::refresh(uint64_t sysCycle) {
 }
 
 
+/* Power and energy model
+ *
+ * Follows the IDD-based equations of Micron TN-41-01 (as DRAMSim2 does):
+ * ACT/PRE pairs, bursts and refreshes each cost their current above the
+ * standby one, and background energy is the per-state standby or
+ * power-down current over the cycles the rank spent in each state. Ranks
+ * power down after powerDownCycles idle cycles. Power-down exit (tXP) is not
+ * charged to requests; it is a few cycles and is usually hidden by tRCD.
+ */
+
+void DDRMemory::advancePower(uint32_t rank, uint64_t memCycle) {
+    RankPower& rp = rankPower[rank];
+    if (memCycle <= rp.accountedCycle) return;  // ACTs can be recorded slightly out of order
+    uint64_t pdnCycle = powerDownCycles? std::max(rp.accountedCycle, rp.lastBusyCycle + powerDownCycles) : memCycle;
+    pdnCycle = std::min(pdnCycle, memCycle);
+    if (rp.openBanks) {
+        profRankActStby.inc(rank, pdnCycle - rp.accountedCycle);
+        profRankActPdn.inc(rank, memCycle - pdnCycle);
+    } else {
+        profRankPreStby.inc(rank, pdnCycle - rp.accountedCycle);
+        profRankPrePdn.inc(rank, memCycle - pdnCycle);
+    }
+    rp.accountedCycle = memCycle;
+}
+
+double DDRMemory::getRankEnergy(uint32_t rank, EnergyComponent c) {
+    double cycleEnergy = vdd*tCK*(busWidth/devWidth);  // pJ per mA-cycle, for all devices in the rank
+    switch (c) {
+        case ACT_PRE_ENERGY:
+            return profRankActs.count(rank)*(iDD0*(tRAS + tRP) - (iDD3N*tRAS + iDD2N*tRP))*cycleEnergy;
+        case RD_WR_ENERGY:
+            return (profRankRds.count(rank)*(iDD4R - iDD3N) + profRankWrs.count(rank)*(iDD4W - iDD3N))*tBL*cycleEnergy;
+        case REF_ENERGY:
+            if (busModel) return sysToMemCycle(zinfo->globPhaseCycles)/tREFI*(iDD5 - iDD3N)*tRFC*cycleEnergy;
+            return profRankRefs.count(rank)*(iDD5 - iDD3N)*tRFC*cycleEnergy;
+        case BG_ENERGY:
+            // Without a weave phase, we do not track residency; assume ranks are always in standby
+            if (busModel) return sysToMemCycle(zinfo->globPhaseCycles)*(closedPage? iDD2N : iDD3N)*cycleEnergy;
+            return (profRankActStby.count(rank)*iDD3N + profRankPreStby.count(rank)*iDD2N +
+                    profRankActPdn.count(rank)*iDD3P + profRankPrePdn.count(rank)*iDD2P)*cycleEnergy;
+        default:
+            panic("Invalid energy component %d", c);
+    }
+}
+
+
 /* Tech/Device timing parameters */
 
 void DDRMemory::initTech(const char* techName) {
     std::string tech(techName);
-    double tCK;
 
     // tBL's below are for 64-byte lines; we adjust as needed
+    // IDDs are per device. Sizes and organization must match getTechGeometry()
+
+    // Defaults for technologies without bank groups
+    busWidth = 64;
+    bankGroups = 1;
+    tRRD_L = 0;
+    tCCD_L = 0;
 
     // Please keep this orderly; go from faster to slower technologies
-    if (tech == "DDR3-1333-CL10") {
-        // from DRAMSim2/ini/DDR3_micron_16M_8B_x4_sg15.ini (Micron)
+    if (tech == "DDR5-4800-CL40") {
+        // JEDEC DDR5-4800B, 16Gb x8. Each controller is one 32-bit subchannel (a DIMM has two),
+        // so a 64-byte line is a BL16 burst. IDDs are typical datasheet values, check your part's
+        tCK = 0.4167;
+        tBL = 8;
+        tCL = 40;
+        tRCD = 39;
+        tRTP = 18;
+        tRP = 39;
+        tRRD = 8;
+        tRRD_L = 12;
+        tRAS = 77;
+        tFAW = 32;
+        tWTR = 24;  // tWTR_L
+        tWR = 72;
+        tCCD_L = 12;
+        tRFC = 708;  // tRFC1
+        tREFI = 9360;
+        busWidth = 32;
+        bankGroups = 8;
+        vdd = 1.1;
+        iDD0 = 60;
+        iDD2P = 38;
+        iDD2N = 45;
+        iDD3P = 45;
+        iDD3N = 55;
+        iDD4R = 170;
+        iDD4W = 160;
+        iDD5 = 250;
+        devWidth = 8;
+    } else if (tech == "DDR4-2400-CL17") {
+        // JEDEC DDR4-2400R, 8Gb x8. IDDs are typical datasheet values
+        tCK = 0.833;
+        tBL = 4;
+        tCL = 17;
+        tRCD = 17;
+        tRTP = 9;
+        tRP = 17;
+        tRRD = 4;
+        tRRD_L = 6;
+        tRAS = 39;
+        tFAW = 26;
+        tWTR = 9;  // tWTR_L
+        tWR = 18;
+        tCCD_L = 6;
+        tRFC = 420;
+        tREFI = 9363;
+        bankGroups = 4;
+        vdd = 1.2;
+        iDD0 = 58;
+        iDD2P = 25;
+        iDD2N = 37;
+        iDD3P = 37;
+        iDD3N = 52;
+        iDD4R = 140;
+        iDD4W = 156;
+        iDD5 = 190;
+        devWidth = 8;
+    } else if (tech == "HBM2-2000") {
+        // HBM2 at 2Gbps/pin, 8Gb dies, in pseudo-channel mode: each controller is one 64-bit
+        // pseudo-channel (a stack has 8 channels, 16 pseudo-channels). Pseudo-channels share the
+        // command bus, which we do not model. IDDs are per pseudo-channel, and approximate
+        tCK = 1.0;
+        tBL = 4;
+        tCL = 14;
+        tRCD = 14;
+        tRTP = 4;
+        tRP = 14;
+        tRRD = 4;
+        tRRD_L = 6;
+        tRAS = 34;
+        tFAW = 16;
+        tWTR = 8;  // tWTR_L
+        tWR = 16;
+        tCCD_L = 4;
+        tRFC = 260;
+        tREFI = 3900;
+        bankGroups = 4;
+        vdd = 1.2;
+        iDD0 = 65;
+        iDD2P = 20;
+        iDD2N = 30;
+        iDD3P = 25;
+        iDD3N = 40;
+        iDD4R = 170;
+        iDD4W = 165;
+        iDD5 = 190;
+        devWidth = 64;
+    } else if (tech == "DDR3-1333-CL10") {
+        // from DRAMSim2/ini/DDR3_micron_16M_8B_x4_sg15.ini (Micron); IDDs for 1Gb x4 parts
         tCK = 1.5;  // ns; all other in mem cycles
         tBL = 4;
         tCL = 10;
@@ -680,6 +1146,16 @@ void DDRMemory::initTech(const char* techName) {
         tWR = 10;
         tRFC = 74;
         tREFI = 5200;
+        vdd = 1.5;
+        iDD0 = 110;
+        iDD2P = 12;
+        iDD2N = 65;
+        iDD3P = 40;
+        iDD3N = 62;
+        iDD4R = 200;
+        iDD4W = 220;
+        iDD5 = 240;
+        devWidth = 4;
     } else if (tech == "DDR3-1066-CL7") {
         // from DDR3_micron_16M_8B_x4_sg187.ini
         // see http://download.micron.com/pdf/datasheets/dram/ddr3/1Gb_DDR3_SDRAM.pdf, cl7 variant, copied from it; tRRD is widely different, others match
@@ -696,6 +1172,16 @@ void DDRMemory::initTech(const char* techName) {
         tWR = 7;
         tRFC = 59;
         tREFI = 4160;
+        vdd = 1.5;
+        iDD0 = 100;
+        iDD2P = 12;
+        iDD2N = 55;
+        iDD3P = 35;
+        iDD3N = 55;
+        iDD4R = 165;
+        iDD4W = 175;
+        iDD5 = 235;
+        devWidth = 4;
     } else if (tech == "DDR3-1066-CL8") {
         // from DDR3_micron_16M_8B_x4_sg187.ini
         tCK = 1.875;
@@ -711,6 +1197,16 @@ void DDRMemory::initTech(const char* techName) {
         tWR = 8;
         tRFC = 59;
         tREFI = 4160;
+        vdd = 1.5;
+        iDD0 = 100;
+        iDD2P = 12;
+        iDD2N = 55;
+        iDD3P = 35;
+        iDD3N = 55;
+        iDD4R = 165;
+        iDD4W = 175;
+        iDD5 = 235;
+        devWidth = 4;
     } else {
         panic("Unknown technology %s, you'll need to define it", techName);
     }
@@ -718,6 +1214,9 @@ void DDRMemory::initTech(const char* techName) {
     // Check all params were set
     assert(tCK > 0.0);
     assert(tBL && tCL && tRCD && tRTP && tRP && tRRD && tRAS && tFAW && tWTR && tWR && tRFC && tREFI);
+    assert(vdd > 0.0 && iDD0 > 0.0 && iDD2P > 0.0 && iDD2N > 0.0 && iDD3P > 0.0 && iDD3N > 0.0 && iDD4R > 0.0 && iDD4W > 0.0 && iDD5 > 0.0);
+    assert(devWidth && busWidth % devWidth == 0);
+    assert(bankGroups == 1 || (tRRD_L && tCCD_L));
 
     if (isPow2(lineSize) && lineSize >= 64) {
         tBL = lineSize*tBL/64;
@@ -729,6 +1228,47 @@ void DDRMemory::initTech(const char* techName) {
         panic("Unsupported line size %d", lineSize);
     }
 
+    // The scheduler needs memory clocks to be strictly under half the system
+    // clock (see matchingMemToSysCycle). For faster DRAMs, run the controller
+    // at 1/gear of the DRAM clock, as gear 2 and gear 4 controllers do, and
+    // round all timing parameters up to memory clocks. At the default 2 GHz
+    // system clock, DDR3 runs in gear 1, DDR4-2400 (1.2 GHz) and HBM2-2000
+    // (1 GHz, exactly half) in gear 2, and DDR5-4800 (2.4 GHz) in gear 4.
+    uint64_t dramFreqKHz = (uint64_t)(1e9/tCK/1e3);
+    gear = 1;
+    while (dramFreqKHz/gear >= sysFreqKHz/2) gear *= 2;
+    if (gear > 1) {
+        for (uint32_t* t : {&tBL, &tCL, &tRCD, &tRTP, &tRP, &tRRD, &tRRD_L, &tCCD_L, &tRAS, &tFAW, &tWTR, &tWR, &tRFC, &tREFI}) {
+            *t = (*t + gear - 1)/gear;
+        }
+        tCK *= gear;
+    }
+
     memFreqKHz = (uint64_t)(1e9/tCK/1e3);
 }
 
+void DDRMemory::getTechGeometry(const char* techName, uint32_t* ranksPerChannel, uint32_t* banksPerRank, uint32_t* pageSize) {
+    std::string tech(techName);
+    if (tech.compare(0, 4, "DDR5") == 0) {
+        // 32-bit subchannel of x8 devices: 1KB pages, 8 groups of 4 banks
+        *ranksPerChannel = 2;
+        *banksPerRank = 32;
+        *pageSize = 4*1024;
+    } else if (tech.compare(0, 4, "DDR4") == 0) {
+        // x8 devices: 1KB pages, 4 groups of 4 banks
+        *ranksPerChannel = 2;
+        *banksPerRank = 16;
+        *pageSize = 8*1024;
+    } else if (tech.compare(0, 4, "HBM2") == 0) {
+        // Pseudo-channel: 1KB pages, 4 groups of 4 banks, no ranks
+        *ranksPerChannel = 1;
+        *banksPerRank = 16;
+        *pageSize = 1024;
+    } else {
+        // DDR3: 8 banks, 1Kb cols, x4 devices
+        *ranksPerChannel = 4;
+        *banksPerRank = 8;
+        *pageSize = 8*1024;
+    }
+}
+
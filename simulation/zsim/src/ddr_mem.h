@@ -28,7 +28,11 @@
 
 #include <deque>
 
+#include "addr_mapper.h"
+#include "ddr_sched.h"
 #include "g_std/g_string.h"
+#include "g_std/g_unordered_map.h"
+#include "g_std/g_unordered_set.h"
 #include "intrusive_list.h"
 #include "memory_hierarchy.h"
 #include "pad.h"
@@ -78,58 +82,47 @@ class ActWindow {
         inline uint32_t dec(uint32_t i) const { return i? i-1 : buf.size()-1; }
 };
 
-// Read or write queues, ordered/inserted by arrival time, out-of-order finish
+// Read or write queues: a fixed pool of request entries. Requests are kept in
+// per-bank lists and ordered by arrival sequence numbers, so entries are
+// allocated and freed in any order
 template <typename T>
 class RequestQueue {
     private:
-        struct Node : InListNode<Node> {
-            T elem;
-        };
-        InList<Node> reqList;  // FIFO
-        InList<Node> freeList; // LIFO (higher locality)
+        g_vector<T*> freeList; // LIFO (higher locality)
+        size_t capacity;
 
     public:
+        RequestQueue() : capacity(0) {}
+
         void init(size_t size) {
-            assert(reqList.empty() && freeList.empty());
-            Node* buf = gm_calloc<Node>(size);
+            assert(capacity == 0);
+            T* buf = gm_calloc<T>(size);
             for (uint32_t i = 0; i < size; i++) {
-                new (&buf[i]) Node();
+                new (&buf[i]) T();
                 freeList.push_back(&buf[i]);
             }
+            capacity = size;
         }
 
-        inline bool empty() const { return reqList.empty(); }
+        inline bool empty() const { return freeList.size() == capacity; }
         inline bool full() const { return freeList.empty(); }
-        inline size_t size() const { return reqList.size(); }
+        inline size_t size() const { return capacity - freeList.size(); }
 
         inline T* alloc() {
             assert(!full());
-            Node* n = freeList.back();
+            T* elem = freeList.back();
             freeList.pop_back();
-            reqList.push_back(n);
-            return &n->elem;
+            return elem;
         }
 
-        struct iterator {
-            Node* n;
-            explicit inline iterator(Node* _n) : n(_n) {}
-            inline void inc() {n = n->next;}  // overloading prefix/postfix too messy
-            inline T* operator*() const { return &(n->elem); }
-            inline bool operator==(const iterator& it) const { return it.n == n; }
-            inline bool operator!=(const iterator& it) const { return it.n != n; }
-        };
-
-        inline iterator begin() const {return iterator(reqList.front());}
-        inline iterator end() const {return iterator(nullptr);}
-
-        inline void remove(iterator i) {
-            assert(i.n);
-            reqList.remove(i.n);
-            freeList.push_back(i.n);
+        inline void free(T* elem) {
+            assert(freeList.size() < capacity);
+            freeList.push_back(elem);
         }
 };
 
 class DDRMemoryAccEvent;
+class MD1Model;
 class SchedEvent;
 
 // Single-channel controller. For multiple channels, use multiple controllers.
@@ -143,16 +136,16 @@ class DDRMemory : public MemObject {
             uint32_t col;
         };
 
-        struct Request : InListNode<Request> {
+        struct Request : InListNode<Request>, DDRSchedReq {
             Address addr;
             AddrLoc loc;
-            bool write;
 
             uint64_t rowHitSeq; // sequence number used to throttle max # row hits
+            bool buffered;  // drained from the write-combining buffer
 
-            // Cycle accounting
-            uint64_t arrivalCycle;  // in memCycles
+            // Cycle accounting (arrivalCycle is in DDRSchedReq)
             uint64_t startSysCycle;  // in sysCycles
+            uint64_t interfSnapshot;  // srcInterfCycles[srcId] on arrival
 
             // Corresponding event to send a response to
             // Writes get a response immediately, so this is nullptr for them
@@ -172,6 +165,27 @@ class DDRMemory : public MemObject {
 
             InList<Request> rdReqs;
             InList<Request> wrReqs;
+
+            // Scheduler cache: findMinCmdCycle() of the rdReqs/wrReqs heads (indexed by isWriteQueue).
+            // Marked stale when the head changes or when the bank's or rank's timing state changes.
+            uint64_t headMinCmdCycle[2];
+            bool headStale[2];
+        };
+
+        // Per-rank power state. Background power depends on whether any bank
+        // is open (active vs precharge standby), and on whether the rank has
+        // been idle long enough to power down. Residency is recorded lazily,
+        // whenever the rank receives a command or a refresh.
+        struct RankPower {
+            uint32_t openBanks;
+            uint64_t accountedCycle;  // residency recorded up to this cycle
+            uint64_t lastBusyCycle;   // end of the last ACT, data burst or refresh
+        };
+
+        // Write-combining buffer entry: buffered writes to one row of one bank
+        struct WCBRow {
+            g_vector<Request> reqs;  // in arrival order
+            uint64_t firstSeq;  // age of the row's oldest buffered write, to break ties
         };
 
         // Global timing constraints
@@ -185,15 +199,18 @@ class DDRMemory : public MemObject {
         uint64_t minRespCycle;
         bool lastCmdWasWrite;
 
-        static const uint32_t JEDEC_BUS_WIDTH = 64;
         const uint32_t lineSize, ranksPerChannel, banksPerRank;
         const uint32_t controllerSysLatency;  // in sysCycles
         const uint32_t queueDepth;
         const uint32_t rowHitLimit; // row hits not prioritized in FR-FCFS beyond this point
         const bool deferredWrites;
         const bool closedPage;
+        const uint32_t powerDownCycles;  // idle cycles before a rank enters power-down; 0 disables power-down
+        const uint32_t writeBufferSize;  // write-combining buffer entries (lines); 0 disables the buffer
         const uint32_t domain;
 
+        DDRSchedPolicy* const sched;
+
         // DRAM timing parameters -- initialized in initTech()
         // All parameters are in memory clocks (multiples of tCK)
         uint32_t tBL;    // burst length (== tTrans)
@@ -201,7 +218,9 @@ class DDRMemory : public MemObject {
         uint32_t tRCD;   // ACT to CAS
         uint32_t tRTP;   // RD to PRE
         uint32_t tRP;    // PRE to ACT
-        uint32_t tRRD;   // ACT to ACT
+        uint32_t tRRD;   // ACT to ACT (tRRD_S with bank groups)
+        uint32_t tRRD_L; // ACT to ACT, same bank group
+        uint32_t tCCD_L; // CAS to CAS, same bank group (tCCD_S is tBL, enforced by the data bus)
         uint32_t tRAS;   // ACT to PRE
         uint32_t tFAW;   // No more than 4 ACTs per rank in this window
         uint32_t tWTR;   // end of WR burst to RD command
@@ -209,11 +228,28 @@ class DDRMemory : public MemObject {
         uint32_t tRFC;   // Refresh to ACT (refresh leaves rows closed)
         uint32_t tREFI;  // Refresh interval
 
-        // Address mapping information
-        uint32_t colShift, colMask;
-        uint32_t rankShift, rankMask;
-        uint32_t bankShift, bankMask;
-        uint64_t rowShift;  // row's always top
+        // DRAM organization -- also initialized in initTech()
+        uint32_t busWidth;    // data bus width in bits: 64 for DDR3/4 DIMMs and HBM2 pseudo-channels, 32 for DDR5 subchannels
+        uint32_t bankGroups;  // 1 if the technology has no bank groups; bank b is in group b % bankGroups
+        uint32_t gear;        // DRAM clocks per memory (controller) clock, see initTech()
+
+        // DRAM power parameters -- also initialized in initTech()
+        // Currents are per device, in mA; mA * V * ns gives energies in pJ
+        double tCK;      // ns, of a memory clock
+        double vdd;      // V
+        double iDD0;     // ACT-PRE
+        double iDD2P;    // precharge power-down
+        double iDD2N;    // precharge standby
+        double iDD3P;    // active power-down
+        double iDD3N;    // active standby
+        double iDD4R;    // read burst
+        double iDD4W;    // write burst
+        double iDD5;     // refresh
+        uint32_t devWidth;  // device data width; each rank has busWidth/devWidth devices
+
+        // Address mapping: fields are col, rank and bank; row's always top
+        enum {COL_FIELD, RANK_FIELD, BANK_FIELD};
+        AddrMapper* addrMapper;
 
         uint32_t minRdLatency;
         uint32_t minWrLatency;
@@ -221,15 +257,50 @@ class DDRMemory : public MemObject {
 
         RequestQueue<Request> rdQueue, wrQueue;
         std::deque<Request> overflowQueue;
+        uint64_t nextArrivalSeq;
+
+        /* Write-combining buffer (needs deferred writes). Writebacks are held
+         * here instead of going straight to the write queue: writes to a line
+         * that is already buffered are merged, and the rest are grouped by row.
+         * When the buffer fills up, the fullest rows are moved to the write
+         * queue until it is half-empty; when the controller goes idle, all of
+         * them are. Each row moves as a batch, so writes drain as long runs of
+         * row hits and the controller turns the bus around (tWTR) less often.
+         */
+        g_unordered_map<uint64_t, WCBRow> wcbRows;  // indexed by row*ranksPerChannel*banksPerRank + bankId
+        g_unordered_set<Address> wcbLines;
+        uint64_t nextWcbSeq;
+
+        // Per-core interference accounting, used to estimate slowdowns: every time a request issues,
+        // cores with queued reads are charged the data bus time, or the bank time if they wait on that bank
+        uint32_t numSources;
+        g_vector<uint32_t> srcQueuedReads;
+        g_vector<uint32_t> srcBankQueuedReads;  // indexed by srcId*ranksPerChannel*banksPerRank + bankId
+        g_vector<uint64_t> srcInterfCycles;  // in memCycles
 
         g_vector< g_vector<Bank> > banks; // indexed by rank, bank
         g_vector<ActWindow> rankActWindows;
 
+        // Bank group constraints (only with bankGroups > 1)
+        struct GroupTiming {
+            uint64_t lastActCycle;
+            uint64_t lastCmdCycle;  // RD/WR command
+        };
+        g_vector<GroupTiming> groupTimings;  // indexed by rank*bankGroups + group
+        g_vector<uint64_t> rankLastActCycles;
+        g_vector<RankPower> rankPower;
+
         // Event scheduling
         SchedEvent* nextSchedEvent;
         uint64_t nextSchedCycle;
         SchedEvent* eventFreelist;
 
+        // Only with sim.analyticalContention: bound-phase estimate of data bus queueing and row buffer hits
+        MD1Model* busModel;
+        g_vector<uint64_t> boundOpenRows; // indexed by rank*banksPerRank + bank
+        uint32_t burstSysCycles;
+        uint32_t rowMissSysCycles;
+
         const g_string name;
 
         // R/W stats
@@ -237,6 +308,12 @@ class DDRMemory : public MemObject {
         Counter profReads, profWrites;
         Counter profTotalRdLat, profTotalWrLat;
         Counter profReadHits, profWriteHits;  // row buffer hits
+        Counter profSchedCalls, profSchedEvals;  // scheduler cost
+        VectorCounter profBankAccs;  // per-bank load, indexed by rank*banksPerRank + bank
+        Counter profWcbWrites, profWcbMerges, profWcbBatches, profWcbBatchWrites;
+        VectorCounter profCoreReqs, profCoreRdLat, profCoreRdInterf;
+        VectorCounter profRankActs, profRankPres, profRankRds, profRankWrs, profRankRefs;  // DRAM commands, per rank
+        VectorCounter profRankActStby, profRankPreStby, profRankActPdn, profRankPrePdn;  // power state residency, per rank
         VectorCounter latencyHist;
         static const uint32_t BINSIZE = 10, NUMBINS = 100;
         PAD();
@@ -259,13 +336,16 @@ class DDRMemory : public MemObject {
 
     public:
         DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerChannel, uint32_t _banksPerRank,
-            uint32_t _sysFreqMHz, const char* tech, const char* addrMapping, uint32_t _controllerSysLatency,
-            uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage,
-            uint32_t _domain, g_string& _name);
+            uint32_t _sysFreqMHz, const char* tech, const char* addrMapping, bool bankHash, uint32_t _controllerSysLatency,
+            uint32_t _queueDepth, uint32_t _rowHitLimit, bool _deferredWrites, bool _closedPage, uint32_t _powerDownCycles,
+            uint32_t _writeBufferSize, DDRSchedPolicy* _sched, uint32_t _domain, g_string& _name);
 
         void initStats(AggregateStat* parentStat);
         const char* getName() {return name.c_str();}
 
+        // Default organization of a technology (all its speed grades), used as config defaults
+        static void getTechGeometry(const char* tech, uint32_t* ranksPerChannel, uint32_t* banksPerRank, uint32_t* pageSize);
+
         // Bound phase interface
         uint64_t access(MemReq& req);
 
@@ -280,10 +360,25 @@ class DDRMemory : public MemObject {
     private:
         AddrLoc mapLineAddr(Address lineAddr);
 
+        uint64_t analyticalAccess(Address lineAddr, bool isWrite);
+
         void queue(Request* req, uint64_t memCycle);
+        void scheduleTick(uint64_t minSchedCycle, uint64_t sysCycle);
+
+        void bufferWrite(DDRMemoryAccEvent* ev, uint64_t memCycle, uint64_t sysCycle);
+        uint64_t drainWriteBuffer(uint64_t memCycle, uint32_t targetSize);
+        inline void chargeInterference(const Request& r, uint32_t serviceCycles);
 
         inline uint64_t trySchedule(uint64_t curCycle, uint64_t sysCycle);
         uint64_t findMinCmdCycle(const Request& r) const;
+        inline uint32_t groupIdx(const AddrLoc& loc) const {return loc.rank*bankGroups + loc.bank % bankGroups;}
+        inline uint64_t getHeadMinCmdCycle(Bank& bank, bool isWriteQueue);
+        inline void invalidateHeads(Bank& bank);
+
+        // Energy model
+        enum EnergyComponent {ACT_PRE_ENERGY, RD_WR_ENERGY, REF_ENERGY, BG_ENERGY, NUM_ENERGY_COMPONENTS};
+        void advancePower(uint32_t rank, uint64_t memCycle);
+        double getRankEnergy(uint32_t rank, EnergyComponent c);  // in pJ
 
         void initTech(const char* tech);
 };
@@ -0,0 +1,283 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DDR_SCHED_H_
+#define DDR_SCHED_H_
+
+#include <algorithm>
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "log.h"
+#include "stats.h"
+
+/* Scheduling policies for DDRMemory.
+ *
+ * DDRMemory keeps per-bank queues in FR order (requests to the same row are
+ * grouped, up to maxRowHits), and only the head of each bank queue can issue.
+ * Policies rank requests, and lower priorities are served first:
+ *  - Across banks, the scheduler issues the ready head with the lowest
+ *    current priority, breaking ties FCFS.
+ *  - Within a bank, a request that does not join a row hit group is queued
+ *    ahead of requests with higher priorities (as computed at its arrival),
+ *    but never ahead of the head, which may have issued PRE/ACT already.
+ * FR-FCFS ranks all requests equally. The thread-aware policies rank them by
+ * their source core, and each controller ranks cores independently (there
+ * is no meta-controller).
+ */
+
+// Request state visible to scheduling policies
+struct DDRSchedReq {
+    uint64_t arrivalCycle;  // in memCycles
+    uint64_t arrivalSeq; // order of arrival to the read or write queue; FCFS picks the lowest
+    uint32_t srcId;  // requesting core
+    uint32_t bankId; // rank*banksPerRank + bank
+    bool write;  // reads and writes have separate queues, and writes drain in bursts
+    bool marked;  // in the current batch (PAR-BS only)
+};
+
+class DDRSchedPolicy : public GlobAlloc {
+    protected:
+        const uint32_t numSources;
+
+    public:
+        explicit DDRSchedPolicy(uint32_t _numSources) : numSources(_numSources) {}
+        virtual ~DDRSchedPolicy() {}
+
+        virtual void initStats(AggregateStat* parentStat) {}
+
+        // Called once per scheduling decision, before ranking the candidates
+        virtual void update(uint64_t memCycle) {}
+
+        // A request entered the read or write queue (not the overflow queue)
+        virtual void arrived(DDRSchedReq& r, uint64_t memCycle) {}
+
+        // A request issued; serviceCycles is how long it held its bank
+        virtual void served(DDRSchedReq& r, uint64_t memCycle, uint32_t serviceCycles) {}
+
+        virtual uint64_t priority(const DDRSchedReq& r, uint64_t memCycle) const = 0;
+};
+
+// Plain FR-FCFS; the row hit cap (FR-FCFS-Cap) is maxRowHits, enforced by the bank queues
+class FRFCFSSchedPolicy : public DDRSchedPolicy {
+    public:
+        explicit FRFCFSSchedPolicy(uint32_t _numSources) : DDRSchedPolicy(_numSources) {}
+        uint64_t priority(const DDRSchedReq& r, uint64_t memCycle) const { return 0; }
+};
+
+/* BLISS (Subramanian et al., ICCD'14): a core that gets threshold requests
+ * served back to back is blacklisted (deprioritized) until the blacklist is
+ * cleared, every clearInterval cycles.
+ */
+class BLISSSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint32_t threshold;
+        const uint64_t clearInterval;  // in memCycles
+
+        g_vector<bool> blacklisted;
+        uint32_t lastSrc;
+        uint32_t streak;
+        uint64_t nextClearCycle;
+
+        Counter profBlacklists, profClears;
+
+    public:
+        BLISSSchedPolicy(uint32_t _numSources, uint32_t _threshold, uint64_t _clearInterval)
+            : DDRSchedPolicy(_numSources), threshold(_threshold), clearInterval(_clearInterval),
+              blacklisted(_numSources, false), lastSrc(-1u), streak(0), nextClearCycle(_clearInterval) {}
+
+        void initStats(AggregateStat* parentStat) {
+            AggregateStat* schedStats = new AggregateStat();
+            schedStats->init("sched", "BLISS scheduler stats");
+            profBlacklists.init("blacklists", "Cores blacklisted"); schedStats->append(&profBlacklists);
+            profClears.init("clears", "Blacklist clears"); schedStats->append(&profClears);
+            parentStat->append(schedStats);
+        }
+
+        void update(uint64_t memCycle) {
+            if (memCycle >= nextClearCycle) {
+                std::fill(blacklisted.begin(), blacklisted.end(), false);
+                nextClearCycle = memCycle + clearInterval;
+                profClears.inc();
+            }
+        }
+
+        void served(DDRSchedReq& r, uint64_t memCycle, uint32_t serviceCycles) {
+            if (r.srcId == lastSrc) {
+                if (++streak >= threshold && !blacklisted[r.srcId]) {
+                    blacklisted[r.srcId] = true;
+                    profBlacklists.inc();
+                }
+            } else {
+                lastSrc = r.srcId;
+                streak = 1;
+            }
+        }
+
+        uint64_t priority(const DDRSchedReq& r, uint64_t memCycle) const {
+            return blacklisted[r.srcId]? 1 : 0;
+        }
+};
+
+/* ATLAS (Kim et al., HPCA'10): least attained service first. Bank service
+ * time is accumulated per core, and at the end of every quantum cores are
+ * ranked by their exponentially averaged attained service. Requests that
+ * have waited more than starvationCycles go first.
+ */
+class ATLASSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint64_t quantum;  // in memCycles
+        const double alpha;  // weight of history in the attained service average
+        const uint64_t starvationCycles;
+
+        g_vector<uint64_t> quantumService;
+        g_vector<double> totalService;
+        g_vector<uint32_t> rank;  // 0 is the core with the least attained service
+        uint64_t nextQuantumCycle;
+
+        Counter profQuanta, profStarved;
+
+    public:
+        ATLASSchedPolicy(uint32_t _numSources, uint64_t _quantum, double _alpha, uint64_t _starvationCycles)
+            : DDRSchedPolicy(_numSources), quantum(_quantum), alpha(_alpha), starvationCycles(_starvationCycles),
+              quantumService(_numSources, 0), totalService(_numSources, 0.0), rank(_numSources, 0), nextQuantumCycle(_quantum) {}
+
+        void initStats(AggregateStat* parentStat) {
+            AggregateStat* schedStats = new AggregateStat();
+            schedStats->init("sched", "ATLAS scheduler stats");
+            profQuanta.init("quanta", "Ranking quanta"); schedStats->append(&profQuanta);
+            profStarved.init("starved", "Requests served over the starvation threshold"); schedStats->append(&profStarved);
+            parentStat->append(schedStats);
+        }
+
+        void update(uint64_t memCycle) {
+            if (memCycle < nextQuantumCycle) return;
+            g_vector<uint32_t> order(numSources);
+            for (uint32_t s = 0; s < numSources; s++) {
+                totalService[s] = alpha*totalService[s] + (1.0 - alpha)*quantumService[s];
+                quantumService[s] = 0;
+                order[s] = s;
+            }
+            std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return totalService[a] < totalService[b]; });
+            for (uint32_t i = 0; i < numSources; i++) rank[order[i]] = i;
+            nextQuantumCycle = memCycle + quantum;
+            profQuanta.inc();
+        }
+
+        void served(DDRSchedReq& r, uint64_t memCycle, uint32_t serviceCycles) {
+            quantumService[r.srcId] += serviceCycles;
+            if (memCycle > r.arrivalCycle + starvationCycles) profStarved.inc();
+        }
+
+        uint64_t priority(const DDRSchedReq& r, uint64_t memCycle) const {
+            return (memCycle > r.arrivalCycle + starvationCycles)? 0 : 1 + rank[r.srcId];
+        }
+};
+
+/* PAR-BS (Mutlu and Moscibroda, ISCA'08): when no marked requests remain,
+ * the oldest markingCap requests of each core to each bank are marked as a
+ * batch. Marked requests go first, and within the batch, cores with the
+ * fewest marked requests in their most loaded bank (then the fewest overall)
+ * go first. Only reads are batched: writes drain in bursts (see deferWrites),
+ * so marked writes could keep a batch open for a long time.
+ */
+class PARBSSchedPolicy : public DDRSchedPolicy {
+    private:
+        const uint32_t numBanks;
+        const uint32_t markingCap;
+
+        g_vector< g_vector<DDRSchedReq*> > pending;  // indexed by srcId*numBanks + bankId, in arrival order
+        uint64_t markedReqs;
+        g_vector<uint32_t> rank;
+
+        // Scratch space to form batches, indexed by srcId
+        g_vector<uint32_t> maxLoad, totalLoad, order;
+
+        Counter profBatches, profMarked;
+
+    public:
+        PARBSSchedPolicy(uint32_t _numSources, uint32_t _numBanks, uint32_t _markingCap)
+            : DDRSchedPolicy(_numSources), numBanks(_numBanks), markingCap(_markingCap),
+              pending(_numSources*_numBanks), markedReqs(0), rank(_numSources, 0),
+              maxLoad(_numSources), totalLoad(_numSources), order(_numSources) {}
+
+        void initStats(AggregateStat* parentStat) {
+            AggregateStat* schedStats = new AggregateStat();
+            schedStats->init("sched", "PAR-BS scheduler stats");
+            profBatches.init("batches", "Batches formed"); schedStats->append(&profBatches);
+            profMarked.init("marked", "Requests marked"); schedStats->append(&profMarked);
+            parentStat->append(schedStats);
+        }
+
+        void update(uint64_t memCycle) {
+            if (markedReqs) return;
+
+            // Form a new batch
+            std::fill(maxLoad.begin(), maxLoad.end(), 0);
+            std::fill(totalLoad.begin(), totalLoad.end(), 0);
+            for (uint32_t s = 0; s < numSources; s++) {
+                for (uint32_t b = 0; b < numBanks; b++) {
+                    g_vector<DDRSchedReq*>& reqs = pending[s*numBanks + b];
+                    uint32_t n = std::min((uint32_t)reqs.size(), markingCap);
+                    for (uint32_t i = 0; i < n; i++) reqs[i]->marked = true;
+                    maxLoad[s] = std::max(maxLoad[s], n);
+                    totalLoad[s] += n;
+                }
+                markedReqs += totalLoad[s];
+                order[s] = s;
+            }
+            if (!markedReqs) return;
+
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return (maxLoad[a] == maxLoad[b])? totalLoad[a] < totalLoad[b] : maxLoad[a] < maxLoad[b];
+            });
+            for (uint32_t i = 0; i < numSources; i++) rank[order[i]] = i;
+            profBatches.inc();
+            profMarked.inc(markedReqs);
+        }
+
+        void arrived(DDRSchedReq& r, uint64_t memCycle) {
+            r.marked = false;
+            if (r.write) return;
+            pending[r.srcId*numBanks + r.bankId].push_back(&r);
+        }
+
+        void served(DDRSchedReq& r, uint64_t memCycle, uint32_t serviceCycles) {
+            if (r.write) return;
+            g_vector<DDRSchedReq*>& reqs = pending[r.srcId*numBanks + r.bankId];
+            auto it = std::find(reqs.begin(), reqs.end(), &r);
+            assert_msg(it != reqs.end(), "Served request not pending");
+            reqs.erase(it);
+            if (r.marked) {
+                assert(markedReqs);
+                markedReqs--;
+            }
+        }
+
+        uint64_t priority(const DDRSchedReq& r, uint64_t memCycle) const {
+            return r.marked? rank[r.srcId] : numSources;
+        }
+};
+
+#endif  // DDR_SCHED_H_
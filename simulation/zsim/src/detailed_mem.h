@@ -338,7 +338,7 @@ class MemAccessEventBase : public TimingEvent {
 
     public:
         MemAccessEventBase(MemControllerBase* _dram, MemAccessType _type, Address _addr, int32_t domain, uint32_t preDelay, uint32_t postDelay)
-            : TimingEvent(preDelay, postDelay, domain), dram(_dram), type(_type), addr(_addr) {}
+            : TimingEvent(preDelay, postDelay, domain), dram(_dram), type(_type), addr(_addr) {setType(EVT_MEM_ACCESS);}
 
         void simulate(uint64_t startCycle) { dram->enqueue(this, startCycle); }
         MemAccessType getType() const { return type; }
@@ -0,0 +1,166 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "domain_map.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "contention_sim.h"
+#include "log.h"
+#include "zsim.h"
+
+#define BALANCE_SLACK 0.1 //a domain may exceed the average load by this fraction to keep communicating components together
+
+DomainMapper::DomainMapper(uint32_t configDomains, uint32_t _memDomains, const char* mapFile, uint64_t _profilePhases, uint32_t numComponents, const char* _outFile)
+    : memDomains(0), profiling(false), profilePhases(_profilePhases), targetDomains(configDomains), outFile(_outFile)
+{
+    if (mapFile && mapFile[0]) {
+        if (profilePhases) panic("sim.domainMap and sim.profileDomainPhases are mutually exclusive");
+        if (_memDomains) warn("Domain map %s sets memory controller domains, ignoring sys.mem.separateDomains", mapFile);
+        loadMap(mapFile);
+    } else if (profilePhases) {
+        profiling = true;
+        numDomains = numComponents;
+        info("Profiling weave-phase load over %ld phases, with one domain per component (%d domains)", profilePhases, numDomains);
+    } else {
+        memDomains = _memDomains;
+        numDomains = configDomains + memDomains;
+        if (memDomains) info("Memory controllers use %d separate domains (%d domains total)", memDomains, numDomains);
+    }
+}
+
+uint32_t DomainMapper::getDomain(const char* name, uint32_t defDomain) {
+    if (profiling) {
+        uint32_t domain = components.size();
+        if (domain >= numDomains) panic("Domain profiling: more components than expected (%d), %s has no domain", numDomains, name);
+        components.push_back(name);
+        return domain;
+    } else if (mapNames.size()) {
+        for (uint32_t i = 0; i < mapNames.size(); i++) {
+            if (mapNames[i] == name) return mapDomains[i];
+        }
+        warn("Domain map has no entry for %s, using domain %d", name, defDomain);
+        return defDomain;
+    } else {
+        return defDomain;
+    }
+}
+
+void DomainMapper::loadMap(const char* mapFile) {
+    std::ifstream in(mapFile);
+    if (!in.good()) panic("Could not open domain map %s", mapFile);
+    numDomains = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        std::string name;
+        uint32_t domain;
+        if (!(ss >> name >> domain)) panic("Malformed line in domain map %s: %s", mapFile, line.c_str());
+        if (name == "domains") {
+            numDomains = domain;
+        } else {
+            if (!numDomains) panic("Domain map %s must start with the number of domains", mapFile);
+            if (domain >= numDomains) panic("Domain map %s: %s is mapped to domain %d, but there are %d domains", mapFile, name.c_str(), domain, numDomains);
+            mapNames.push_back(g_string(name.c_str()));
+            mapDomains.push_back(domain);
+        }
+    }
+    if (!numDomains) panic("Domain map %s is empty", mapFile);
+    if (targetDomains != numDomains) info("Domain map %s uses %d domains, overriding sim.domains (%d)", mapFile, numDomains, targetDomains);
+    info("Loaded domain map %s: %ld components over %d domains", mapFile, mapNames.size(), numDomains);
+}
+
+void DomainMapper::endOfPhase() {
+    if (unlikely(profiling && zinfo->numPhases + 1 == profilePhases)) writeMap();
+}
+
+void DomainMapper::writeMap() {
+    ContentionSim* csim = zinfo->contentionSim;
+    uint32_t n = components.size();
+
+    //Load is weave time; if the phases had no timing components, fall back to event counts so the map is still balanced
+    std::vector<double> load(n);
+    double totalLoad = 0.0;
+    for (uint32_t c = 0; c < n; c++) totalLoad += (load[c] = csim->getDomainTime(c));
+    if (totalLoad == 0.0) {
+        for (uint32_t c = 0; c < n; c++) totalLoad += (load[c] = csim->getDomainEvents(c));
+    }
+
+    auto traffic = [&](uint32_t c1, uint32_t c2) -> uint64_t {
+        return csim->getCrossings(c1, c2) + csim->getCrossings(c2, c1);
+    };
+
+    //Greedy packing, heaviest components first: among the domains that still fit the component
+    //(within slack of the average load), pick the one it exchanges most crossings with
+    std::vector<uint32_t> order(n);
+    for (uint32_t c = 0; c < n; c++) order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t c1, uint32_t c2) {return load[c1] > load[c2];});
+
+    double maxLoad = (1.0 + BALANCE_SLACK)*totalLoad/targetDomains;
+    std::vector<double> domLoad(targetDomains, 0.0);
+    std::vector<uint32_t> mapping(n, -1u);
+    for (uint32_t c : order) {
+        uint32_t best = -1u;
+        uint64_t bestTraffic = 0;
+        for (uint32_t d = 0; d < targetDomains; d++) {
+            if (domLoad[d] > 0.0 && domLoad[d] + load[c] > maxLoad) continue;
+            uint64_t t = 0;
+            for (uint32_t o = 0; o < n; o++) if (mapping[o] == d) t += traffic(c, o);
+            if (best == -1u || t > bestTraffic || (t == bestTraffic && domLoad[d] < domLoad[best])) {
+                best = d;
+                bestTraffic = t;
+            }
+        }
+        if (best == -1u) best = std::min_element(domLoad.begin(), domLoad.end()) - domLoad.begin();
+        mapping[c] = best;
+        domLoad[best] += load[c];
+    }
+
+    uint64_t totalCrossings = 0;
+    uint64_t cutCrossings = 0;
+    for (uint32_t c1 = 0; c1 < n; c1++) {
+        for (uint32_t c2 = 0; c2 < n; c2++) {
+            uint64_t x = csim->getCrossings(c1, c2);
+            totalCrossings += x;
+            if (mapping[c1] != mapping[c2]) cutCrossings += x;
+        }
+    }
+
+    FILE* f = fopen(outFile.c_str(), "w");
+    if (!f) panic("Could not open domain map %s for writing", outFile.c_str());
+    fprintf(f, "# zsim domain map: %d components over %d domains, profiled over %ld phases\n", n, targetDomains, profilePhases);
+    fprintf(f, "domains %d\n", targetDomains);
+    for (uint32_t c = 0; c < n; c++) fprintf(f, "%s %d\n", components[c].c_str(), mapping[c]);
+    fclose(f);
+
+    double avgLoad = totalLoad/targetDomains;
+    double maxDomLoad = *std::max_element(domLoad.begin(), domLoad.end());
+    info("Wrote domain map %s: %d components over %d domains, load imbalance (max/avg) %.2f, %ld/%ld crossings between domains",
+            outFile.c_str(), n, targetDomains, avgLoad? maxDomLoad/avgLoad : 1.0, cutCrossings, totalCrossings);
+    info("Use sim.domainMap = \"%s\" to simulate with this mapping", outFile.c_str());
+}
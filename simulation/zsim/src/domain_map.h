@@ -0,0 +1,83 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DOMAIN_MAP_H_
+#define DOMAIN_MAP_H_
+
+#include <stdint.h>
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "galloc.h"
+
+/* Maps weave-phase components (cores, cache banks and memory controllers) to
+ * contention simulation domains. There are three modes:
+ *  - Static (default): components use the fixed interleaved assignment over
+ *    sim.domains domains. With sys.mem.separateDomains, each memory
+ *    controller gets an extra domain of its own.
+ *  - Profiling (sim.profileDomainPhases = N): every component gets its own
+ *    domain. After N phases, the mapper reads per-domain weave time, event and
+ *    crossing counts, packs components into sim.domains domains to balance
+ *    load while keeping components that exchange many crossings together, and
+ *    writes the mapping to sim.domainMapOutput. Since queued events cannot
+ *    migrate across domains, the profiling run keeps its own mapping.
+ *  - Mapped (sim.domainMap = file): components use the mapping in the file,
+ *    which also sets the number of domains.
+ */
+class DomainMapper : public GlobAlloc {
+    private:
+        uint32_t numDomains;
+        uint32_t memDomains; //static mode only, extra domains after the sim.domains ones
+
+        //Mapped mode
+        g_vector<g_string> mapNames;
+        g_vector<uint32_t> mapDomains;
+
+        //Profiling mode; component i is simulated in domain i
+        bool profiling;
+        uint64_t profilePhases;
+        uint32_t targetDomains;
+        g_string outFile;
+        g_vector<g_string> components;
+
+    public:
+        DomainMapper(uint32_t configDomains, uint32_t _memDomains, const char* mapFile, uint64_t _profilePhases, uint32_t numComponents, const char* _outFile);
+
+        uint32_t getNumDomains() const {return numDomains;}
+        uint32_t getNumMemDomains() const {return memDomains;}
+        uint32_t getNumBaseDomains() const {return numDomains - memDomains;} //shared by cores and caches in the static assignment
+        bool isProfiling() const {return profiling;}
+
+        //Called by init for every component, in construction order; defDomain is the static assignment
+        uint32_t getDomain(const char* name, uint32_t defDomain);
+
+        //Called at the end of every phase; writes the balanced mapping after profilePhases phases
+        void endOfPhase();
+
+    private:
+        void loadMap(const char* mapFile);
+        void writeMap();
+};
+
+#endif  // DOMAIN_MAP_H_
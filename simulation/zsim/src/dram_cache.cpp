@@ -0,0 +1,223 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dram_cache.h"
+#include "bithacks.h"
+#include "zsim.h"
+
+DRAMCacheMemory::DRAMCacheMemory(MemObject* _cacheMem, MemObject* _backingMem, uint32_t lineSize, uint64_t cacheBytes,
+        uint32_t blockBytes, uint32_t _ways, bool _sramTags, uint32_t _tagLatency, uint32_t footprintEntries,
+        g_string& _name)
+    : cacheMem(_cacheMem), backingMem(_backingMem), linesPerBlock(blockBytes/lineSize),
+      numSets(cacheBytes/blockBytes/_ways), ways(_ways), sramTags(_sramTags), tagLatency(_tagLatency), name(_name)
+{
+    if (blockBytes % lineSize || !linesPerBlock || linesPerBlock > 64 || !isPow2(linesPerBlock)) {
+        panic("%s: block size (%d bytes) must be 1-64 lines, and a power of two", name.c_str(), blockBytes);
+    }
+    if (!ways || !numSets || (uint64_t)numSets*ways*blockBytes != cacheBytes) {
+        panic("%s: %ld bytes can't be split in %d-way sets of %d-byte blocks", name.c_str(), cacheBytes, ways, blockBytes);
+    }
+    if (footprintEntries && linesPerBlock == 1) {
+        warn("%s: footprint prediction needs page-sized blocks, disabling it", name.c_str());
+        footprintEntries = 0;
+    }
+
+    Block invBlock = {(Address)-1L, 0, 0, 0, 0};
+    blocks.resize(numSets*ways, invBlock);
+    FootprintEntry invEntry = {(Address)-1L, 0};
+    footprints.resize(footprintEntries, invEntry);
+    useClock = 0;
+    futex_init(&lock);
+
+    info("%s: %ld MB, %d sets x %d ways of %d-line blocks, %s tags, %s", name.c_str(), cacheBytes >> 20, numSets, ways, linesPerBlock,
+            sramTags? "SRAM" : "DRAM", footprints.size()? "footprint fetches" : "whole-block fetches");
+}
+
+void DRAMCacheMemory::initStats(AggregateStat* parentStat) {
+    AggregateStat* dcStats = new AggregateStat();
+    dcStats->init(name.c_str(), "DRAM cache stats");
+    profHits.init("hits", "Read hits"); dcStats->append(&profHits);
+    profMisses.init("misses", "Read misses (block not present)"); dcStats->append(&profMisses);
+    profLineMisses.init("lineMisses", "Read misses to a present block, outside its fetched footprint"); dcStats->append(&profLineMisses);
+    profWrHits.init("wrHits", "Writeback hits"); dcStats->append(&profWrHits);
+    profWrMisses.init("wrMisses", "Writeback misses (bypass the cache)"); dcStats->append(&profWrMisses);
+    profEvictions.init("evictions", "Evicted blocks"); dcStats->append(&profEvictions);
+    profDirtyWbs.init("dirtyWbs", "Dirty lines written back to main memory"); dcStats->append(&profDirtyWbs);
+    profTierRds.init("tierRds", "Lines read from the cache tier (incl. tag reads)"); dcStats->append(&profTierRds);
+    profTierWrs.init("tierWrs", "Lines written to the cache tier"); dcStats->append(&profTierWrs);
+    profMainRds.init("mainRds", "Lines read from main memory"); dcStats->append(&profMainRds);
+    profMainWrs.init("mainWrs", "Lines written to main memory"); dcStats->append(&profMainWrs);
+    profTotalRdLat.init("rdlat", "Total latency experienced by read requests"); dcStats->append(&profTotalRdLat);
+
+    auto hitRate = [this]() {
+        uint64_t reads = profHits.get() + profMisses.get() + profLineMisses.get();
+        return reads? 1000*profHits.get()/reads : 0;
+    };
+    auto hitRateStat = makeLambdaStat(hitRate);
+    hitRateStat->init("hitRate", "Read hit rate (x1000)");
+    dcStats->append(hitRateStat);
+    auto bloat = [this]() {
+        uint64_t reqs = profHits.get() + profMisses.get() + profLineMisses.get() + profWrHits.get() + profWrMisses.get();
+        uint64_t lines = profTierRds.get() + profTierWrs.get() + profMainRds.get() + profMainWrs.get();
+        return reqs? 1000*lines/reqs : 0;
+    };
+    auto bloatStat = makeLambdaStat(bloat);
+    bloatStat->init("bloat", "Bandwidth bloat: lines moved in both tiers per line requested (x1000)");
+    dcStats->append(bloatStat);
+    parentStat->append(dcStats);
+
+    cacheMem->initStats(parentStat);
+    backingMem->initStats(parentStat);
+}
+
+AccessChain::Point DRAMCacheMemory::subAccess(MemObject* mem, Address lineAddr, AccessType type, AccessChain::Point p,
+        const MemReq& req, AccessChain& chain) {
+    if (mem == cacheMem) (type == PUTX? profTierWrs : profTierRds).inc();
+    else (type == PUTX? profMainWrs : profMainRds).inc();
+
+    MESIState state = I;
+    MemReq subReq = {lineAddr, req.pcAddr, type, req.childId, &state, p.cycle, nullptr, I, req.srcId, 0 /*no flags*/};
+    uint64_t respCycle = mem->access(subReq);
+    return chain.append(p, p.cycle, respCycle);
+}
+
+// Writes back the dirty lines of a block that starts being replaced at p, and
+// remembers its footprint. With DRAM tags in a direct-mapped cache, the tag
+// read already brought in the line at accLine.
+void DRAMCacheMemory::evict(uint32_t set, uint32_t way, uint32_t accLine, AccessChain::Point p, const MemReq& req, AccessChain& chain) {
+    Block& b = blocks[set*ways + way];
+    for (uint32_t l = 0; l < linesPerBlock; l++) {
+        if (!(b.dirtyMask & (1ul << l))) continue;
+        AccessChain::Point rdDone = (!sramTags && ways == 1 && l == accLine)? p :
+            subAccess(cacheMem, tierLineAddr(set, way, l), GETS, p, req, chain);
+        subAccess(backingMem, b.blockAddr*linesPerBlock + l, PUTX, rdDone, req, chain);
+        profDirtyWbs.inc();
+    }
+    if (footprints.size()) {
+        FootprintEntry& fe = footprints[b.blockAddr % footprints.size()];
+        fe.blockAddr = b.blockAddr;
+        fe.usedMask = b.usedMask;
+    }
+    profEvictions.inc();
+}
+
+uint64_t DRAMCacheMemory::access(MemReq& req) {
+    switch (req.type) {
+        case PUTS:
+        case PUTX:
+            *req.state = I;
+            break;
+        case GETS:
+            *req.state = req.is(MemReq::NOEXCL)? S : E;
+            break;
+        case GETX:
+            *req.state = M;
+            break;
+
+        default: panic("!?");
+    }
+    if (req.type == PUTS) return req.cycle;  // clean writeback, no data
+    bool isWrite = (req.type == PUTX);
+
+    // With analytical contention, tiers do not record events, and neither do we
+    AccessChain chain(zinfo->analyticalContention? nullptr : zinfo->eventRecorders[req.srcId]);
+
+    futex_lock(&lock);
+    Address blockAddr = req.lineAddr/linesPerBlock;
+    uint32_t line = req.lineAddr % linesPerBlock;
+    uint64_t lineBit = 1ul << line;
+    uint32_t set = blockAddr % numSets;
+    uint32_t way = ways;
+    for (uint32_t w = 0; w < ways; w++) {
+        if (blocks[set*ways + w].blockAddr == blockAddr) {
+            way = w;
+            break;
+        }
+    }
+
+    // Tag lookup
+    AccessChain::Point p = chain.begin(req.cycle);
+    if (sramTags) p = chain.delay(p, tagLatency);
+    else p = subAccess(cacheMem, tierLineAddr(set, 0, line), GETS, p, req, chain);
+
+    AccessChain::Point end = p;
+    if (way < ways && (blocks[set*ways + way].validMask & lineBit)) {
+        // Hit
+        Block& b = blocks[set*ways + way];
+        b.lastUse = ++useClock;
+        if (isWrite) {
+            end = subAccess(cacheMem, tierLineAddr(set, way, line), PUTX, p, req, chain);
+            b.dirtyMask |= lineBit;
+            profWrHits.inc();
+        } else {
+            // Direct-mapped DRAM tags read the data along with the tag
+            if (sramTags || ways > 1) end = subAccess(cacheMem, tierLineAddr(set, way, line), GETS, p, req, chain);
+            b.usedMask |= lineBit;
+            profHits.inc();
+        }
+    } else if (isWrite) {
+        end = subAccess(backingMem, req.lineAddr, PUTX, p, req, chain);
+        profWrMisses.inc();
+    } else {
+        // Fetch the line from main memory, and fill it once it arrives
+        uint64_t fetchMask = lineBit;
+        if (way == ways) {
+            // Block miss: replace the LRU block, then fetch the whole block or its predicted footprint
+            way = 0;
+            for (uint32_t w = 1; w < ways; w++) {
+                if (blocks[set*ways + w].lastUse < blocks[set*ways + way].lastUse) way = w;
+            }
+            if (blocks[set*ways + way].blockAddr != (Address)-1L) evict(set, way, line, p, req, chain);
+
+            if (footprints.empty()) {
+                fetchMask = (linesPerBlock == 64)? -1ul : (1ul << linesPerBlock) - 1;
+            } else {
+                const FootprintEntry& fe = footprints[blockAddr % footprints.size()];
+                if (fe.blockAddr == blockAddr) fetchMask |= fe.usedMask;
+            }
+            Block nb = {blockAddr, 0, 0, 0, 0};
+            blocks[set*ways + way] = nb;
+            profMisses.inc();
+        } else {
+            profLineMisses.inc();
+        }
+
+        Block& b = blocks[set*ways + way];
+        for (uint32_t l = 0; l < linesPerBlock; l++) {
+            if (!(fetchMask & (1ul << l))) continue;
+            AccessChain::Point fetched = subAccess(backingMem, blockAddr*linesPerBlock + l, GETS, p, req, chain);
+            subAccess(cacheMem, tierLineAddr(set, way, l), PUTX, fetched, req, chain);
+            if (l == line) end = fetched;
+        }
+        b.validMask |= fetchMask;
+        b.usedMask |= lineBit;
+        b.lastUse = ++useClock;
+    }
+    futex_unlock(&lock);
+
+    chain.finish(req, end);
+    if (!isWrite) profTotalRdLat.atomicInc(end.cycle - req.cycle);
+    return end.cycle;
+}
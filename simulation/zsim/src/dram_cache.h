@@ -0,0 +1,112 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DRAM_CACHE_H_
+#define DRAM_CACHE_H_
+
+#include "access_chain.h"
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "locks.h"
+#include "memory_hierarchy.h"
+#include "pad.h"
+#include "stats.h"
+
+/* Memory-side DRAM cache (e.g., an HBM stack) in front of main memory. Both
+ * tiers are regular memory controllers (typically DDRMemory), so their
+ * timing, contention and energy come from the existing models; this class
+ * only keeps the tags and turns each request into the tier accesses it needs,
+ * chaining their timing records into a single one.
+ *
+ * Organization:
+ *  - Blocks are a line (Alloy cache, MICRO'12) or a page (Footprint cache,
+ *    ISCA'13). Page-sized blocks may fetch only the lines predicted to be
+ *    used (the footprint the page had the last time it was resident) instead
+ *    of the whole page.
+ *  - Tags live in SRAM (fixed lookup latency) or in DRAM. With DRAM tags,
+ *    every access first reads the tag from the cache tier; in a direct-mapped
+ *    cache, that read also returns the data (Alloy's tag-and-data units).
+ *  - LRU replacement, write-back. Writebacks that miss bypass the cache.
+ *
+ * Stats report hits, misses, latency and bandwidth bloat, i.e., the lines
+ * moved in both tiers per line requested.
+ */
+class DRAMCacheMemory : public MemObject {
+    private:
+        struct Block {
+            Address blockAddr;  // -1 if invalid
+            uint64_t validMask;  // lines present in the cache tier
+            uint64_t dirtyMask;
+            uint64_t usedMask;  // lines requested while resident (footprint)
+            uint64_t lastUse;
+        };
+
+        struct FootprintEntry {
+            Address blockAddr;
+            uint64_t usedMask;
+        };
+
+        MemObject* const cacheMem;  // cache tier
+        MemObject* const backingMem;  // main memory
+        const uint32_t linesPerBlock;
+        const uint32_t numSets, ways;
+        const bool sramTags;
+        const uint32_t tagLatency;  // SRAM tags only
+        const g_string name;
+
+        g_vector<Block> blocks;  // indexed by set*ways + way
+        g_vector<FootprintEntry> footprints;  // direct-mapped footprint history; empty to fetch whole blocks
+        uint64_t useClock;
+        lock_t lock;
+
+        PAD();
+        Counter profHits, profMisses, profLineMisses;  // reads; line misses hit a block but miss its footprint
+        Counter profWrHits, profWrMisses;
+        Counter profEvictions, profDirtyWbs;
+        Counter profTierRds, profTierWrs, profMainRds, profMainWrs;  // lines moved in each tier
+        Counter profTotalRdLat;
+        PAD();
+
+    public:
+        DRAMCacheMemory(MemObject* _cacheMem, MemObject* _backingMem, uint32_t lineSize, uint64_t cacheBytes,
+                uint32_t blockBytes, uint32_t _ways, bool _sramTags, uint32_t _tagLatency, uint32_t footprintEntries,
+                g_string& _name);
+
+        void initStats(AggregateStat* parentStat);
+        const char* getName() {return name.c_str();}
+
+        uint64_t access(MemReq& req);
+
+    private:
+        // Cache tier address of a line in a given set and way
+        inline Address tierLineAddr(uint32_t set, uint32_t way, uint32_t line) const {
+            return ((Address)set*ways + way)*linesPerBlock + line;
+        }
+
+        AccessChain::Point subAccess(MemObject* mem, Address lineAddr, AccessType type, AccessChain::Point p, const MemReq& req, AccessChain& chain);
+        void evict(uint32_t set, uint32_t way, uint32_t accLine, AccessChain::Point p, const MemReq& req, AccessChain& chain);
+};
+
+#endif  // DRAM_CACHE_H_
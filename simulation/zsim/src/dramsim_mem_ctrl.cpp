@@ -45,7 +45,7 @@ class DRAMSimAccEvent : public TimingEvent {
     public:
         uint64_t sCycle;
 
-        DRAMSimAccEvent(DRAMSimMemory* _dram, bool _write, Address _addr, int32_t domain) :  TimingEvent(0, 0, domain), dram(_dram), write(_write), addr(_addr) {}
+        DRAMSimAccEvent(DRAMSimMemory* _dram, bool _write, Address _addr, int32_t domain) :  TimingEvent(0, 0, domain), dram(_dram), write(_write), addr(_addr) {setType(EVT_MEM_ACCESS);}
 
         bool isWrite() const {
             return write;
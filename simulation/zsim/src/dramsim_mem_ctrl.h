@@ -28,6 +28,7 @@
 
 #include <map>
 #include <string>
+#include "addr_mapper.h"
 #include "g_std/g_string.h"
 #include "memory_hierarchy.h"
 #include "pad.h"
@@ -82,17 +83,33 @@ class DRAMSimMemory : public MemObject { //one DRAMSim controller
 //DRAMSIM does not support non-pow2 channels, so:
 // - Encapsulate multiple DRAMSim controllers
 // - Fan out addresses interleaved across banks, and change the address to a "memory address"
+// Channels are interleaved every interleaveLines lines (1 for line interleaving, a page's worth for page
+// interleaving), and with hashChannels, the channel index is permuted with the upper address bits.
+// Works with any memory type.
 class SplitAddrMemory : public MemObject {
     private:
         const g_vector<MemObject*> mems;
         const g_string name;
+        AddrMapper* mapper;  // field 0 is the channel
+        VectorCounter profChanAccs;
+
     public:
-        SplitAddrMemory(const g_vector<MemObject*>& _mems, const char* _name) : mems(_mems), name(_name) {}
+        SplitAddrMemory(const g_vector<MemObject*>& _mems, const char* _name, uint32_t interleaveLines, bool hashChannels)
+            : mems(_mems), name(_name)
+        {
+            if (interleaveLines > 1) {
+                mapper = new AddrMapper("chan:offset", {{"chan", mems.size(), hashChannels}, {"offset", interleaveLines, false}});
+            } else {
+                mapper = new AddrMapper("chan", {{"chan", mems.size(), hashChannels}});
+            }
+            info("%s: %ld channels, mapping %s", name.c_str(), mems.size(), mapper->toString().c_str());
+        }
 
         uint64_t access(MemReq& req) {
             Address addr = req.lineAddr;
-            uint32_t mem = addr % mems.size();
-            Address ctrlAddr = addr/mems.size();
+            uint32_t mem = mapper->get(addr, 0);
+            Address ctrlAddr = mapper->remove(addr, 0);
+            profChanAccs.atomicInc(mem);
             req.lineAddr = ctrlAddr;
             uint64_t respCycle = mems[mem]->access(req);
             req.lineAddr = addr;
@@ -104,6 +121,10 @@ class SplitAddrMemory : public MemObject {
         }
 
         void initStats(AggregateStat* parentStat) {
+            AggregateStat* splitStats = new AggregateStat();
+            splitStats->init(name.c_str(), "Channel interleaving stats");
+            profChanAccs.init("chanAccs", "Requests per channel", mems.size()); splitStats->append(&profChanAccs);
+            parentStat->append(splitStats);
             for (auto mem : mems) mem->initStats(parentStat);
         }
 };
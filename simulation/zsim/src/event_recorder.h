@@ -78,6 +78,14 @@ class EventRecorder : public GlobAlloc {
             return slabAlloc.alloc(sz);
         }
 
+        void setSlabHugePages(bool enable) {
+            slabAlloc.setHugePages(enable);
+        }
+
+        void initStats(AggregateStat* parentStat) {
+            slabAlloc.initStats(parentStat);
+        }
+
         //Event recording interface
 
         void pushRecord(const TimingRecord& rec) {
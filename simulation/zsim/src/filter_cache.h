@@ -166,6 +166,12 @@ class FilterCache : public Cache {
             for (uint32_t i = 0; i < numSets; i++) filterArray[i].clear();
             futex_unlock(&filterLock);
         }
+
+        //The filter only replicates lines in the array, so it starts empty after a restore
+        void loadState(CheckpointReader& cr) {
+            Cache::loadState(cr);
+            contextSwitch();
+        }
 };
 
 #endif  // FILTER_CACHE_H_
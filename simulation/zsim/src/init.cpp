@@ -26,6 +26,7 @@
 
 #include "init.h"
 #include <list>
+#include <math.h>
 #include <sstream>
 #include <stdlib.h>
 #include <string>
@@ -33,6 +34,7 @@
 #include <vector>
 #include "cache.h"
 #include "cache_arrays.h"
+#include "checkpoint.h"
 #include "config.h"
 #include "constants.h"
 #include "contention_sim.h"
@@ -41,6 +43,8 @@
 #include "detailed_mem_params.h"
 #include "ddr_mem.h"
 #include "debug_zsim.h"
+#include "domain_map.h"
+#include "dram_cache.h"
 #include "dramsim_mem_ctrl.h"
 #include "event_queue.h"
 #include "filter_cache.h"
@@ -52,11 +56,13 @@
 #include "mem_ctrls.h"
 #include "mockingjay_repl.h"
 #include "network.h"
+#include "noc.h"
 #include "null_core.h"
 #include "ooo_core.h"
 #include "part_repl_policies.h"
 #include "rrip_repl.h"
 #include "rt-rrip.h"
+#include "phase_controller.h"
 #include "pin_cmd.h"
 #include "prefetcher.h"
 #include "proc_stats.h"
@@ -76,6 +82,7 @@
 #include "tracing_cache.h"
 #include "virt/port_virtualizer.h"
 #include "weave_md1_mem.h" //validation, could be taken out...
+#include "weave_profiler.h"
 #include "zsim.h"
 
 extern void EndOfPhaseActions(); //in zsim.cpp
@@ -160,6 +167,7 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
     } else if (replType == "LRUProfViol") {
         ProfViolReplPolicy< LRUReplPolicy<true> >* pvrp = new ProfViolReplPolicy< LRUReplPolicy<true> >(numLines);
         pvrp->init(numLines);
+        if (zinfo->phaseController) zinfo->phaseController->addViolationSource(pvrp);
         rp = pvrp;
     } else if (replType == "TreeLRU") {
         rp = new TreeLRUReplPolicy(numLines, candidates);
@@ -316,15 +324,27 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
 
 // NOTE: frequency is SYSTEM frequency; mem freq specified in tech
 DDRMemory* BuildDDRMemory(Config& config, uint32_t lineSize, uint32_t frequency, uint32_t domain, g_string name, const string& prefix) {
-    uint32_t ranksPerChannel = config.get<uint32_t>(prefix + "ranksPerChannel", 4);
-    uint32_t banksPerRank = config.get<uint32_t>(prefix + "banksPerRank", 8);  // DDR3 std is 8
-    uint32_t pageSize = config.get<uint32_t>(prefix + "pageSize", 8*1024);  // 1Kb cols, x4 devices
-    const char* tech = config.get<const char*>(prefix + "tech", "DDR3-1333-CL10");  // see cpp file for other techs
+    // DDR3-*, DDR4-2400-CL17, DDR5-4800-CL40 (per subchannel) or HBM2-2000 (per pseudo-channel); see cpp file
+    // Techs at or above half the system frequency run the controller in gear 2 or 4 (all but DDR3 at 2 GHz)
+    const char* tech = config.get<const char*>(prefix + "tech", "DDR3-1333-CL10");
+    // Organization defaults depend on the technology (DDR3: 4 ranks, 8 banks, 8KB pages)
+    uint32_t techRanks, techBanks, techPageSize;
+    DDRMemory::getTechGeometry(tech, &techRanks, &techBanks, &techPageSize);
+    uint32_t ranksPerChannel = config.get<uint32_t>(prefix + "ranksPerChannel", techRanks);
+    uint32_t banksPerRank = config.get<uint32_t>(prefix + "banksPerRank", techBanks);
+    uint32_t pageSize = config.get<uint32_t>(prefix + "pageSize", techPageSize);
     const char* addrMapping = config.get<const char*>(prefix + "addrMapping", "rank:col:bank");  // address splitter interleaves channels; row always on top
+    // XOR rank and bank indexes with the row, so power-of-two strides spread across banks
+    string bankHash = config.get<const char*>(prefix + "bankHash", "None");
+    if (bankHash != "None" && bankHash != "XOR") panic("Invalid bankHash %s (None or XOR)", bankHash.c_str());
 
     // If set, writes are deferred and bursted out to reduce WTR overheads
     bool deferWrites = config.get<bool>(prefix + "deferWrites", true);
     bool closedPage = config.get<bool>(prefix + "closedPage", true);
+    // Write-combining buffer entries (lines), merges and row-batches writebacks; needs deferWrites. 0 disables it
+    uint32_t writeBufferSize = config.get<uint32_t>(prefix + "writeBufferSize", 0);
+    // Idle memory cycles before a rank enters power-down (affects energy stats only); 0 never powers down
+    uint32_t powerDownCycles = config.get<uint32_t>(prefix + "powerDownCycles", 0);
 
     // Max row hits before we stop prioritizing further row hits to this bank.
     // Balances throughput and fairness; 0 -> FCFS / high (e.g., -1) -> pure FR-FCFS
@@ -334,8 +354,35 @@ DDRMemory* BuildDDRMemory(Config& config, uint32_t lineSize, uint32_t frequency,
     uint32_t queueDepth = config.get<uint32_t>(prefix + "queueDepth", 16);
     uint32_t controllerLatency = config.get<uint32_t>(prefix + "controllerLatency", 10);  // in system cycles
 
+    // Scheduling policy (see ddr_sched.h); intervals are in memory cycles
+    string scheduler = config.get<const char*>(prefix + "scheduler", "FRFCFS");
+    uint32_t numSources = std::max(1u, zinfo->numCores);
+    DDRSchedPolicy* sched = nullptr;
+    if (scheduler == "FRFCFS") {
+        sched = new FRFCFSSchedPolicy(numSources);
+    } else if (scheduler == "BLISS") {
+        uint32_t threshold = config.get<uint32_t>(prefix + "blissThreshold", 4);
+        uint32_t clearInterval = config.get<uint32_t>(prefix + "blissClearInterval", 10000);
+        if (!threshold || !clearInterval) panic("BLISS needs blissThreshold and blissClearInterval > 0");
+        sched = new BLISSSchedPolicy(numSources, threshold, clearInterval);
+    } else if (scheduler == "ATLAS") {
+        uint32_t quantum = config.get<uint32_t>(prefix + "atlasQuantum", 1000000);
+        double alpha = config.get<double>(prefix + "atlasAlpha", 0.875);
+        uint32_t starvationCycles = config.get<uint32_t>(prefix + "atlasStarvationCycles", 50000);
+        if (!quantum) panic("ATLAS needs atlasQuantum > 0");
+        if (alpha < 0.0 || alpha >= 1.0) panic("atlasAlpha must be in [0, 1), is %f", alpha);
+        sched = new ATLASSchedPolicy(numSources, quantum, alpha, starvationCycles);
+    } else if (scheduler == "PARBS") {
+        uint32_t markingCap = config.get<uint32_t>(prefix + "parbsMarkingCap", 5);
+        if (!markingCap) panic("PAR-BS needs parbsMarkingCap > 0");
+        sched = new PARBSSchedPolicy(numSources, ranksPerChannel*banksPerRank, markingCap);
+    } else {
+        panic("Invalid DDR scheduler %s (FRFCFS, BLISS, ATLAS or PARBS)", scheduler.c_str());
+    }
+
     auto mem = new DDRMemory(zinfo->lineSize, pageSize, ranksPerChannel, banksPerRank, frequency, tech,
-            addrMapping, controllerLatency, queueDepth, maxRowHits, deferWrites, closedPage, domain, name);
+            addrMapping, bankHash == "XOR", controllerLatency, queueDepth, maxRowHits, deferWrites, closedPage, powerDownCycles,
+            writeBufferSize, sched, domain, name);
     return mem;
 }
 
@@ -344,7 +391,7 @@ MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t fre
     string type = config.get<const char*>("sys.mem.type", "Simple");
 
     //Latency
-    uint32_t latency = (type == "DDR")? -1 : config.get<uint32_t>("sys.mem.latency", 100);
+    uint32_t latency = (type == "DDR" || type == "DRAMCache")? -1 : config.get<uint32_t>("sys.mem.latency", 100);
 
     MemObject* mem = nullptr;
     if (type == "Simple") {
@@ -367,6 +414,27 @@ MemObject* BuildMemoryController(Config& config, uint32_t lineSize, uint32_t fre
         mem = new WeaveSimpleMemory(latency, boundLatency, domain, name);
     } else if (type == "DDR") {
         mem = BuildDDRMemory(config, lineSize, frequency, domain, name, "sys.mem.");
+    } else if (type == "DRAMCache") {
+        // DRAM cache tier (sys.mem.dramCache.tier.*, e.g., HBM2-2000) in front of DDR main memory (sys.mem.*)
+        string dcPrefix = "sys.mem.dramCache.";
+        uint32_t sizeMB = config.get<uint32_t>(dcPrefix + "size", 256);  // per memory controller
+        uint32_t ways = config.get<uint32_t>(dcPrefix + "ways", 1);
+        string granularity = config.get<const char*>(dcPrefix + "granularity", "line");  // line (Alloy) or page (Footprint)
+        uint32_t blockSize = lineSize;
+        if (granularity == "page") blockSize = config.get<uint32_t>(dcPrefix + "blockSize", 2048);
+        else if (granularity != "line") panic("Invalid DRAM cache granularity %s (line or page)", granularity.c_str());
+        string tags = config.get<const char*>(dcPrefix + "tags", "DRAM");
+        if (tags != "DRAM" && tags != "SRAM") panic("Invalid DRAM cache tags %s (DRAM or SRAM)", tags.c_str());
+        uint32_t tagLatency = config.get<uint32_t>(dcPrefix + "tagLatency", 10);  // SRAM tags only, in system cycles
+        // Footprint history entries (page blocks only); 0 fetches whole pages
+        uint32_t footprintEntries = config.get<uint32_t>(dcPrefix + "footprintEntries", 0);
+
+        g_string tierName(name + "-tier");
+        g_string mainName(name + "-main");
+        MemObject* tierMem = BuildDDRMemory(config, lineSize, frequency, domain, tierName, dcPrefix + "tier.");
+        MemObject* mainMem = BuildDDRMemory(config, lineSize, frequency, domain, mainName, "sys.mem.");
+        mem = new DRAMCacheMemory(tierMem, mainMem, lineSize, ((uint64_t)sizeMB) << 20, blockSize, ways, tags == "SRAM",
+                tagLatency, footprintEntries, name);
     } else if (type == "DRAMSim") {
         uint64_t cpuFreqHz = 1000000 * frequency;
         uint32_t capacity = config.get<uint32_t>("sys.mem.capacityMB", 16384);
@@ -427,7 +495,7 @@ CacheGroup* BuildCacheGroup(Config& config, const string& name, bool isTerminal)
                 ss << "b" << j;
             }
             g_string bankName(ss.str().c_str());
-            uint32_t domain = (i*banks + j)*zinfo->numDomains/(caches*banks); //(banks > 1)? nextDomain() : (i*banks + j)*zinfo->numDomains/(caches*banks);
+            uint32_t domain = zinfo->domainMapper->getDomain(bankName.c_str(), (i*banks + j)*zinfo->domainMapper->getNumBaseDomains()/(caches*banks)); //(banks > 1)? nextDomain() : (i*banks + j)*zinfo->numDomains/(caches*banks);
             cg[i][j] = BuildCacheBank(config, prefix, bankName, bankSize, isTerminal, domain);
         }
     }
@@ -435,6 +503,20 @@ CacheGroup* BuildCacheGroup(Config& config, const string& name, bool isTerminal)
     return cgp;
 }
 
+//Components that get a weave domain (see DomainMapper): cores, cache banks, memory controllers and the NoC, if any
+static uint32_t CountDomainComponents(Config& config) {
+    uint32_t components = zinfo->numCores;
+    vector<const char*> cacheGroupNames;
+    config.subgroups("sys.caches", cacheGroupNames);
+    for (const char* grp : cacheGroupNames) {
+        string prefix = string("sys.caches.") + grp + ".";
+        if (config.get<bool>(prefix + "isPrefetcher", false)) continue;
+        components += config.get<uint32_t>(prefix + "caches", 1)*config.get<uint32_t>(prefix + "banks", 1);
+    }
+    if (string(config.get<const char*>("sys.noc.type", "None")) != "None") components++;
+    return components + config.get<uint32_t>("sys.mem.controllers", 1);
+}
+
 static void InitSystem(Config& config) {
     unordered_map<string, string> parentMap; //child -> parent
     unordered_map<string, vector<vector<string>>> childMap; //parent -> children (a parent may have multiple children)
@@ -513,6 +595,28 @@ static void InitSystem(Config& config) {
     uint32_t memControllers = config.get<uint32_t>("sys.mem.controllers", 1);
     assert(memControllers > 0);
 
+    // If specified, build an on-chip network between the LLC banks, their children and the memory controllers.
+    // Routers are numbered row-major; each of these three kinds of endpoints is spread evenly across routers
+    MeshNoC* noc = nullptr;
+    string nocType = config.get<const char*>("sys.noc.type", "None");
+    uint32_t llcBanks = (*cMap[llc])[0].size();
+    if (nocType != "None") {
+        if (nocType != "Mesh" && nocType != "Ring") panic("Invalid sys.noc.type %s (None, Mesh or Ring)", nocType.c_str());
+        bool ring = (nocType == "Ring");
+        uint32_t llcChildren = 0;
+        for (auto& childVec : childMap[llc]) for (auto& child : childVec) llcChildren += cMap[child]->size();
+        uint32_t defRouters = MAX(llcBanks, llcChildren);
+        uint32_t defXDim = ring? defRouters : (uint32_t)ceil(sqrt(defRouters));
+        uint32_t xDim = config.get<uint32_t>("sys.noc.xDim", defXDim);
+        uint32_t yDim = config.get<uint32_t>("sys.noc.yDim", ring? 1 : (defRouters + xDim - 1)/xDim);
+        uint32_t routerDelay = config.get<uint32_t>("sys.noc.routerDelay", 2);
+        uint32_t linkDelay = config.get<uint32_t>("sys.noc.linkDelay", 1);
+        uint32_t flitBytes = config.get<uint32_t>("sys.noc.flitBytes", 16);
+        if (!flitBytes) panic("sys.noc.flitBytes must be > 0");
+        uint32_t domain = zinfo->domainMapper->getDomain("noc", 0);
+        noc = new MeshNoC(ring, xDim, yDim, routerDelay, linkDelay, zinfo->lineSize, flitBytes, domain, "noc");
+    }
+
     g_vector<MemObject*> mems;
     mems.resize(memControllers);
 
@@ -521,14 +625,40 @@ static void InitSystem(Config& config) {
         ss << "mem-" << i;
         g_string name(ss.str().c_str());
         //uint32_t domain = nextDomain(); //i*zinfo->numDomains/memControllers;
-        uint32_t domain = i*zinfo->numDomains/memControllers;
+        //With separate memory domains, each controller (channel) gets its own domain after the base ones
+        uint32_t baseDomains = zinfo->domainMapper->getNumBaseDomains();
+        uint32_t defDomain = zinfo->domainMapper->getNumMemDomains()? baseDomains + i : i*baseDomains/memControllers;
+        uint32_t domain = zinfo->domainMapper->getDomain(name.c_str(), defDomain);
         mems[i] = BuildMemoryController(config, zinfo->lineSize, zinfo->freqMHz, domain, name);
+        if (zinfo->domainMapper->getNumMemDomains()) zinfo->contentionSim->setChannelDomain(domain);
+    }
+
+    if (noc) {
+        // Wrap controllers before the splitter, so each port knows its router; LLC banks' childIds index llcRouters
+        uint32_t routers = noc->getNumRouters();
+        g_vector<uint32_t> llcRouters;
+        for (uint32_t b = 0; b < llcBanks; b++) llcRouters.push_back(b*routers/llcBanks);
+        for (uint32_t i = 0; i < memControllers; i++) mems[i] = new NoCPort(noc, mems[i], i*routers/memControllers, llcRouters);
     }
 
     if (memControllers > 1) {
         bool splitAddrs = config.get<bool>("sys.mem.splitAddrs", true);
         if (splitAddrs) {
-            MemObject* splitter = new SplitAddrMemory(mems, "mem-splitter");
+            // Line or page interleaving, optionally XOR-hashed with the upper address bits
+            string interleave = config.get<const char*>("sys.mem.interleave", "line");
+            uint32_t interleaveLines = 1;
+            if (interleave == "page") {
+                uint32_t interleavePageSize = config.get<uint32_t>("sys.mem.interleavePageSize", 4096);
+                if (interleavePageSize < zinfo->lineSize || interleavePageSize % zinfo->lineSize) {
+                    panic("sys.mem.interleavePageSize (%d) must be a multiple of the line size (%d)", interleavePageSize, zinfo->lineSize);
+                }
+                interleaveLines = interleavePageSize/zinfo->lineSize;
+            } else if (interleave != "line") {
+                panic("Invalid sys.mem.interleave %s (line or page)", interleave.c_str());
+            }
+            string channelHash = config.get<const char*>("sys.mem.channelHash", "None");
+            if (channelHash != "None" && channelHash != "XOR") panic("Invalid sys.mem.channelHash %s (None or XOR)", channelHash.c_str());
+            MemObject* splitter = new SplitAddrMemory(mems, "mem-splitter", interleaveLines, channelHash == "XOR");
             mems.resize(1);
             mems[0] = splitter;
         }
@@ -586,6 +716,19 @@ static void InitSystem(Config& config) {
             g_vector<MemObject*> parentsVec;
             parentsVec.insert(parentsVec.end(), parentCaches[p].begin(), parentCaches[p].end()); //BaseCache* to MemObject* is a safe cast
 
+            if (noc && grp == llc) {
+                // LLC children reach each bank through a NoC port; childIds count child banks
+                assert(parents == 1);
+                uint32_t routers = noc->getNumRouters();
+                g_vector<uint32_t> childRouters;
+                for (uint32_t c = 0; c < children; c++) {
+                    for (uint32_t b = 0; b < childCaches[c].size(); b++) childRouters.push_back(c*routers/children);
+                }
+                for (uint32_t b = 0; b < parentsVec.size(); b++) {
+                    parentsVec[b] = new NoCPort(noc, parentsVec[b], b*routers/parentsVec.size(), childRouters);
+                }
+            }
+
             uint32_t childId = 0;
             g_vector<BaseCache*> childrenVec;
             for (uint32_t c = p*childrenPerParent; c < (p+1)*childrenPerParent; c++) {
@@ -632,6 +775,9 @@ static void InitSystem(Config& config) {
         unordered_map <string, vector<Core*>> coreMap;
         config.subgroups("sys.cores", coreGroupNames);
 
+        //Back timing-event slabs with huge pages (reduces TLB misses in the weave phase)
+        bool slabHugePages = config.get<bool>("sim.slabHugePages", false);
+
         uint32_t coreIdx = 0;
         for (const char* group : coreGroupNames) {
             if (parentMap.count(group)) panic("Core group name %s is invalid, a cache group already has that name", group);
@@ -701,16 +847,20 @@ static void InitSystem(Config& config) {
                     if (type == "Simple") {
                         core = new (&simpleCores[j]) SimpleCore(ic, dc, name);
                     } else if (type == "Timing") {
-                        uint32_t domain = j*zinfo->numDomains/cores;
+                        uint32_t domain = zinfo->domainMapper->getDomain(name.c_str(), j*zinfo->domainMapper->getNumBaseDomains()/cores);
                         TimingCore* tcore = new (&timingCores[j]) TimingCore(ic, dc, domain, name);
-                        zinfo->eventRecorders[coreIdx] = tcore->getEventRecorder();
-                        zinfo->eventRecorders[coreIdx]->setSourceId(coreIdx);
+                        tcore->getEventRecorder()->setSourceId(coreIdx);
+                        tcore->getEventRecorder()->setSlabHugePages(slabHugePages);
+                        //With analytical contention, components see no recorder and produce no events
+                        if (!zinfo->analyticalContention) zinfo->eventRecorders[coreIdx] = tcore->getEventRecorder();
                         core = tcore;
                     } else {
                         assert(type == "OOO");
                         OOOCore* ocore = new (&oooCores[j]) OOOCore(ic, dc, name);
-                        zinfo->eventRecorders[coreIdx] = ocore->getEventRecorder();
-                        zinfo->eventRecorders[coreIdx]->setSourceId(coreIdx);
+                        ocore->getEventRecorder()->setSourceId(coreIdx);
+                        ocore->getEventRecorder()->setSlabHugePages(slabHugePages);
+                        //With analytical contention, components see no recorder and produce no events
+                        if (!zinfo->analyticalContention) zinfo->eventRecorders[coreIdx] = ocore->getEventRecorder();
                         core = ocore;
                         if (automaton == "A3") ocore->useA3forBranchPred();
                     }
@@ -763,14 +913,45 @@ static void InitSystem(Config& config) {
             }
         }
 
-        //FIXME: For now, we assume we are driving a single-bank LLC
+        //Proxies may hang off different (and multi-banked) parents; the driver routes each record to the right bank
         string traceFile = config.get<const char*>("sim.traceFile");
         string retraceFile = config.get<const char*>("sim.retraceFile", ""); //leave empty to not retrace
+
+        //Replaying banks in parallel requires that they never interact, i.e., proxies are children of the LLC, which only has memory above
+        uint32_t replayThreads = config.get<uint32_t>("sim.replayThreads", 1);
+        if (replayThreads > 1) {
+            for (const char* grp : cacheGroupNames) {
+                if (isTerminal(grp) && parentMap[grp] != llc) {
+                    panic("sim.replayThreads > 1 requires trace proxies to be children of the LLC (%s), but %s's parent is %s", llc.c_str(), grp, parentMap[grp].c_str());
+                }
+            }
+        }
+
         zinfo->traceDriver = new TraceDriver(traceFile, retraceFile, proxies,
                 config.get<bool>("sim.useSkews", true), // incorporate skews in to playback and simulator results, not only the output trace
                 config.get<bool>("sim.playPuts", true),
-                config.get<bool>("sim.playAllGets", true));
+                config.get<bool>("sim.playAllGets", true),
+                replayThreads);
         zinfo->traceDriver->initStats(zinfo->rootStat);
+
+        //Set-sampled traces rename lines for a cache indexed by lineAddr % sampledSets; hashed arrays and banks (routed by parentIdHash) would scatter them
+        uint32_t sampledSets = zinfo->traceDriver->getSampledSets();
+        if (sampledSets) {
+            for (const char* grp : cacheGroupNames) {
+                if (!isTerminal(grp)) continue;
+                string parent = parentMap[grp];
+                string prefix = "sys.caches." + parent + ".";
+                string arrayType = config.get<const char*>(prefix + "array.type", "SetAssoc");
+                string hashType = config.get<const char*>(prefix + "array.hash", (arrayType == "Z")? "H3" : "None");
+                uint32_t banks = config.get<uint32_t>(prefix + "banks", 1);
+                uint32_t ways = (arrayType == "IdealLRU" || arrayType == "IdealLRUPart")? 0 : config.get<uint32_t>(prefix + "array.ways", 4);
+                uint32_t numSets = ways? config.get<uint32_t>(prefix + "size", 64*1024)/banks/zinfo->lineSize/ways : 1;
+                if (hashType != "None" || banks != 1 || numSets != sampledSets) {
+                    panic("Trace %s is set-sampled for an unhashed, single-bank cache with %d sets, but %s has a %s array with %s hash, %d banks and %d sets per bank",
+                            traceFile.c_str(), sampledSets, parent.c_str(), arrayType.c_str(), hashType.c_str(), banks, numSets);
+                }
+            }
+        }
     }
 
     //Init stats: caches, mem
@@ -778,6 +959,12 @@ static void InitSystem(Config& config) {
         AggregateStat* groupStat = new AggregateStat(true);
         groupStat->init(gm_strdup(group), "Cache stats");
         for (vector<BaseCache*>& banks : *cMap[group]) for (BaseCache* bank : banks) bank->initStats(groupStat);
+        if (zinfo->traceDriver && zinfo->traceDriver->getSampleScale() > 1) {
+            TraceDriver* drv = zinfo->traceDriver;
+            auto scaleStat = makeLambdaStat([drv]() { return drv->getSampleScale(); });
+            scaleStat->init("sampleScale", "Stats are for a sampled trace and not extrapolated; multiply by this scale");
+            groupStat->append(scaleStat);
+        }
         zinfo->rootStat->append(groupStat);
     }
 
@@ -788,6 +975,18 @@ static void InitSystem(Config& config) {
     memStat->init("mem", "Memory controller stats");
     for (auto mem : mems) mem->initStats(memStat);
     zinfo->rootStat->append(memStat);
+    if (noc) noc->initStats(zinfo->rootStat);
+
+    //Warm-up checkpoints: save after sim.checkpointPhase phases, and/or restore a previous one
+    g_vector<BaseCache*> allCaches;
+    for (const char* group : cacheGroupNames) {
+        for (vector<BaseCache*>& banks : *cMap[group]) for (BaseCache* bank : banks) allCaches.push_back(bank);
+    }
+    uint64_t checkpointPhase = config.get<uint64_t>("sim.checkpointPhase", 0); //0 to not save a checkpoint
+    string checkpointFile = config.get<const char*>("sim.checkpointFile", "zsim.ckpt");
+    string restoreCheckpoint = config.get<const char*>("sim.restoreCheckpoint", ""); //leave empty to start cold
+    zinfo->checkpointer = new Checkpointer(allCaches, checkpointPhase, checkpointFile.c_str());
+    if (!restoreCheckpoint.empty()) zinfo->checkpointer->restore(restoreCheckpoint.c_str());
 
     //Odds and ends: BuildCacheGroup new'd the cache groups, we need to delete them
     for (pair<string, CacheGroup*> kv : cMap) delete kv.second;
@@ -849,7 +1048,7 @@ static void PostInitStats(bool perProcessDir, Config& config) {
                 zinfo->trigger = i;
                 zinfo->eventualStatsBackend->dump(true /*buffered*/);
             };
-            zinfo->eventQueue->insert(makeAdaptiveEvent(getInstrs, dumpStats, 0, zinfo->maxMinInstrs, MAX_IPC*zinfo->phaseLength));
+            zinfo->eventQueue->insert(makeAdaptiveEvent(getInstrs, dumpStats, 0, zinfo->maxMinInstrs, MAX_IPC*zinfo->maxPhaseLength));
         }
     }
 
@@ -918,10 +1117,38 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
         assert(numCores <= MAX_THREADS); //TODO: Is there any reason for this limit?
     }
 
-    zinfo->numDomains = config.get<uint32_t>("sim.domains", 1);
-    uint32_t numSimThreads = config.get<uint32_t>("sim.contentionThreads", MAX((uint32_t)1, zinfo->numDomains/2)); //gives a bit of parallelism, TODO tune
-    zinfo->contentionSim = new ContentionSim(zinfo->numDomains, numSimThreads);
+    //Domains: static, loaded from a map, or one per component to profile load and write a balanced map
+    uint32_t configDomains = config.get<uint32_t>("sim.domains", 1);
+    string domainMap = config.get<const char*>("sim.domainMap", "");
+    uint64_t profileDomainPhases = config.get<uint64_t>("sim.profileDomainPhases", 0);
+    string domainMapOutput = config.get<const char*>("sim.domainMapOutput", "domain.map");
+    //Optionally give each memory controller its own weave domain, so channels are simulated in parallel with the rest of the system
+    bool separateMemDomains = config.get<bool>("sys.mem.separateDomains", false);
+    uint32_t memDomains = separateMemDomains? config.get<uint32_t>("sys.mem.controllers", 1) : 0;
+    zinfo->domainMapper = new DomainMapper(configDomains, memDomains, domainMap.c_str(), profileDomainPhases,
+            profileDomainPhases? CountDomainComponents(config) : 0, domainMapOutput.c_str());
+    zinfo->numDomains = zinfo->domainMapper->getNumDomains();
+    uint32_t threadDomains = zinfo->domainMapper->isProfiling()? configDomains : zinfo->numDomains; //don't size the pool for profiling domains
+    uint32_t numSimThreads = config.get<uint32_t>("sim.contentionThreads", MAX((uint32_t)1, threadDomains/2)); //gives a bit of parallelism, TODO tune
+    bool batchWeaveEvents = config.get<bool>("sim.batchWeaveEvents", false); //if set, publish domain progress once per batch of events
+    uint32_t weaveRebalancePhases = config.get<uint32_t>("sim.weaveRebalancePhases", 0); //0 = fixed domain-to-thread assignment
+
+    //Analytical contention: skip the weave phase, and have TimingCaches and DDR/MD1 memories estimate queueing delays from
+    //the load of previous phases instead. Much faster than weave simulation, but only approximates contention.
+    zinfo->analyticalContention = config.get<bool>("sim.analyticalContention", false);
+    if (zinfo->analyticalContention) info("Analytical contention model enabled, weave phase disabled");
+
+    //Weave-phase profiling and event DAG recording (off by default, they add overhead to every event)
+    uint64_t weaveDagStart = config.get<uint64_t>("sim.weaveDagStart", 0);
+    uint64_t weaveDagPhases = config.get<uint64_t>("sim.weaveDagPhases", 0);
+    string weaveDagFile = config.get<const char*>("sim.weaveDagFile", "weave-dag.bin");
+    if (config.get<bool>("sim.profileWeave", false) || weaveDagPhases) {
+        zinfo->weaveProfiler = new WeaveProfiler(zinfo->numDomains, weaveDagStart, weaveDagPhases, weaveDagFile.c_str());
+    }
+
+    zinfo->contentionSim = new ContentionSim(zinfo->numDomains, numSimThreads, batchWeaveEvents, weaveRebalancePhases);
     zinfo->contentionSim->initStats(zinfo->rootStat);
+    if (zinfo->domainMapper->isProfiling()) zinfo->contentionSim->enableCrossingCounts();
     zinfo->eventRecorders = gm_calloc<EventRecorder*>(zinfo->numCores);
 
     zinfo->traceWriters = new g_vector<AccessTraceWriter*>();
@@ -930,6 +1157,30 @@ void SimInit(const char* configFile, const char* outputDir, uint32_t shmid) {
     zinfo->numPhases = 0;
 
     zinfo->phaseLength = config.get<uint32_t>("sim.phaseLength", 10000);
+    if (zinfo->phaseLength == 0) panic("sim.phaseLength must be > 0");
+    zinfo->nextPhaseLength = zinfo->phaseLength;
+    zinfo->maxPhaseLength = zinfo->phaseLength;
+
+    //Adaptive phase length: sim.phaseLength is the initial length
+    if (config.get<bool>("sim.adaptivePhaseLength", false)) {
+        uint32_t minPhaseLength = config.get<uint32_t>("sim.minPhaseLength", MAX(zinfo->phaseLength/8, (uint32_t)1));
+        uint32_t maxPhaseLength = config.get<uint32_t>("sim.maxPhaseLength", zinfo->phaseLength*8);
+        if (minPhaseLength == 0 || minPhaseLength > zinfo->phaseLength || maxPhaseLength < zinfo->phaseLength) {
+            panic("Adaptive phase length needs 0 < sim.minPhaseLength (%d) <= sim.phaseLength (%d) <= sim.maxPhaseLength (%d)",
+                    minPhaseLength, zinfo->phaseLength, maxPhaseLength);
+        }
+        uint32_t adaptInterval = config.get<uint32_t>("sim.phaseAdaptInterval", 10);
+        if (adaptInterval == 0) panic("sim.phaseAdaptInterval must be > 0");
+        double maxViolRate = config.get<double>("sim.phaseMaxViolationRate", 0.001);
+        double maxStallRate = config.get<double>("sim.phaseMaxCrossingStallRate", 0.1);
+        double maxLeaveRate = config.get<double>("sim.phaseMaxLeaveRate", 0.05);
+        double maxWaitFrac = config.get<double>("sim.phaseMaxBarrierWait", 0.5);
+        string phaseLogFile = config.get<const char*>("sim.phaseLengthLog", "phase-lengths.csv");
+        zinfo->maxPhaseLength = maxPhaseLength;
+        zinfo->phaseController = new PhaseLengthController(minPhaseLength, maxPhaseLength, adaptInterval,
+                maxViolRate, maxStallRate, maxLeaveRate, maxWaitFrac, phaseLogFile.c_str());
+        zinfo->phaseController->initStats(zinfo->rootStat);
+    }
     zinfo->statsPhaseInterval = config.get<uint32_t>("sim.statsPhaseInterval", 100);
     zinfo->freqMHz = config.get<uint32_t>("sys.frequency", 2000);
 
@@ -60,68 +60,82 @@ uint64_t SimpleMemory::access(MemReq& req) {
 
 
 
-MD1Memory::MD1Memory(uint32_t requestSize, uint32_t megacyclesPerSecond, uint32_t megabytesPerSecond, uint32_t _zeroLoadLatency, g_string& _name)
-    : zeroLoadLatency(_zeroLoadLatency), name(_name)
+MD1Model::MD1Model(double _unitsPerCycle, double _serviceCycles)
+    : unitsPerCycle(_unitsPerCycle), serviceCycles(_serviceCycles)
 {
+    assert(unitsPerCycle > 0.0);
     lastPhase = 0;
+    lastPhaseCycles = 0;
+    smoothedPhaseUnits = 0.0;
+    smoothedPhaseRequests = 0.0;
+    curDelay = 0;
+    curPhaseUnits = 0;
+    curPhaseRequests = 0;
+    futex_init(&updateLock);
+}
 
-    double bytesPerCycle = ((double)megabytesPerSecond)/((double)megacyclesPerSecond);
-    maxRequestsPerCycle = bytesPerCycle/requestSize;
-    assert(maxRequestsPerCycle > 0.0);
-
-    zeroLoadLatency = _zeroLoadLatency;
-
-    smoothedPhaseAccesses = 0.0;
-    curPhaseAccesses = 0;
-    curLatency = zeroLoadLatency;
+void MD1Model::initStats(AggregateStat* parentStat) {
+    profLoad.init("load", "Sum of load factors (0-100) per update"); parentStat->append(&profLoad);
+    profUpdates.init("ups", "Number of latency updates"); parentStat->append(&profUpdates);
+    profClampedLoads.init("clampedLoads", "Number of updates where the load was clamped to 95%"); parentStat->append(&profClampedLoads);
+}
 
-    futex_init(&updateLock);
+uint32_t MD1Model::getDelay() {
+    if (zinfo->numPhases > lastPhase) {
+        futex_lock(&updateLock);
+        //Recheck, someone may have updated already
+        if (zinfo->numPhases > lastPhase) {
+            update();
+        }
+        futex_unlock(&updateLock);
+    }
+    return curDelay;
 }
 
-void MD1Memory::updateLatency() {
-    uint32_t phaseCycles = (zinfo->numPhases - lastPhase)*(zinfo->phaseLength);
+void MD1Model::update() {
+    uint64_t phaseCycles = zinfo->globPhaseCycles - lastPhaseCycles;
     if (phaseCycles < 10000) return; //Skip with short phases
 
-    smoothedPhaseAccesses =  (curPhaseAccesses*0.5) + (smoothedPhaseAccesses*0.5);
-    double requestsPerCycle = smoothedPhaseAccesses/((double)phaseCycles);
-    double load = requestsPerCycle/maxRequestsPerCycle;
+    smoothedPhaseUnits = (curPhaseUnits*0.5) + (smoothedPhaseUnits*0.5);
+    smoothedPhaseRequests = (curPhaseRequests*0.5) + (smoothedPhaseRequests*0.5);
+    double load = smoothedPhaseUnits/(unitsPerCycle*phaseCycles);
 
     //Clamp load
     if (load > 0.95) {
-        //warn("MC: Load exceeds limit, %f, clamping, curPhaseAccesses %d, smoothed %f, phase %ld", load, curPhaseAccesses, smoothedPhaseAccesses, zinfo->numPhases);
         load = 0.95;
         profClampedLoads.inc();
     }
 
+    double svcCycles = serviceCycles;
+    if (svcCycles == 0.0) svcCycles = (smoothedPhaseRequests > 0.0)? smoothedPhaseUnits/smoothedPhaseRequests : 0.0;
     double latMultiplier = 1.0 + 0.5*load/(1.0 - load); //See Pollancek-Khinchine formula
-    curLatency = (uint32_t)(latMultiplier*zeroLoadLatency);
+    curDelay = (uint32_t)(latMultiplier*svcCycles) - (uint32_t)svcCycles;
 
-    //info("%s: Load %.2f, latency multiplier %.2f, latency %d", name.c_str(), load, latMultiplier, curLatency);
     uint32_t intLoad = (uint32_t)(load*100.0);
     profLoad.inc(intLoad);
     profUpdates.inc();
 
-    curPhaseAccesses = 0;
+    curPhaseUnits = 0;
+    curPhaseRequests = 0;
+    lastPhaseCycles = zinfo->globPhaseCycles;
     __sync_synchronize();
     lastPhase = zinfo->numPhases;
 }
 
+
+MD1Memory::MD1Memory(uint32_t requestSize, uint32_t megacyclesPerSecond, uint32_t megabytesPerSecond, uint32_t _zeroLoadLatency, g_string& _name)
+    : model(((double)megabytesPerSecond)/((double)megacyclesPerSecond)/requestSize /*max requests per cycle*/, _zeroLoadLatency),
+      zeroLoadLatency(_zeroLoadLatency), name(_name) {}
+
 uint64_t MD1Memory::access(MemReq& req) {
-    if (zinfo->numPhases > lastPhase) {
-        futex_lock(&updateLock);
-        //Recheck, someone may have updated already
-        if (zinfo->numPhases > lastPhase) {
-            updateLatency();
-        }
-        futex_unlock(&updateLock);
-    }
+    uint32_t curLatency = zeroLoadLatency + model.getDelay();
 
     switch (req.type) {
         case PUTX:
             //Dirty wback
             profWrites.atomicInc();
             profTotalWrLat.atomicInc(curLatency);
-            __sync_fetch_and_add(&curPhaseAccesses, 1);
+            model.record(1);
             //Note no break
         case PUTS:
             //Not a real access -- memory must treat clean wbacks as if they never happened.
@@ -130,13 +144,13 @@ uint64_t MD1Memory::access(MemReq& req) {
         case GETS:
             profReads.atomicInc();
             profTotalRdLat.atomicInc(curLatency);
-            __sync_fetch_and_add(&curPhaseAccesses, 1);
+            model.record(1);
             *req.state = req.is(MemReq::NOEXCL)? S : E;
             break;
         case GETX:
             profReads.atomicInc();
             profTotalRdLat.atomicInc(curLatency);
-            __sync_fetch_and_add(&curPhaseAccesses, 1);
+            model.record(1);
             *req.state = M;
             break;
 
@@ -46,16 +46,62 @@ class SimpleMemory : public MemObject {
 };
 
 
+/* M/D/1 queueing model of a resource, driven by the load observed in the
+ * bound phase. Requests record the units of capacity they use (e.g., 1 per
+ * request for a bandwidth-limited channel, or cycles an MSHR was held), and
+ * once per phase, the smoothed load of the previous phases sets the queueing
+ * delay for the next one (Pollaczek-Khinchine formula). The service time is
+ * either fixed or, if 0, the measured average units per request.
+ *
+ * Used by MD1Memory, and by TimingCache and DDRMemory when
+ * sim.analyticalContention replaces the weave phase.
+ */
+class MD1Model : public GlobAlloc {
+    private:
+        double unitsPerCycle; //capacity
+        double serviceCycles;
+        uint64_t lastPhase;
+        uint64_t lastPhaseCycles; //globPhaseCycles at lastPhase
+        double smoothedPhaseUnits;
+        double smoothedPhaseRequests;
+        volatile uint32_t curDelay;
+
+        PAD();
+
+        Counter profLoad;
+        Counter profUpdates;
+        Counter profClampedLoads;
+        volatile uint64_t curPhaseUnits;
+        volatile uint64_t curPhaseRequests;
+
+        lock_t updateLock;
+        PAD();
+
+    public:
+        MD1Model(double _unitsPerCycle, double _serviceCycles);
+
+        void initStats(AggregateStat* parentStat);
+
+        //Queueing delay for requests issued in the current phase
+        uint32_t getDelay();
+
+        void record(uint64_t units) {
+            __sync_fetch_and_add(&curPhaseUnits, units);
+            __sync_fetch_and_add(&curPhaseRequests, 1);
+        }
+
+    private:
+        void update();
+};
+
+
 /* Implements a memory controller with limited bandwidth, throttling latency
  * using an M/D/1 queueing model.
  */
 class MD1Memory : public MemObject {
     private:
-        uint64_t lastPhase;
-        double maxRequestsPerCycle;
-        double smoothedPhaseAccesses;
+        MD1Model model;
         uint32_t zeroLoadLatency;
-        uint32_t curLatency;
 
         PAD();
 
@@ -63,13 +109,8 @@ class MD1Memory : public MemObject {
         Counter profWrites;
         Counter profTotalRdLat;
         Counter profTotalWrLat;
-        Counter profLoad;
-        Counter profUpdates;
-        Counter profClampedLoads;
-        uint32_t curPhaseAccesses;
 
         g_string name; //barely used
-        lock_t updateLock;
         PAD();
 
     public:
@@ -82,9 +123,7 @@ class MD1Memory : public MemObject {
             profWrites.init("wr", "Write requests"); memStats->append(&profWrites);
             profTotalRdLat.init("rdlat", "Total latency experienced by read requests"); memStats->append(&profTotalRdLat);
             profTotalWrLat.init("wrlat", "Total latency experienced by write requests"); memStats->append(&profTotalWrLat);
-            profLoad.init("load", "Sum of load factors (0-100) per update"); memStats->append(&profLoad);
-            profUpdates.init("ups", "Number of latency updates"); memStats->append(&profUpdates);
-            profClampedLoads.init("clampedLoads", "Number of updates where the load was clamped to 95%"); memStats->append(&profClampedLoads);
+            model.initStats(memStats);
             parentStat->append(memStats);
         }
 
@@ -92,9 +131,6 @@ class MD1Memory : public MemObject {
         uint64_t access(MemReq& req);
 
         const char* getName() {return name.c_str();}
-
-    private:
-        void updateLatency();
 };
 
 #endif  // MEM_CTRLS_H_
@@ -44,6 +44,14 @@ const char* MESIStateName(MESIState s) {
     return mesiStateNames[s];
 }
 
+void BaseCache::saveState(CheckpointWriter& cw) {
+    panic("%s does not support checkpoints", getName());
+}
+
+void BaseCache::loadState(CheckpointReader& cr) {
+    panic("%s does not support checkpoints", getName());
+}
+
 #include <type_traits>
 
 static inline void CompileTimeAsserts() {
@@ -119,6 +119,8 @@ struct InvReq {
 
 class AggregateStat;
 class Network;
+class CheckpointReader;
+class CheckpointWriter;
 
 /* Base class for all memory objects (caches and memories) */
 class MemObject : public GlobAlloc {
@@ -135,6 +137,10 @@ class BaseCache : public MemObject {
         virtual void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network) = 0;
         virtual void setChildren(const g_vector<BaseCache*>& children, Network* network) = 0;
         virtual uint64_t invalidate(const InvReq& req) = 0;
+
+        //Warm-up checkpoints (see checkpoint.h); the default panics, caches must opt in
+        virtual void saveState(CheckpointWriter& cw);
+        virtual void loadState(CheckpointReader& cr);
 };
 
 #endif  // MEMORY_HIERARCHY_H_
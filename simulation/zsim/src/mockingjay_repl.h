@@ -429,6 +429,54 @@ class MockingjayReplPolicy : public ReplPolicy {
     }
 
     DECL_RANK_BINDINGS;
+
+    // Checkpoints hold the per-line ETRs, per-set clocks and timestamps, the RDP and the sampled cache
+    void saveState(CheckpointWriter& cw) override {
+        cw.writeArray(etr, numLines);
+        cw.writeArray(etrClock, numSets);
+        cw.writeArray(currentTimestamp, numSets);
+
+        cw.write((uint64_t)rdp.size());
+        for (auto& entry : rdp) {
+            cw.write(entry.first);
+            cw.write(entry.second);
+        }
+
+        cw.write((uint64_t)sampledCache.size());
+        for (auto& entry : sampledCache) {
+            cw.write(entry.first);
+            cw.writeArray(entry.second, SAMPLED_CACHE_WAYS);
+        }
+    }
+
+    void loadState(CheckpointReader& cr) override {
+        cr.readArray(etr, numLines);
+        cr.readArray(etrClock, numSets);
+        cr.readArray(currentTimestamp, numSets);
+
+        uint64_t rdpSize;
+        cr.read(rdpSize);
+        rdp.clear();
+        for (uint64_t i = 0; i < rdpSize; i++) {
+            uint32_t signature;
+            int rd;
+            cr.read(signature);
+            cr.read(rd);
+            rdp[signature] = rd;
+        }
+
+        uint64_t sampledSets;
+        cr.read(sampledSets);
+        for (auto& entry : sampledCache) delete[] entry.second;
+        sampledCache.clear();
+        for (uint64_t i = 0; i < sampledSets; i++) {
+            uint32_t set;
+            cr.read(set);
+            SampledCacheLine* lines = new SampledCacheLine[SAMPLED_CACHE_WAYS]();
+            cr.readArray(lines, SAMPLED_CACHE_WAYS);
+            sampledCache[set] = lines;
+        }
+    }
 };
 
 #endif // MOCKINGJAY_REPL_H_
\ No newline at end of file
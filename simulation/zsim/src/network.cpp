@@ -26,11 +26,15 @@
 #include "network.h"
 #include <fstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "log.h"
 
 using std::ifstream;
 using std::string;
 
+#define UNKNOWN_NODE "<unknown>"
+
 Network::Network(const char* filename) {
     ifstream inFile(filename);
 
@@ -38,6 +42,19 @@ Network::Network(const char* filename) {
         panic("Could not open network description file %s", filename);
     }
 
+    // Parse into a name -> id map and a list of links, then build the matrix once we know the number of nodes
+    std::unordered_map<string, uint32_t> ids;
+    struct Link {uint32_t src, dst, delay;};
+    std::vector<Link> links;
+    auto nodeId = [&](const string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        uint32_t id = nodeNames.size();
+        ids[name] = id;
+        nodeNames.push_back(g_string(name.c_str()));
+        return id;
+    };
+
     while (inFile.good()) {
         string src, dst;
         uint32_t delay;
@@ -47,35 +64,46 @@ Network::Network(const char* filename) {
 
         if (inFile.eof()) break;
 
-        string s1 = src + " " + dst;
-        string s2 = dst + " " + src;
-
-        assert((delayMap.find(s1) == delayMap.end()));
-        assert((delayMap.find(s2) == delayMap.end()));
-
-        delayMap[s1] = delay;
-        delayMap[s2] = delay;
+        Link l = {nodeId(src), nodeId(dst), delay};
+        links.push_back(l);
 
         //info("Parsed %s %s %d", src.c_str(), dst.c_str(), delay);
     }
 
     inFile.close();
+
+    nodeNames.push_back(UNKNOWN_NODE);  // last id, never linked
+    numNodes = nodeNames.size();
+    rtts.resize(numNodes*numNodes, 0);
+    linked.resize(numNodes*numNodes, false);
+    for (const Link& l : links) {
+        uint32_t fwd = l.src*numNodes + l.dst;
+        uint32_t bwd = l.dst*numNodes + l.src;
+        assert_msg(!linked[fwd] && !linked[bwd], "%s and %s appear twice in network description file %s",
+                nodeNames[l.src].c_str(), nodeNames[l.dst].c_str(), filename);
+        rtts[fwd] = rtts[bwd] = 2*l.delay;
+        linked[fwd] = linked[bwd] = true;
+    }
+    info("Network: %d nodes, %ld links", numNodes - 1, links.size());
 }
 
-uint32_t Network::getRTT(const char* src, const char* dst) {
-    string key(src);
-    key += " ";
-    key += dst;
+uint32_t Network::getNodeId(const char* name) const {
+    // Linear search, but this is only called at init
+    for (uint32_t id = 0; id < numNodes - 1; id++) {
+        if (nodeNames[id] == name) return id;
+    }
+    return numNodes - 1;
+}
+
+uint32_t Network::getRTT(const char* src, const char* dst) const {
+    uint32_t srcId = getNodeId(src);
+    uint32_t dstId = getNodeId(dst);
 /* dsm: Be sloppy, deadline deadline deadline
-    assert_msg(delayMap.find(key) != delayMap.end(), "%s and %s cannot communicate, according to the network description file", src, dst);
-    return 2*delayMap[key];
+    assert_msg(linked[srcId*numNodes + dstId], "%s and %s cannot communicate, according to the network description file", src, dst);
     */
 
-    if (delayMap.find(key) != delayMap.end()) {
-        return 2*delayMap[key];
-    } else {
+    if (!linked[srcId*numNodes + dstId]) {
         warn("%s and %s have no entry in network description file, returning 0 latency", src, dst);
-        return 0;
     }
+    return getRTT(srcId, dstId);
 }
-
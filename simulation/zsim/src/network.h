@@ -30,19 +30,40 @@
  * entities, then accepts queries for roundtrip times between these entities.
  * There is no contention modeling or even support for serialization latency.
  * This is a basic model that should be extended as appropriate.
+ *
+ * The file is compiled into a dense RTT matrix indexed by node id. Names are
+ * resolved to ids once, when components register (getNodeId), so per-access
+ * lookups (getRTT on ids) are a single load and do not allocate.
  */
 
-#include <string>
-#include <unordered_map>
+#include <stdint.h>
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "log.h"
 
-class Network {
+class Network : public GlobAlloc {
     private:
-        std::unordered_map<std::string, uint32_t> delayMap;
+        g_vector<g_string> nodeNames;  // node id -> name
+        uint32_t numNodes;  // includes the unknown node
+        g_vector<uint32_t> rtts;  // numNodes x numNodes, in cycles
+        g_vector<bool> linked;  // pairs listed in the file
 
     public:
         explicit Network(const char* filename);
-        uint32_t getRTT(const char* src, const char* dst);
+
+        // Names not in the file map to a single unknown node, with 0 RTT to everything
+        uint32_t getNodeId(const char* name) const;
+        const char* getNodeName(uint32_t id) const {return nodeNames[id].c_str();}
+        uint32_t getNumNodes() const {return numNodes;}
+
+        inline uint32_t getRTT(uint32_t srcId, uint32_t dstId) const {
+            assert(srcId < numNodes && dstId < numNodes);
+            return rtts[srcId*numNodes + dstId];
+        }
+
+        // Init-time lookup by name (e.g., when caches register); warns if the pair is not in the file
+        uint32_t getRTT(const char* src, const char* dst) const;
 };
 
 #endif  // NETWORK_H_
-
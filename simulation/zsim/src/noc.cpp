@@ -0,0 +1,155 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "noc.h"
+#include "bithacks.h"
+#include "event_recorder.h"
+#include "zsim.h"
+
+MeshNoC::MeshNoC(bool _ring, uint32_t _xDim, uint32_t _yDim, uint32_t _routerDelay, uint32_t _linkDelay, uint32_t lineSize,
+        uint32_t flitBytes, uint32_t _domain, const g_string& _name)
+    : ring(_ring), xDim(_xDim), yDim(_yDim), numRouters(_xDim*_yDim), routerDelay(_routerDelay), linkDelay(_linkDelay),
+      dataFlits(1 + (lineSize + flitBytes - 1)/flitBytes), domain(_domain), name(_name)
+{
+    if (!numRouters) panic("%s: needs at least one router", name.c_str());
+    if (ring && yDim != 1) panic("%s: a ring has yDim = 1", name.c_str());
+    Link l = {0};
+    links.resize(numRouters*NUM_DIRS, l);
+    info("%s: %dx%d %s, %d-cycle routers, %d-cycle links, %d-flit data messages, domain %d", name.c_str(), xDim, yDim,
+            ring? "ring" : "mesh", routerDelay, linkDelay, dataFlits, domain);
+}
+
+void MeshNoC::initStats(AggregateStat* parentStat) {
+    AggregateStat* nocStats = new AggregateStat();
+    nocStats->init(name.c_str(), "NoC stats");
+    profLinkFlits.init("linkFlits", "Flits sent per link (router*4 + E/W/N/S)", numRouters*NUM_DIRS); nocStats->append(&profLinkFlits);
+    profTraversals.init("msgs", "Messages sent"); nocStats->append(&profTraversals);
+    profHops.init("hops", "Total hops traversed by messages"); nocStats->append(&profHops);
+    profFlits.init("flits", "Total flits sent"); nocStats->append(&profFlits);
+    profZeroLoadLat.init("zllat", "Total zero-load latency of messages"); nocStats->append(&profZeroLoadLat);
+    profTotalLat.init("lat", "Total latency of messages, incl. link contention"); nocStats->append(&profTotalLat);
+
+    auto linkUtil = [this](uint32_t l) {
+        uint64_t cycles = zinfo->globPhaseCycles;
+        return cycles? 1000*profLinkFlits.count(l)/cycles : 0;
+    };
+    auto linkUtilStat = makeLambdaVectorStat(linkUtil, numRouters*NUM_DIRS);
+    linkUtilStat->init("linkUtil", "Link utilization, flits per cycle (x1000)");
+    nocStats->append(linkUtilStat);
+    auto hopLat = [this]() {
+        uint64_t hops = profHops.get();
+        return hops? 1000*profTotalLat.get()/hops : 0;
+    };
+    auto hopLatStat = makeLambdaStat(hopLat);
+    hopLatStat->init("hopLat", "Average latency per hop, incl. link contention (x1000)");
+    nocStats->append(hopLatStat);
+    parentStat->append(nocStats);
+}
+
+uint32_t MeshNoC::getHops(uint32_t src, uint32_t dst) const {
+    assert(src < numRouters && dst < numRouters);
+    if (ring) {
+        uint32_t fwd = (dst + numRouters - src) % numRouters;
+        return MIN(fwd, numRouters - fwd);
+    }
+    uint32_t sx = src % xDim, sy = src / xDim;
+    uint32_t dx = dst % xDim, dy = dst / xDim;
+    return ((sx > dx)? sx - dx : dx - sx) + ((sy > dy)? sy - dy : dy - sy);
+}
+
+MeshNoC::Dir MeshNoC::route(uint32_t cur, uint32_t dst) const {
+    assert(cur != dst);
+    if (ring) {
+        uint32_t fwd = (dst + numRouters - cur) % numRouters;
+        return (fwd <= numRouters - fwd)? EAST : WEST;
+    }
+    // XY routing: fix the column first, then the row
+    uint32_t cx = cur % xDim, dx = dst % xDim;
+    if (cx != dx) return (dx > cx)? EAST : WEST;
+    return (dst > cur)? NORTH : SOUTH;
+}
+
+uint32_t MeshNoC::neighbor(uint32_t router, Dir dir) const {
+    if (ring) return (dir == EAST)? (router + 1) % numRouters : (router + numRouters - 1) % numRouters;
+    switch (dir) {
+        case EAST: return router + 1;
+        case WEST: return router - 1;
+        case NORTH: return router + xDim;
+        case SOUTH: return router - xDim;
+        default: panic("Invalid direction %d", dir);
+    }
+}
+
+uint64_t MeshNoC::traverse(uint32_t src, uint32_t dst, uint32_t flits, uint64_t startCycle) {
+    // The head flit goes through each router, waits for its output link to be free, and reserves it
+    // for the whole message; the tail arrives flits-1 cycles after the head
+    uint64_t cycle = startCycle;
+    uint32_t hops = 0;
+    uint32_t cur = src;
+    while (cur != dst) {
+        Dir dir = route(cur, dst);
+        Link& link = links[cur*NUM_DIRS + dir];
+        cycle = MAX(cycle + routerDelay, link.freeCycle);
+        link.freeCycle = cycle + flits;
+        profLinkFlits.inc(cur*NUM_DIRS + dir, flits);
+        cycle += linkDelay;
+        cur = neighbor(cur, dir);
+        hops++;
+    }
+    if (hops) cycle += flits - 1;
+
+    uint32_t zeroLoadLat = getZeroLoadLatency(src, dst, flits);
+    assert(hops == getHops(src, dst) && cycle >= startCycle + zeroLoadLat);
+    profTraversals.inc();
+    profHops.inc(hops);
+    profFlits.inc(flits*hops);
+    profZeroLoadLat.inc(zeroLoadLat);
+    profTotalLat.inc(cycle - startCycle);
+    return cycle;
+}
+
+uint64_t NoCPort::access(MemReq& req) {
+    assert(req.childId < childRouters.size());
+    uint32_t srcRouter = childRouters[req.childId];
+    // Requests carry data on writebacks, responses on GETs (PUTs get a 1-flit ack)
+    uint32_t reqFlits = noc->getFlits(req.type == PUTX);
+    uint32_t respFlits = noc->getFlits(req.type == GETS || req.type == GETX);
+
+    EventRecorder* evRec = zinfo->eventRecorders[req.srcId];
+    AccessChain chain(evRec);
+    AccessChain::Point p = chain.begin(req.cycle);
+    uint32_t reqLat = noc->getZeroLoadLatency(srcRouter, dstRouter, reqFlits);
+    p = chain.append(p, evRec? new (evRec) NoCTraversalEvent(noc, srcRouter, dstRouter, reqFlits) : nullptr, reqLat);
+
+    MemReq fwdReq = req;
+    fwdReq.cycle = p.cycle;
+    uint64_t respCycle = parent->access(fwdReq);
+    p = chain.append(p, fwdReq.cycle, respCycle);
+
+    uint32_t respLat = noc->getZeroLoadLatency(dstRouter, srcRouter, respFlits);
+    p = chain.append(p, evRec? new (evRec) NoCTraversalEvent(noc, dstRouter, srcRouter, respFlits) : nullptr, respLat);
+    chain.finish(req, p);
+    return p.cycle;
+}
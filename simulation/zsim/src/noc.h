@@ -0,0 +1,143 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOC_H_
+#define NOC_H_
+
+#include <stdint.h>
+#include "access_chain.h"
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "memory_hierarchy.h"
+#include "stats.h"
+#include "timing_event.h"
+
+/* On-chip network with link contention, for the traffic between a cache
+ * level's banks and their children and parents (sys.noc). Unlike the
+ * fixed-delay Network, it models router pipeline latency, per-link bandwidth
+ * and queueing:
+ *  - Topology: a 2D mesh with XY (dimension-order) routing, or a
+ *    bidirectional ring with shortest-direction routing. Each router has an
+ *    output link per direction.
+ *  - Messages are 1 flit (requests, acks) or 1 + lineSize/flitBytes flits
+ *    (data). Each hop takes routerDelay + linkDelay cycles, and a link
+ *    carries one flit per cycle.
+ *  - The bound phase charges zero-load latency. Contention is simulated in
+ *    the weave phase: each traversal is a TimingEvent that reserves its
+ *    links in order (wormhole-style, the head waits for each link to free up)
+ *    and finishes when the tail arrives. All NoC events run in a single weave
+ *    domain, so link state needs no locking.
+ * With sim.analyticalContention, there is no weave phase, so the NoC only
+ * adds zero-load latency.
+ */
+class MeshNoC : public GlobAlloc {
+    public:
+        enum Dir {EAST, WEST, NORTH, SOUTH, NUM_DIRS};  // ring links are EAST (+1) and WEST (-1)
+
+    private:
+        struct Link {
+            uint64_t freeCycle;  // first cycle the link can take a new flit
+        };
+
+        const bool ring;
+        const uint32_t xDim, yDim;
+        const uint32_t numRouters;
+        const uint32_t routerDelay, linkDelay;
+        const uint32_t dataFlits;
+        const uint32_t domain;
+        const g_string name;
+
+        g_vector<Link> links;  // indexed by router*NUM_DIRS + dir
+
+        // Weave-phase stats; only NoC events touch them, and they run in a single domain
+        VectorCounter profLinkFlits;
+        Counter profTraversals, profHops, profFlits;
+        Counter profZeroLoadLat, profTotalLat;
+
+    public:
+        MeshNoC(bool _ring, uint32_t _xDim, uint32_t _yDim, uint32_t _routerDelay, uint32_t _linkDelay, uint32_t lineSize,
+                uint32_t flitBytes, uint32_t _domain, const g_string& _name);
+
+        void initStats(AggregateStat* parentStat);
+        const char* getName() const {return name.c_str();}
+
+        uint32_t getNumRouters() const {return numRouters;}
+        uint32_t getDomain() const {return domain;}
+        uint32_t getFlits(bool hasData) const {return hasData? dataFlits : 1;}
+        uint32_t getHops(uint32_t src, uint32_t dst) const;
+
+        uint32_t getZeroLoadLatency(uint32_t src, uint32_t dst, uint32_t flits) const {
+            uint32_t hops = getHops(src, dst);
+            return hops? hops*(routerDelay + linkDelay) + flits - 1 : 0;
+        }
+
+        // Weave phase: sends a message that is ready at startCycle, returns the cycle its tail arrives
+        uint64_t traverse(uint32_t src, uint32_t dst, uint32_t flits, uint64_t startCycle);
+
+    private:
+        // Next router and output link from cur towards dst
+        Dir route(uint32_t cur, uint32_t dst) const;
+        uint32_t neighbor(uint32_t router, Dir dir) const;
+};
+
+class NoCTraversalEvent : public TimingEvent {
+    private:
+        MeshNoC* noc;
+        uint32_t src, dst, flits;
+
+    public:
+        NoCTraversalEvent(MeshNoC* _noc, uint32_t _src, uint32_t _dst, uint32_t _flits)
+            : TimingEvent(0, 0, _noc->getDomain()), noc(_noc), src(_src), dst(_dst), flits(_flits) {setType(EVT_NOC);}
+
+        void simulate(uint64_t startCycle) {
+            done(noc->traverse(src, dst, flits, startCycle));
+        }
+};
+
+/* Connects the children of a NoC-attached level to one of their parents
+ * (a cache bank or memory controller at router dstRouter). Children's
+ * requests and the parent's responses cross the NoC; the child's router comes
+ * from req.childId. Invalidations do not go through ports, and keep using
+ * the fixed-delay Network, if any.
+ */
+class NoCPort : public MemObject {
+    private:
+        MeshNoC* const noc;
+        MemObject* const parent;
+        const uint32_t dstRouter;
+        const g_vector<uint32_t> childRouters;  // indexed by childId
+        const g_string name;
+
+    public:
+        NoCPort(MeshNoC* _noc, MemObject* _parent, uint32_t _dstRouter, const g_vector<uint32_t>& _childRouters)
+            : noc(_noc), parent(_parent), dstRouter(_dstRouter), childRouters(_childRouters), name(_parent->getName()) {}
+
+        uint64_t access(MemReq& req);
+        // Transparent to stats; the NoC's own are reported separately
+        void initStats(AggregateStat* parentStat) {parent->initStats(parentStat);}
+        const char* getName() {return name.c_str();}
+};
+
+#endif  // NOC_H_
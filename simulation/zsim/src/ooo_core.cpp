@@ -116,11 +116,13 @@ void OOOCore::initStats(AggregateStat* parentStat) {
     profIssueStalls.init("issueStalls",  "Issue stalls");  coreStat->append(&profIssueStalls);
 #endif
 
+    cRec.getEventRecorder()->initStats(coreStat);
+
     parentStat->append(coreStat);
 }
 
 uint64_t OOOCore::getInstrs() const {return instrs;}
-uint64_t OOOCore::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
+uint64_t OOOCore::getPhaseCycles() const {return curCycle - zinfo->globPhaseCycles;}
 
 void OOOCore::contextSwitch(int32_t gid) {
     if (gid == -1) {
@@ -542,6 +544,7 @@ void OOOCore::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
         // This is fine, since the loop looks at core values directly and there are no locals involved,
         // so we should just advance as needed and move on.
         if (newCid != cid) break;  /*context-switch, we do not own this context anymore*/
+        core->phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength; //phases may change length
     }
 }
 
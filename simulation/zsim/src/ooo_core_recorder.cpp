@@ -41,7 +41,7 @@ class OOOIssueEvent : public TimingEvent {
         uint64_t id;
 
     public:
-        OOOIssueEvent(uint32_t preDelay, uint64_t _zllStartCycle, OOOCoreRecorder* _cRec, int32_t domain = -1) : TimingEvent(preDelay, 0, domain), zllStartCycle(_zllStartCycle), cRec(_cRec) {}
+        OOOIssueEvent(uint32_t preDelay, uint64_t _zllStartCycle, OOOCoreRecorder* _cRec, int32_t domain = -1) : TimingEvent(preDelay, 0, domain), zllStartCycle(_zllStartCycle), cRec(_cRec) {setType(EVT_OOO_ISSUE);}
 
         void simulate(uint64_t startCycle) {
             TRACE_MSG("Issue %ld zllStartCycle %ld startCycle %ld minStartCycle %ld", id, zllStartCycle, startCycle, getMinStartCycle());
@@ -65,7 +65,7 @@ class OOODispatchEvent : public TimingEvent {
         uint64_t id;
 
     public:
-        OOODispatchEvent(uint64_t preDelay, uint64_t _zllStartCycle, int32_t domain = -1) : TimingEvent(preDelay, 0, domain), zllStartCycle(_zllStartCycle) {}
+        OOODispatchEvent(uint64_t preDelay, uint64_t _zllStartCycle, int32_t domain = -1) : TimingEvent(preDelay, 0, domain), zllStartCycle(_zllStartCycle) {setType(EVT_OOO_DISPATCH);}
 
         void simulate(uint64_t startCycle) {
             TRACE_MSG("Dispatch %ld zllStartCycle %ld startCycle %ld minStartCycle %ld", id, zllStartCycle, startCycle, getMinStartCycle());
@@ -83,7 +83,7 @@ class OOORespEvent : public TimingEvent {
         uint64_t id;
 
     public:
-        OOORespEvent(uint64_t preDelay, OOOCoreRecorder* _cRec, int32_t domain = -1) : TimingEvent(preDelay, 0, domain), cRec(_cRec) {}
+        OOORespEvent(uint64_t preDelay, OOOCoreRecorder* _cRec, int32_t domain = -1) : TimingEvent(preDelay, 0, domain), cRec(_cRec) {setType(EVT_OOO_RESP);}
 
         void simulate(uint64_t _startCycle) {
             TRACE_MSG("Resp %ld startCycle %ld minStartCycle %ld", id, startCycle, getMinStartCycle());
@@ -120,6 +120,16 @@ OOOCoreRecorder::OOOCoreRecorder(uint32_t _domain, g_string& _name)
 
 
 uint64_t OOOCoreRecorder::notifyJoin(uint64_t curCycle) {
+    if (unlikely(zinfo->analyticalContention)) {
+        //No events or weave phase, so we only keep cycle accounting; there is no DRAINING state
+        assert(state == HALTED);
+        curCycle = MAX(curCycle, zinfo->globPhaseCycles);
+        assert(lastUnhaltedCycle <= curCycle);
+        totalHaltedCycles += curCycle - lastUnhaltedCycle;
+        state = RUNNING;
+        return curCycle;
+    }
+
     if (state == HALTED) {
         assert(!lastEvProduced);
         curCycle = zinfo->globPhaseCycles; //start at beginning of the phase
@@ -191,6 +201,11 @@ void OOOCoreRecorder::addIssueEvent(uint64_t evCycle) {
 
 void OOOCoreRecorder::notifyLeave(uint64_t curCycle) {
     assert_msg(state == RUNNING, "invalid state = %d on leave", state);
+    if (unlikely(zinfo->analyticalContention)) {
+        lastUnhaltedCycle = curCycle;
+        state = HALTED;
+        return;
+    }
     state = DRAINING;
     assert(lastEvProduced);
     // Cover delay to curCycle
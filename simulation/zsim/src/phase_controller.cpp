@@ -0,0 +1,123 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "phase_controller.h"
+#include <string.h>
+#include "bithacks.h"
+#include "contention_sim.h"
+#include "log.h"
+#include "rdtsc.h"
+#include "scheduler.h"
+#include "zsim.h"
+
+PhaseLengthController::PhaseLengthController(uint32_t _minLength, uint32_t _maxLength, uint32_t _interval, double _maxViolRate,
+        double _maxStallRate, double _maxLeaveRate, double _maxWaitFrac, const char* _logFile)
+    : minLength(_minLength), maxLength(_maxLength), interval(_interval), maxViolRate(_maxViolRate), maxStallRate(_maxStallRate),
+      maxLeaveRate(_maxLeaveRate), maxWaitFrac(_maxWaitFrac), phasesLeft(1 /*take a baseline after the first phase*/)
+{
+    memset(&last, 0, sizeof(Sample));
+    curLength = zinfo->phaseLength;
+    logFile = fopen(_logFile, "w");
+    if (!logFile) panic("Could not open %s for writing", _logFile);
+    fprintf(logFile, "phase,cycle,length,nextLength,violRate,xingStallRate,leaveRate,barrierWait\n");
+    info("Adaptive phase length: %d cycles initially, within [%d, %d], adapting every %d phases, logging to %s",
+            zinfo->phaseLength, minLength, maxLength, interval, _logFile);
+}
+
+void PhaseLengthController::initStats(AggregateStat* parentStat) {
+    AggregateStat* plStat = new AggregateStat();
+    plStat->init("phaseLen", "Adaptive phase length stats");
+    ProxyStat* lengthStat = new ProxyStat();
+    lengthStat->init("length", "Current phase length", &curLength);
+    plStat->append(lengthStat);
+    profShrinks.init("shrinks", "Times the phase length was shortened");
+    profGrows.init("grows", "Times the phase length was lengthened");
+    plStat->append(&profShrinks);
+    plStat->append(&profGrows);
+    parentStat->append(plStat);
+}
+
+void PhaseLengthController::sample(Sample& s) const {
+    s.violations = 0;
+    s.accesses = 0;
+    for (ViolationSource* src : violSources) {
+        s.violations += src->getViolations();
+        s.accesses += src->getAccesses();
+    }
+    s.xingRuns = zinfo->contentionSim->getCrossingRuns();
+    s.xingStalls = zinfo->contentionSim->getCrossingStalls();
+    if (zinfo->sched) { //nullptr on trace-driven runs
+        const Barrier& bar = zinfo->sched->getBarrier();
+        s.syncs = bar.getSyncs();
+        s.leaves = bar.getLeaves();
+        s.waitCycles = bar.getWaitCycles();
+    } else {
+        s.syncs = s.leaves = s.waitCycles = 0;
+    }
+    s.hostCycles = rdtsc();
+}
+
+void PhaseLengthController::endOfPhase() {
+    if (--phasesLeft) return;
+    phasesLeft = interval;
+
+    Sample cur;
+    sample(cur);
+    if (!last.hostCycles) { //first call, just a baseline (skips initialization time)
+        last = cur;
+        return;
+    }
+
+    uint64_t accesses = cur.accesses - last.accesses;
+    uint64_t xingRuns = cur.xingRuns - last.xingRuns;
+    uint64_t syncs = cur.syncs - last.syncs;
+    uint64_t hostCycles = cur.hostCycles - last.hostCycles;
+    double violRate = accesses? ((double)(cur.violations - last.violations))/accesses : 0.0;
+    //Crossings that ran out of slack, see the class comment
+    double stallRate = xingRuns? ((double)(cur.xingStalls - last.xingStalls))/xingRuns : 0.0;
+    double leaveRate = syncs? ((double)(cur.leaves - last.leaves))/syncs : 0.0;
+    //Average wait per sync over the average host time per phase
+    double waitFrac = (syncs && hostCycles)? (((double)(cur.waitCycles - last.waitCycles))/syncs)/(((double)hostCycles)/interval) : 0.0;
+    last = cur;
+
+    uint32_t len = zinfo->phaseLength;
+    uint32_t newLen = len;
+    bool unstable = violRate > maxViolRate || stallRate > maxStallRate || leaveRate > maxLeaveRate;
+    if (unstable) {
+        if (waitFrac < maxWaitFrac) newLen = MAX(len/2, minLength);
+    } else {
+        newLen = MIN((uint64_t)len + MAX(len/4, (uint32_t)1), (uint64_t)maxLength);
+    }
+
+    if (newLen < len) profShrinks.inc();
+    else if (newLen > len) profGrows.inc();
+
+    fprintf(logFile, "%ld,%ld,%d,%d,%.6f,%.4f,%.4f,%.4f\n", zinfo->numPhases + 1, zinfo->globPhaseCycles + len, len, newLen,
+            violRate, stallRate, leaveRate, waitFrac);
+    fflush(logFile);
+
+    zinfo->nextPhaseLength = newLen;
+    curLength = newLen;
+}
@@ -0,0 +1,109 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PHASE_CONTROLLER_H_
+#define PHASE_CONTROLLER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "stats.h"
+
+/* Components that count bound-weave ordering violations (e.g., ProfViolReplPolicy)
+ * implement this so the phase length controller can sample them.
+ */
+class ViolationSource {
+    public:
+        virtual uint64_t getViolations() const = 0;  // accesses seen out of order across cores
+        virtual uint64_t getAccesses() const = 0;
+};
+
+/* Adapts the bound phase length (sim.adaptivePhaseLength) to the skew it
+ * causes. Every interval of phases, it samples:
+ *  - violations per access, from the registered ViolationSources (shared
+ *    caches with LRUProfViol replacement),
+ *  - crossing stalls per crossing run, i.e., how often domains wait on each
+ *    other during the weave phase. This stands in for CrossingEvent slack: a
+ *    crossing stalls exactly when its slack (the pre/post delays around it
+ *    plus the source core's start slack) does not cover the skew between its
+ *    domains. Unlike the weave profiler's xingSlack, which sums only the
+ *    static delays and needs sim.profileWeave, it is always counted,
+ *  - barrier leaves per sync, a proxy for synchronization-heavy regions
+ *    (threads blocking on syscalls/futexes), and
+ *  - the fraction of host time threads spend waiting on the barrier.
+ * If the first three are under their thresholds, the phase is lengthened by
+ * 25%, which cuts barrier and weave overheads. If any is over, it is halved
+ * to bound skew, unless threads already spend most of their time on the
+ * barrier, where shorter phases would only add overhead. Lengths stay within
+ * [sim.minPhaseLength, sim.maxPhaseLength], and every decision is appended
+ * to a CSV file.
+ *
+ * Runs at the end of each phase, serialized with all other end-of-phase
+ * actions. The new length takes effect on the next phase (see
+ * zinfo->nextPhaseLength).
+ */
+class PhaseLengthController : public GlobAlloc {
+    private:
+        struct Sample {
+            uint64_t violations;
+            uint64_t accesses;
+            uint64_t xingRuns;
+            uint64_t xingStalls;
+            uint64_t syncs;
+            uint64_t leaves;
+            uint64_t waitCycles;
+            uint64_t hostCycles;
+        };
+
+        const uint32_t minLength, maxLength;
+        const uint32_t interval;  // in phases
+        const double maxViolRate, maxStallRate, maxLeaveRate, maxWaitFrac;
+
+        g_vector<ViolationSource*> violSources;
+        Sample last;
+        uint32_t phasesLeft;
+
+        FILE* logFile;
+
+        uint64_t curLength;  // for the stat
+        Counter profShrinks, profGrows;
+
+    public:
+        PhaseLengthController(uint32_t _minLength, uint32_t _maxLength, uint32_t _interval, double _maxViolRate,
+                double _maxStallRate, double _maxLeaveRate, double _maxWaitFrac, const char* _logFile);
+
+        void addViolationSource(ViolationSource* src) {violSources.push_back(src);}
+
+        void initStats(AggregateStat* parentStat);
+
+        // Called at the end of every phase
+        void endOfPhase();
+
+    private:
+        void sample(Sample& s) const;
+};
+
+#endif  // PHASE_CONTROLLER_H_
@@ -0,0 +1,266 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Benchmarks ContentionSim's event queue (PrioQueue) against the previous
+ * implementation (fixed blocks plus a multimap for far events) by replaying
+ * event queue operation streams. Streams are recorded by building zsim with
+ * RECORD_PQ_TRACE = 1 (contention_sim.h), which writes one pqtrace-<domain>.bin
+ * file per domain; without arguments, pqbench replays synthetic streams with a
+ * mix of short, DRAM-like and far (refresh-like) delays. Replays check that both
+ * queues dequeue events at the recorded cycles.
+ */
+
+#include <queue>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "g_std/g_multimap.h"
+#include "galloc.h"
+#include "log.h"
+#include "prio_queue.h"
+
+using namespace std;
+
+#define PQ_BLOCKS 1024  // same as ContentionSim
+#define REPS 5  // replays per queue, alternating; we report the fastest of each to filter out host noise
+
+struct BenchEvent {
+    BenchEvent* next;
+    uint64_t privCycle;
+};
+
+// The previous PrioQueue, kept as a baseline
+template <typename T, uint32_t B>
+class LegacyPrioQueue {
+    struct PQBlock {
+        T* array[64];
+        uint64_t occ;
+
+        PQBlock() {
+            for (uint32_t i = 0; i < 64; i++) array[i] = nullptr;
+            occ = 0;
+        }
+
+        inline T* dequeue(uint32_t& offset) {
+            assert(occ);
+            uint32_t pos = __builtin_ctzl(occ);
+            T* res = array[pos];
+            T* next = res->next;
+            array[pos] = next;
+            if (!next) occ ^= 1L << pos;
+            assert(res);
+            offset = pos;
+            res->next = nullptr;
+            return res;
+        }
+
+        inline void enqueue(T* obj, uint32_t pos) {
+            occ |= 1L << pos;
+            assert(!obj->next);
+            obj->next = array[pos];
+            array[pos] = obj;
+        }
+    };
+
+    PQBlock blocks[B];
+
+    typedef g_multimap<uint64_t, T*> FEMap;
+    typedef typename FEMap::iterator FEMapIterator;
+
+    FEMap feMap;
+
+    uint64_t curBlock;
+    uint64_t elems;
+
+    public:
+        LegacyPrioQueue() : curBlock(0), elems(0) {}
+
+        void enqueue(T* obj, uint64_t cycle) {
+            uint64_t absBlock = cycle/64;
+            assert(absBlock >= curBlock);
+            if (absBlock < curBlock + B) {
+                blocks[absBlock % B].enqueue(obj, cycle % 64);
+            } else {
+                feMap.insert(std::pair<uint64_t, T*>(cycle, obj));
+            }
+            elems++;
+        }
+
+        T* dequeue(uint64_t& deqCycle) {
+            assert(elems);
+            while (!blocks[curBlock % B].occ) {
+                curBlock++;
+                if ((curBlock % (B/2)) == 0 && !feMap.empty()) {
+                    uint64_t topCycle = (curBlock + B)*64;
+                    FEMapIterator it = feMap.begin();
+                    while (it != feMap.end() && it->first < topCycle) {
+                        uint64_t cycle = it->first;
+                        blocks[(cycle/64) % B].enqueue(it->second, cycle % 64);
+                        it++;
+                    }
+                    feMap.erase(feMap.begin(), it);
+                }
+            }
+            uint32_t offset;
+            T* obj = blocks[curBlock % B].dequeue(offset);
+            elems--;
+            deqCycle = curBlock*64 + offset;
+            return obj;
+        }
+
+        inline uint64_t size() const {
+            return elems;
+        }
+
+        inline uint64_t firstCycle() const {
+            assert(elems);
+            for (uint32_t i = 0; i < B/2; i++) {
+                uint64_t occ = blocks[(curBlock + i) % B].occ;
+                if (occ) return (curBlock + i)*64 + __builtin_ctzl(occ);
+            }
+            for (uint32_t i = B/2; i < B; i++) {
+                uint64_t occ = blocks[(curBlock + i) % B].occ;
+                if (occ) {
+                    uint64_t cycle = (curBlock + i)*64 + __builtin_ctzl(occ);
+                    return feMap.empty()? cycle : MIN(cycle, feMap.begin()->first);
+                }
+            }
+            return feMap.begin()->first;
+        }
+};
+
+static vector<uint64_t> loadStream(const char* fname) {
+    FILE* f = fopen(fname, "r");
+    if (!f) panic("Could not open %s", fname);
+    vector<uint64_t> ops;
+    uint64_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, sizeof(uint64_t), 4096, f)) > 0) ops.insert(ops.end(), buf, buf + n);
+    fclose(f);
+    return ops;
+}
+
+// Synthetic domain: keeps ~occupancy events queued; farFrac of the enqueues are refresh-like or farther
+static vector<uint64_t> syntheticStream(uint64_t numOps, uint32_t occupancy, double farFrac) {
+    vector<uint64_t> ops;
+    priority_queue<uint64_t, vector<uint64_t>, greater<uint64_t>> ref;
+    srand48(42);
+    uint64_t cur = 0;
+    while (ops.size() < numOps) {
+        if (ref.size() < occupancy || drand48() < 0.5) {
+            double r = drand48();
+            uint64_t delay;
+            if (r < 0.70) delay = 1 + lrand48() % 100;  // cache and network latencies
+            else if (r < 1.0 - farFrac) delay = 100 + lrand48() % 2000;  // DRAM accesses
+            else if (r < 1.0 - farFrac/5) delay = 10000 + lrand48() % 60000;  // refreshes, beyond the near blocks
+            else delay = 100000 + lrand48() % 5000000;  // very far
+            uint64_t cycle = cur + delay;
+            ref.push(cycle);
+            ops.push_back(cycle << 1);
+        } else {
+            cur = ref.top();
+            ref.pop();
+            ops.push_back((cur << 1) | 1);
+        }
+    }
+    return ops;
+}
+
+static uint64_t getNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000L*ts.tv_sec + ts.tv_nsec;
+}
+
+template <typename Q>
+static double replay(const vector<uint64_t>& ops, const char* qName, const char* streamName, bool print) {
+    Q* pq = new Q();
+    vector<BenchEvent> pool(ops.size());
+    uint64_t nextEv = 0;
+    uint64_t sum = 0;
+    uint64_t start = getNs();
+    for (uint64_t op : ops) {
+        uint64_t cycle = op >> 1;
+        if (op & 1) {
+            // Like ContentionSim::simulateDomain, which peeks at the next cycle after every event
+            uint64_t deqCycle;
+            pq->dequeue(deqCycle);
+            if (deqCycle != cycle) panic("%s on %s: dequeued cycle %ld, expected %ld", qName, streamName, deqCycle, cycle);
+            if (pq->size()) sum += pq->firstCycle();
+        } else {
+            BenchEvent* ev = &pool[nextEv++];
+            ev->next = nullptr;
+            pq->enqueue(ev, cycle);
+        }
+    }
+    uint64_t ns = getNs() - start;
+    delete pq;
+    double nsPerOp = ((double)ns)/ops.size();
+    if (print) info("  %-8s %8.2f ns/op (%ld ops, %ld left queued, checksum %lx)", qName, nsPerOp, ops.size(), nextEv - (ops.size() - nextEv), sum);
+    return nsPerOp;
+}
+
+static void bench(const vector<uint64_t>& ops, const char* streamName) {
+    uint64_t far = 0;
+    uint64_t enqs = 0;
+    uint64_t cur = 0;
+    for (uint64_t op : ops) {
+        if (op & 1) {
+            cur = op >> 1;
+        } else {
+            enqs++;
+            if ((op >> 1) >= cur + PQ_BLOCKS*64/2) far++;
+        }
+    }
+    info("%s: %ld ops, %ld enqueues, %.2f%% beyond %d cycles", streamName, ops.size(), enqs, enqs? far*100.0/enqs : 0.0, PQ_BLOCKS*64/2);
+    double legacy = 1e30, wheel = 1e30;
+    for (uint32_t r = 0; r < REPS; r++) {
+        double l = replay<LegacyPrioQueue<BenchEvent, PQ_BLOCKS>>(ops, "legacy", streamName, r == 0);
+        double w = replay<PrioQueue<BenchEvent, PQ_BLOCKS>>(ops, "wheel", streamName, r == 0);
+        legacy = MIN(legacy, l);
+        wheel = MIN(wheel, w);
+    }
+    info("  best of %d: legacy %.2f ns/op, wheel %.2f ns/op, speedup %.2fx", REPS, legacy, wheel, legacy/wheel);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        info("Replays event queue operation streams against the current and legacy PrioQueue");
+        info("Usage: %s [pqtrace-<domain>.bin ...]  (no arguments: synthetic stream)", argv[0]);
+        exit(1);
+    }
+    gm_init(256<<20 /*256 MB, for the legacy queue's far element map*/);
+
+    if (argc == 1) {
+        bench(syntheticStream(20*1000*1000, 256, 0.05), "synthetic (5% far)");
+        bench(syntheticStream(20*1000*1000, 256, 0.25), "synthetic (25% far)");
+    } else {
+        for (int i = 1; i < argc; i++) bench(loadStream(argv[i]), argv[i]);
+    }
+    return 0;
+}
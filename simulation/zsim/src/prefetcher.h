@@ -111,6 +111,10 @@ class StreamPrefetcher : public BaseCache {
 
         uint64_t access(MemReq& req);
         uint64_t invalidate(const InvReq& req);
+
+        //Holds no lines, and stream training state rewarms quickly, so it is not checkpointed
+        void saveState(CheckpointWriter& cw) {}
+        void loadState(CheckpointReader& cr) {}
 };
 
 #endif  // PREFETCHER_H_
@@ -26,10 +26,31 @@
 #ifndef PRIO_QUEUE_H_
 #define PRIO_QUEUE_H_
 
-#include "g_std/g_multimap.h"
+#include <stdint.h>
+#include "bithacks.h"
+#include "log.h"
 
+/* Hierarchical timing wheel of intrusive (T::next-linked) elements.
+ *
+ * Level 0 is a circular window of B 64-cycle blocks that starts at curBlock,
+ * like the original PrioQueue, so elements less than B blocks ahead are
+ * inserted directly even if they fall in the next span (aligned group of B
+ * blocks); they use the slots the current span has already drained. One bit
+ * per block in blockOcc lets dequeue() skip empty blocks with a few ctz ops.
+ * Level 1 has L1_SLOTS slots, one per future span, each an unsorted list; a
+ * slot is moved to level 0 when its span becomes current. Elements beyond
+ * level 1's horizon (L1_SLOTS spans, ~4M cycles with B = 1024) go to an
+ * unsorted overflow list, and move to level 1 when the horizon reaches them.
+ * Elements are moved at most twice, so enqueue() and dequeue() are O(1)
+ * amortized, and firstCycle() is O(B/64). The common case, dequeuing from the
+ * current block, does not touch the bitmap.
+ *
+ * Far elements store their cycle in T::privCycle while they wait.
+ */
 template <typename T, uint32_t B>
 class PrioQueue {
+    static_assert(B >= 64 && (B % 64) == 0, "PrioQueue needs a multiple of 64 blocks");
+
     struct PQBlock {
         T* array[64];
         uint64_t occ; // bit i is 1 if array[i] is populated
@@ -60,64 +81,61 @@ class PrioQueue {
         }
     };
 
-    PQBlock blocks[B];
+    struct FarList {
+        T* head;
+        uint64_t minCycle; //only valid if head != nullptr
+
+        FarList() : head(nullptr), minCycle(0) {}
+
+        inline void push(T* obj, uint64_t cycle) {
+            assert(!obj->next);
+            obj->privCycle = cycle;
+            minCycle = head? MIN(minCycle, cycle) : cycle;
+            obj->next = head;
+            head = obj;
+        }
+    };
+
+    static const uint32_t L1_SLOTS = 64; //one bit per slot in l1Occ
+    static const uint64_t SPAN = 64*B; //cycles per span
 
-    typedef g_multimap<uint64_t, T*> FEMap; //far element map
-    typedef typename FEMap::iterator FEMapIterator;
+    PQBlock blocks[B]; //blocks[i] holds absolute block curSpan*B + i if i >= curBlock % B, else (curSpan+1)*B + i
+    uint64_t blockOcc[B/64]; //bit i set if blocks[i] is populated
 
-    FEMap feMap;
+    FarList l1[L1_SLOTS]; //span s lives in l1[s % L1_SLOTS], for curSpan < s <= curSpan + L1_SLOTS
+    uint64_t l1Occ;
+    FarList overflow; //spans beyond curSpan + L1_SLOTS
 
     uint64_t curBlock;
+    uint64_t curSpan;
     uint64_t elems;
 
     public:
         PrioQueue() {
+            for (uint32_t i = 0; i < B/64; i++) blockOcc[i] = 0;
+            l1Occ = 0;
             curBlock = 0;
+            curSpan = 0;
             elems = 0;
         }
 
-        void enqueue(T* obj, uint64_t cycle) {
+        //The common cases (near elements, dequeuing from the current block) are inlined; everything else is out
+        //of line, which keeps these small enough to inline into ContentionSim even with asserts enabled
+        inline void enqueue(T* obj, uint64_t cycle) {
             uint64_t absBlock = cycle/64;
             assert(absBlock >= curBlock);
-
-            if (absBlock < curBlock + B) {
-                uint32_t i = absBlock % B;
-                uint32_t offset = cycle % 64;
-                blocks[i].enqueue(obj, offset);
-            } else {
-                //info("XXX far enq() %ld", cycle);
-                feMap.insert(std::pair<uint64_t, T*>(cycle, obj));
-            }
+            if (likely(absBlock < curBlock + B)) placeNear(obj, absBlock, cycle % 64);
+            else placeFar(obj, cycle);
             elems++;
         }
 
-        T* dequeue(uint64_t& deqCycle) {
+        inline T* dequeue(uint64_t& deqCycle) {
             assert(elems);
-            while (!blocks[curBlock % B].occ) {
-                curBlock++;
-                if ((curBlock % (B/2)) == 0 && !feMap.empty()) {
-                    uint64_t topCycle = (curBlock + B)*64;
-                    //Move every element with cycle < topCycle to blocks[]
-                    FEMapIterator it = feMap.begin();
-                    while (it != feMap.end() && it->first < topCycle) {
-                        uint64_t cycle = it->first;
-                        T* obj = it->second;
-
-                        uint64_t absBlock = cycle/64;
-                        assert(absBlock >= curBlock);
-                        assert(absBlock < curBlock + B);
-                        uint32_t i = absBlock % B;
-                        uint32_t offset = cycle % 64;
-                        blocks[i].enqueue(obj, offset);
-                        it++;
-                    }
-                    feMap.erase(feMap.begin(), it);
-                }
-            }
-
-            //We're now at the first populated block
+            uint32_t i = curBlock % B;
+            if (unlikely(!blocks[i].occ)) i = seek();
             uint32_t offset;
-            T* obj = blocks[curBlock % B].dequeue(offset);
+            T* obj = blocks[i].dequeue(offset);
+            if (!blocks[i].occ) blockOcc[i/64] &= ~(1ul << (i % 64));
             elems--;
 
             deqCycle = curBlock*64 + offset;
@@ -130,25 +148,125 @@ class PrioQueue {
 
         inline uint64_t firstCycle() const {
             assert(elems);
-            for (uint32_t i = 0; i < B/2; i++) {
-                uint64_t occ = blocks[(curBlock + i) % B].occ;
-                if (occ) {
-                    uint64_t pos = __builtin_ctzl(occ);
-                    return (curBlock + i)*64 + pos;
-                }
+            uint32_t i = curBlock % B;
+            if (likely(blocks[i].occ)) return curBlock*64 + __builtin_ctzl(blocks[i].occ);
+            return firstCycleSlow();
+        }
+
+    private:
+        inline void placeNear(T* obj, uint64_t absBlock, uint32_t offset) {
+            uint32_t i = absBlock % B;
+            blocks[i].enqueue(obj, offset);
+            blockOcc[i/64] |= 1ul << (i % 64);
+        }
+
+        __attribute__((noinline)) void placeFar(T* obj, uint64_t cycle) {
+            uint64_t span = cycle/SPAN;
+            assert(span > curSpan);
+            if (span <= curSpan + L1_SLOTS) {
+                uint32_t s = span % L1_SLOTS;
+                l1[s].push(obj, cycle);
+                l1Occ |= 1ul << s;
+            } else {
+                overflow.push(obj, cycle);
             }
-            for (uint32_t i = B/2; i < B; i++) { //beyond B/2 blocks, there may be a far element that comes earlier
-                uint64_t occ = blocks[(curBlock + i) % B].occ;
-                if (occ) {
-                    uint64_t pos = __builtin_ctzl(occ);
-                    uint64_t cycle = (curBlock + i)*64 + pos;
-                    return feMap.empty()? cycle : MIN(cycle, feMap.begin()->first);
-                }
+        }
+
+        inline void place(T* obj, uint64_t cycle) {
+            uint64_t absBlock = cycle/64;
+            assert(absBlock >= curBlock);
+            if (absBlock < curBlock + B) placeNear(obj, absBlock, cycle % 64);
+            else placeFar(obj, cycle);
+        }
+
+        //The current block is empty: moves curBlock to the first populated block, advancing spans if needed
+        __attribute__((noinline)) uint32_t seek() {
+            uint32_t i = firstBlock(curBlock % B);
+            if (i == B) { //the current span is drained
+                advanceSpan(firstBlock(0) < B);
+                i = firstBlock(0);
+                assert(i < B);
+            }
+            curBlock = curSpan*B + i;
+            return i;
+        }
+
+        __attribute__((noinline)) uint64_t firstCycleSlow() const {
+            uint32_t i = firstBlock(curBlock % B);
+            uint32_t j = (i == B)? firstBlock(0) : B;
+            if (i < B) {
+                return (curSpan*B + i)*64 + __builtin_ctzl(blocks[i].occ);
+            } else if (j < B) {
+                //Only elements of the next span are left in level 0, but level 1 may have earlier ones of that span
+                uint64_t cycle = ((curSpan + 1)*B + j)*64 + __builtin_ctzl(blocks[j].occ);
+                uint32_t s = (curSpan + 1) % L1_SLOTS;
+                return (l1Occ & (1ul << s))? MIN(cycle, l1[s].minCycle) : cycle;
+            } else if (l1Occ) {
+                return l1[nextL1Slot()].minCycle;
+            } else {
+                return overflow.minCycle;
             }
+        }
+
+        //First populated block at or after start, without wrapping around; B if there is none
+        inline uint32_t firstBlock(uint32_t start) const {
+            uint32_t w = start/64;
+            uint64_t word = blockOcc[w] & (~0ul << (start % 64));
+            while (!word) {
+                if (++w == B/64) return B;
+                word = blockOcc[w];
+            }
+            return w*64 + __builtin_ctzl(word);
+        }
 
-            return feMap.begin()->first;
+        //Slot of the earliest populated level-1 span (l1Occ must be non-zero)
+        inline uint32_t nextL1Slot() const {
+            uint32_t s = (curSpan + 1) % L1_SLOTS;
+            uint64_t rot = s? ((l1Occ >> s) | (l1Occ << (64 - s))) : l1Occ;
+            return (s + __builtin_ctzl(rot)) % L1_SLOTS;
+        }
+
+        //Moves every element in list to its current level
+        inline void replace(T* obj) {
+            while (obj) {
+                T* next = obj->next;
+                obj->next = nullptr;
+                place(obj, obj->privCycle);
+                obj = next;
+            }
+        }
+
+        //The current span is drained; make the next populated span current
+        void advanceSpan(bool nextSpanInL0) {
+            assert(elems);
+            if (nextSpanInL0) {
+                curSpan++;
+            } else if (l1Occ) {
+                uint32_t s = nextL1Slot();
+                curSpan += 1 + (s + L1_SLOTS - (curSpan + 1) % L1_SLOTS) % L1_SLOTS;
+            } else {
+                assert(overflow.head);
+                curSpan = overflow.minCycle/SPAN;
+            }
+            curBlock = curSpan*B;
+
+            //Overflow elements that are now within level 1's horizon must move before anything else is dequeued
+            if (overflow.head && overflow.minCycle/SPAN <= curSpan + L1_SLOTS) {
+                T* obj = overflow.head;
+                overflow.head = nullptr;
+                replace(obj);
+            }
+
+            //Cascade the current span's slot into level 0
+            uint32_t s = curSpan % L1_SLOTS;
+            if (l1Occ & (1ul << s)) {
+                T* obj = l1[s].head;
+                l1[s].head = nullptr;
+                l1Occ &= ~(1ul << s);
+                replace(obj);
+            }
+            assert(firstBlock(0) < B);
         }
 };
 
 #endif  // PRIO_QUEUE_H_
-
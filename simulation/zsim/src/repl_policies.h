@@ -29,9 +29,11 @@
 #include <functional>
 #include "bithacks.h"
 #include "cache_arrays.h"
+#include "checkpoint.h"
 #include "coherence_ctrls.h"
 #include "memory_hierarchy.h"
 #include "mtrand.h"
+#include "phase_controller.h"
 
 /* Generic replacement policy interface. A replacement policy is initialized by the cache (by calling setTop/BottomCC) and used by the cache array. Usage follows two models:
  * - On lookups, update() is called if the replacement policy is to be updated on a hit
@@ -54,6 +56,10 @@ class ReplPolicy : public GlobAlloc {
         virtual uint32_t rankCands(const MemReq* req, ZCands cands) = 0;
 
         virtual void initStats(AggregateStat* parent) {}
+
+        //Warm-up checkpoints (see checkpoint.h). Only per-candidate scratch state may be left out
+        virtual void saveState(CheckpointWriter& cw) {panic("This replacement policy does not support checkpoints");}
+        virtual void loadState(CheckpointReader& cr) {panic("This replacement policy does not support checkpoints");}
 };
 
 /* Add DECL_RANK_BINDINGS to each class that implements the new interface,
@@ -131,6 +137,16 @@ class LRUReplPolicy : public ReplPolicy {
 
         DECL_RANK_BINDINGS;
 
+        void saveState(CheckpointWriter& cw) {
+            cw.write(timestamp);
+            cw.writeArray(array, numLines);
+        }
+
+        void loadState(CheckpointReader& cr) {
+            cr.read(timestamp);
+            cr.readArray(array, numLines);
+        }
+
     private:
         inline uint64_t score(uint32_t id) { //higher is least evictable
             //array[id] < timestamp always, so this prioritizes by:
@@ -249,6 +265,16 @@ class NRUReplPolicy : public LegacyReplPolicy {
             candIdx = 0;
             array[id] = 0;
         }
+
+        void saveState(CheckpointWriter& cw) {
+            cw.write(youngLines);
+            cw.writeArray(array, numLines);
+        }
+
+        void loadState(CheckpointReader& cr) {
+            cr.read(youngLines);
+            cr.readArray(array, numLines);
+        }
 };
 
 class RandReplPolicy : public LegacyReplPolicy {
@@ -286,6 +312,10 @@ class RandReplPolicy : public LegacyReplPolicy {
         void replaced(uint32_t id) {
             candIdx = 0;
         }
+
+        //Stateless, except for the RNG (not worth checkpointing)
+        void saveState(CheckpointWriter& cw) {}
+        void loadState(CheckpointReader& cr) {}
 };
 
 class LFUReplPolicy : public LegacyReplPolicy {
@@ -370,11 +400,21 @@ class LFUReplPolicy : public LegacyReplPolicy {
             bestRank.reset();
             array[id].acc = 0;
         }
+
+        void saveState(CheckpointWriter& cw) {
+            cw.write(timestamp);
+            cw.writeArray(array, numLines);
+        }
+
+        void loadState(CheckpointReader& cr) {
+            cr.read(timestamp);
+            cr.readArray(array, numLines);
+        }
 };
 
 //Extends a given replacement policy to profile access ordering violations
 template <class T>
-class ProfViolReplPolicy : public T {
+class ProfViolReplPolicy : public T, public ViolationSource {
     private:
         struct AccTimes {
             uint64_t read;
@@ -418,6 +458,14 @@ class ProfViolReplPolicy : public T {
             parentStat->append(&profNoViolEv);
         }
 
+        uint64_t getViolations() const {
+            return profRAW.get() + profWAR.get() + profRAR.get() + profWAW.get() + profAAE.get();
+        }
+
+        uint64_t getAccesses() const {
+            return profRAW.get() + profWAR.get() + profRAR.get() + profWAW.get() + profNoViolAcc.get();
+        }
+
         void update(uint32_t id, const MemReq* req) {
             T::update(id, req);
 
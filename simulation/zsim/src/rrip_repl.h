@@ -66,5 +66,15 @@ class SRRIPReplPolicy : public ReplPolicy {
 
         // DECL_RANK_BINDINGS;
         DECL_RANK_BINDINGS;
+
+        void saveState(CheckpointWriter& cw) {
+            cw.writeArray(array, numLines);
+            cw.writeArray(isNew, numLines);
+        }
+
+        void loadState(CheckpointReader& cr) {
+            cr.readArray(array, numLines);
+            cr.readArray(isNew, numLines);
+        }
 };
 #endif // RRIP_REPL_H_
@@ -88,6 +88,20 @@ class RT_RRIPReplPolicy : public ReplPolicy {
             }
             DECL_RANK_BINDINGS;
 
+            void saveState(CheckpointWriter& cw) {
+                cw.write(recencyTime);
+                cw.writeArray(rrpvArray, numLines);
+                cw.writeArray(recencyTimeArray, numLines);
+                cw.writeArray(isNewBlock, numLines);
+            }
+
+            void loadState(CheckpointReader& cr) {
+                cr.read(recencyTime);
+                cr.readArray(rrpvArray, numLines);
+                cr.readArray(recencyTimeArray, numLines);
+                cr.readArray(isNewBlock, numLines);
+            }
+
         private:
             // gets average of all recenency times
             template <typename C> inline uint32_t getThreshold(C cands) {
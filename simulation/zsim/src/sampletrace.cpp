@@ -0,0 +1,153 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Extracts a smaller trace from a (sorted) access trace. Modes:
+ *  - cycles <start> <end>: records with start <= reqCycle < end
+ *  - records <start> <end>: records start..end-1
+ *  - sets <sets> <ratio> [offset]: set sampling. Keeps records whose set
+ *    (lineAddr % sets) is offset modulo ratio, and renames lines so that a
+ *    cache with sets/ratio sets sees exactly the sampled sets. This assumes
+ *    modulo set indexing, so it only holds for unhashed, single-bank caches;
+ *    the trace records sets/ratio, and replays reject other parent caches.
+ *  - periodic <period> <window> [offset]: keeps the first window cycles of
+ *    every period cycles, starting at offset.
+ * Time-based modes rebase cycles so the output starts at cycle 0 (periodic
+ * sampling also squeezes out the skipped cycles). Sampling modes record a
+ * sample scale (ratio or period/window) in the output, which the trace driver
+ * uses to extrapolate its stats (cache stats are not extrapolated).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "access_tracing.h"
+#include "galloc.h"
+#include "log.h"
+
+using namespace std;
+
+static void usage(const char* prog) {
+    info("Extracts windows or samples from an access trace");
+    info("Usage: %s <input_trace> <output_trace> <mode> <args>", prog);
+    info("  cycles <start> <end>               records in [start, end) cycles");
+    info("  records <start> <end>              records [start, end)");
+    info("  sets <sets> <ratio> [offset]       1 of every ratio sets (sets = lineAddr %% sets; unhashed, unbanked caches only)");
+    info("  periodic <period> <window> [offset] first window cycles of every period");
+    exit(1);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc < 6 || argc > 7) usage(argv[0]);
+
+    const char* mode = argv[3];
+    uint64_t arg0 = strtoul(argv[4], nullptr, 0);
+    uint64_t arg1 = strtoul(argv[5], nullptr, 0);
+    uint64_t arg2 = (argc > 6)? strtoul(argv[6], nullptr, 0) : 0;
+
+    enum {CYCLES, RECORDS, SETS, PERIODIC} m;
+    uint32_t scale = 1;
+    if (strcmp(mode, "cycles") == 0) {
+        m = CYCLES;
+        if (arg0 >= arg1) panic("Empty cycle window [%ld, %ld)", arg0, arg1);
+    } else if (strcmp(mode, "records") == 0) {
+        m = RECORDS;
+        if (arg0 >= arg1) panic("Empty record window [%ld, %ld)", arg0, arg1);
+    } else if (strcmp(mode, "sets") == 0) {
+        m = SETS;
+        if (!arg1 || !arg0 || arg0 % arg1) panic("Number of sets (%ld) must be a multiple of the sampling ratio (%ld)", arg0, arg1);
+        if (arg2 >= arg1) panic("Offset (%ld) must be smaller than the sampling ratio (%ld)", arg2, arg1);
+        scale = arg1;
+    } else if (strcmp(mode, "periodic") == 0) {
+        m = PERIODIC;
+        if (!arg1 || !arg0 || arg0 % arg1) panic("Period (%ld) must be a multiple of the window (%ld)", arg0, arg1);
+        scale = arg0/arg1;
+    } else {
+        usage(argv[0]);
+    }
+
+    gm_init(32<<20 /*32 MB --- should be enough*/);
+
+    AccessTraceReader tr(argv[1]);
+    uint32_t numChildren = tr.getNumChildren();
+    scale *= tr.getSampleScale(); //sampling a sampled trace compounds the scales
+    uint32_t sampledSets = (m == SETS)? arg0/arg1 : tr.getSampledSets();
+    AccessTraceWriter* tw = new AccessTraceWriter(argv[2], numChildren, scale, sampledSets);
+
+    vector<uint64_t> childRecords(numChildren, 0);
+    uint64_t read = 0;
+    uint64_t written = 0;
+    uint64_t firstCycle = 0; //for record windows, rebase to the first kept record
+    while (!tr.empty()) {
+        AccessRecord acc = tr.read();
+        uint64_t idx = read++;
+        bool keep;
+        switch (m) {
+            case CYCLES:
+                if (acc.reqCycle >= arg1) goto done; //trace is sorted
+                keep = acc.reqCycle >= arg0;
+                acc.reqCycle -= arg0;
+                break;
+            case RECORDS:
+                if (idx >= arg1) goto done;
+                keep = idx >= arg0;
+                if (idx == arg0) firstCycle = acc.reqCycle;
+                acc.reqCycle -= firstCycle;
+                break;
+            case SETS:
+                {
+                    uint64_t set = acc.lineAddr % arg0;
+                    keep = (set % arg1) == arg2;
+                    acc.lineAddr = (acc.lineAddr / arg0) * (arg0 / arg1) + set / arg1;
+                }
+                break;
+            case PERIODIC:
+                if (acc.reqCycle < arg2) {
+                    keep = false;
+                } else {
+                    uint64_t cycle = acc.reqCycle - arg2;
+                    keep = (cycle % arg0) < arg1;
+                    acc.reqCycle = (cycle / arg0) * arg1 + (cycle % arg0);
+                }
+                break;
+        }
+        if (keep) {
+            tw->write(acc);
+            childRecords[acc.childId]++;
+            written++;
+        }
+        if ((read % (1024*1024)) == 0) {
+            printf("Read %3ld%%\r", read*100/tr.getNumRecords());
+            fflush(stdout);
+        }
+    }
+done:
+    tw->dump(false);
+
+    info("Wrote %ld of %ld records (%.2f%%), sample scale %d", written, tr.getNumRecords(), written*100.0/tr.getNumRecords(), scale);
+    for (uint32_t c = 0; c < numChildren; c++) info("  child %d: %ld records", c, childRecords[c]);
+    return 0;
+}
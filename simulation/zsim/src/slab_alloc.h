@@ -33,18 +33,32 @@
  * are garbage-collected once all their events are done. To do this without space
  * overheads, slabs are carefully aligned, so that objects inside the slab can
  * derive the pointer of their slab.
+ *
+ * Slabs are allocated by the recorder's (bound-phase) thread, but freed by
+ * whichever weave thread runs their last event. Freed slabs are pushed to a
+ * lock-free return stack, which the allocating thread drains in one atomic
+ * swap when its private free list runs out (single consumer, so there is no
+ * ABA problem). Optionally, new slabs are carved out of 2MB, huge-page-backed
+ * arenas, which reduces TLB misses when events from many slabs are live.
  */
 
 #include <deque>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/mman.h>
 #include "g_std/g_vector.h"
+#include "galloc.h"
 #include "log.h"
-#include "mutex.h"
+#include "pad.h"
+#include "rdtsc.h"
+#include "stats.h"
 
 #define SLAB_SIZE (1<<16)  // 64KB; must be a power of two
 #define SLAB_MASK (~(SLAB_SIZE - 1))
 
+#define SLAB_ARENA_SIZE (1<<21)  // 2MB, one huge page
+#define SLABS_PER_ARENA (SLAB_ARENA_SIZE/SLAB_SIZE)
+
 // Uncomment to immediately scrub slabs (to 0) and freed elems (to -1).
 // This makes use-after-free errors obvious.
 //#define DEBUG_SLAB_ALLOC
@@ -57,10 +71,14 @@ struct Slab {  // POD type (no constructor)
     SlabAlloc* allocator;
     volatile uint32_t liveElems;
     uint32_t usedBytes;
-    char buf[SLAB_SIZE - sizeof(SlabAlloc*) - sizeof(volatile uint32_t) - sizeof(uint32_t)];
+    Slab* nextFree;  // return stack link
+    uint64_t retireTsc;  // when the slab stopped being its allocator's current slab
+    char buf[SLAB_SIZE - sizeof(SlabAlloc*) - sizeof(volatile uint32_t) - sizeof(uint32_t) - sizeof(Slab*) - sizeof(uint64_t)];
 
     void init(SlabAlloc* _allocator) {
         allocator = _allocator;
+        nextFree = nullptr;
+        retireTsc = 0;
         clear();
     }
 
@@ -93,13 +111,31 @@ struct Slab {  // POD type (no constructor)
 
 class SlabAlloc {
     private:
+        // Owned by the allocating thread
         Slab* curSlab;
         g_vector<Slab*> freeList;
-        uint32_t liveSlabs;
-        mutex freeLock;  // used because slab frees may be concurrent
+        bool hugePages;
+        Slab* arenaNext;  // unused slabs in the current huge-page arena
+        uint32_t arenaLeft;
+
+        uint64_t newSlabs;
+        uint64_t reusedSlabs;
+        uint64_t drainedSlabs;
+
+        PAD();
+
+        // Written by freeing (weave) threads
+        Slab* volatile returnHead;
+        uint64_t returnedSlabs;
+        uint64_t recycleCycles;  // sum of retire-to-return latencies of returned slabs
+        uint64_t curSlabResets;
+
+        PAD();
 
     public:
-        SlabAlloc() : curSlab(nullptr), liveSlabs(0) {
+        SlabAlloc() : curSlab(nullptr), hugePages(false), arenaNext(nullptr), arenaLeft(0),
+            newSlabs(0), reusedSlabs(0), drainedSlabs(0), returnHead(nullptr), returnedSlabs(0), recycleCycles(0), curSlabResets(0)
+        {
             allocSlab();
         }
 
@@ -117,35 +153,102 @@ class SlabAlloc {
 
         template <typename T> T* alloc() { return (T*)alloc(sizeof(T)); }
 
+        // Applies to slabs allocated from now on
+        void setHugePages(bool enable) { hugePages = enable; }
+
+        void initStats(AggregateStat* parentStat) {
+            AggregateStat* slabStat = new AggregateStat();
+            slabStat->init("slabs", "Timing event slab allocator stats");
+            ProxyStat* newStat = new ProxyStat();
+            newStat->init("new", "Slabs allocated from global memory", &newSlabs);
+            slabStat->append(newStat);
+            ProxyStat* reusedStat = new ProxyStat();
+            reusedStat->init("reused", "Slabs recycled from the free list", &reusedSlabs);
+            slabStat->append(reusedStat);
+            ProxyStat* resetStat = new ProxyStat();
+            resetStat->init("resets", "Current slab freed and reused in place", &curSlabResets);
+            slabStat->append(resetStat);
+            auto liveFn = [this]() { return newSlabs - freeList.size() - (returnedSlabs - drainedSlabs); };
+            LambdaStat<decltype(liveFn)>* liveStat = new LambdaStat<decltype(liveFn)>(liveFn);
+            liveStat->init("live", "Slabs with live events (or being filled)");
+            slabStat->append(liveStat);
+            ProxyStat* returnedStat = new ProxyStat();
+            returnedStat->init("returned", "Slabs returned after all their events were done", &returnedSlabs);
+            slabStat->append(returnedStat);
+            ProxyStat* recycleStat = new ProxyStat();
+            recycleStat->init("recycleCycles", "Host cycles from slab retirement to return (divide by returned)", &recycleCycles);
+            slabStat->append(recycleStat);
+            parentStat->append(slabStat);
+        }
+
     private:
         void allocSlab() {
-            scoped_mutex sm(freeLock);
+            if (curSlab) curSlab->retireTsc = rdtsc();
+            if (freeList.empty()) drainReturns();
             if (!freeList.empty()) {
                 curSlab = freeList.back();
                 freeList.pop_back();
                 assert(curSlab);
+                reusedSlabs++;
             } else {
-                assert(sizeof(Slab) == SLAB_SIZE);
-                curSlab = gm_memalign<Slab>(sizeof(Slab));
-                assert((((uintptr_t)curSlab) & SLAB_MASK) == (uintptr_t)curSlab);
-                curSlab->init(this);  // NOTE: Slab is POD
+                curSlab = newSlab();
+                newSlabs++;
             }
-            liveSlabs++;
-            //info("allocated slab %p, %d live, %ld in freeList", curSlab, liveSlabs, freeList.size());
+            //info("allocated slab %p, %ld in freeList", curSlab, freeList.size());
         }
 
+        Slab* newSlab() {
+            assert(sizeof(Slab) == SLAB_SIZE);
+            Slab* s;
+            if (hugePages) {
+                if (!arenaLeft) {
+                    arenaNext = gm_memalign<Slab>(SLAB_ARENA_SIZE, SLABS_PER_ARENA);
+                    arenaLeft = SLABS_PER_ARENA;
+                    // Global memory is shared; this only takes effect if shmem THP is set to advise or higher
+                    if (madvise(arenaNext, SLAB_ARENA_SIZE, MADV_HUGEPAGE) != 0) warn("madvise(MADV_HUGEPAGE) failed on slab arena %p", arenaNext);
+                }
+                s = arenaNext++;
+                arenaLeft--;
+            } else {
+                s = gm_memalign<Slab>(sizeof(Slab));
+            }
+            assert((((uintptr_t)s) & SLAB_MASK) == (uintptr_t)s);
+            s->init(this);  // NOTE: Slab is POD
+            return s;
+        }
+
+        // Takes the whole return stack at once, so concurrent pushes never see a popped node
+        void drainReturns() {
+            Slab* s = __sync_lock_test_and_set(&returnHead, nullptr);
+            while (s) {
+                Slab* next = s->nextFree;
+                s->nextFree = nullptr;
+                freeList.push_back(s);
+                drainedSlabs++;
+                s = next;
+            }
+        }
+
+        // Called by any thread, when the last event in the slab is freed
         void freeSlab(Slab* s) {
-            scoped_mutex sm(freeLock);
-            //info("freeing slab %p, %d live, %ld in freeList", s, liveSlabs, freeList.size());
+            //info("freeing slab %p", s);
             s->clear();
 #ifdef DEBUG_SLAB_ALLOC
             memset(s->buf, -1, sizeof(s->buf));
 #endif
-            if (s != curSlab) {
-                freeList.push_back(s);
-                liveSlabs--;
+            if (s == curSlab) {
+                // Slabs are filled in the bound phase and freed in the weave phase, so the allocator is not using it
+                __sync_fetch_and_add(&curSlabResets, 1);
+                return;
             }
-            assert(liveSlabs);  // at least curSlab
+
+            __sync_fetch_and_add(&recycleCycles, rdtsc() - s->retireTsc);
+            __sync_fetch_and_add(&returnedSlabs, 1);
+            Slab* head;
+            do {
+                head = returnHead;
+                s->nextFree = head;
+            } while (!__sync_bool_compare_and_swap(&returnHead, head, s));
         }
 
         friend struct Slab;
@@ -56,7 +56,7 @@ int main(int argc, const char* argv[]) {
 
     AccessTraceReader* tr = new AccessTraceReader(argv[1]);
     uint32_t numChildren = tr->getNumChildren();
-    AccessTraceWriter* tw = new AccessTraceWriter(argv[2], numChildren);
+    AccessTraceWriter* tw = new AccessTraceWriter(argv[2], numChildren, tr->getSampleScale(), tr->getSampledSets());
 
     deque<AccessRecord>* accs[numChildren];  // null if the child has no accesses
     for (uint32_t i = 0; i < numChildren; i++) accs[i] = nullptr;
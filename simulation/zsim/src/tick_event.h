@@ -40,6 +40,8 @@ class TickEvent : public TimingEvent, public GlobAlloc { //this one should be al
     public:
         TickEvent(T* _obj, int32_t domain) : TimingEvent(0, 0, domain), obj(_obj), active(false) {
             setMinStartCycle(0);
+            setType(EVT_TICK);
+            setParentDoneKind(PD_VIRTUAL);
         }
 
         void parentDone(uint64_t startCycle) {
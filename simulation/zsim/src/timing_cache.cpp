@@ -25,6 +25,7 @@
 
 #include "timing_cache.h"
 #include "event_recorder.h"
+#include "mem_ctrls.h"
 #include "timing_event.h"
 #include "zsim.h"
 
@@ -34,7 +35,7 @@ class HitEvent : public TimingEvent {
         TimingCache* cache;
 
     public:
-        HitEvent(TimingCache* _cache,  uint32_t postDelay, int32_t domain) : TimingEvent(0, postDelay, domain), cache(_cache) {}
+        HitEvent(TimingCache* _cache,  uint32_t postDelay, int32_t domain) : TimingEvent(0, postDelay, domain), cache(_cache) {setType(EVT_CACHE_HIT);}
 
         void simulate(uint64_t startCycle) {
             cache->simulateHit(this, startCycle);
@@ -47,7 +48,7 @@ class MissStartEvent : public TimingEvent {
         TimingCache* cache;
     public:
         uint64_t startCycle; //for profiling purposes
-        MissStartEvent(TimingCache* _cache,  uint32_t postDelay, int32_t domain) : TimingEvent(0, postDelay, domain), cache(_cache) {}
+        MissStartEvent(TimingCache* _cache,  uint32_t postDelay, int32_t domain) : TimingEvent(0, postDelay, domain), cache(_cache) {setType(EVT_CACHE_MISS_START);}
         void simulate(uint64_t startCycle) {cache->simulateMissStart(this, startCycle);}
 };
 
@@ -56,7 +57,7 @@ class MissResponseEvent : public TimingEvent {
         TimingCache* cache;
         MissStartEvent* mse;
     public:
-        MissResponseEvent(TimingCache* _cache, MissStartEvent* _mse, int32_t domain) : TimingEvent(0, 0, domain), cache(_cache), mse(_mse) {}
+        MissResponseEvent(TimingCache* _cache, MissStartEvent* _mse, int32_t domain) : TimingEvent(0, 0, domain), cache(_cache), mse(_mse) {setType(EVT_CACHE_MISS_RESP);}
         void simulate(uint64_t startCycle) {cache->simulateMissResponse(this, startCycle, mse);}
 };
 
@@ -65,7 +66,7 @@ class MissWritebackEvent : public TimingEvent {
         TimingCache* cache;
         MissStartEvent* mse;
     public:
-        MissWritebackEvent(TimingCache* _cache,  MissStartEvent* _mse, uint32_t postDelay, int32_t domain) : TimingEvent(0, postDelay, domain), cache(_cache), mse(_mse) {}
+        MissWritebackEvent(TimingCache* _cache,  MissStartEvent* _mse, uint32_t postDelay, int32_t domain) : TimingEvent(0, postDelay, domain), cache(_cache), mse(_mse) {setType(EVT_CACHE_MISS_WB);}
         void simulate(uint64_t startCycle) {cache->simulateMissWriteback(this, startCycle, mse);}
 };
 
@@ -74,7 +75,7 @@ class ReplAccessEvent : public TimingEvent {
         TimingCache* cache;
     public:
         uint32_t accsLeft;
-        ReplAccessEvent(TimingCache* _cache, uint32_t _accsLeft, uint32_t preDelay, uint32_t postDelay, int32_t domain) : TimingEvent(preDelay, postDelay, domain), cache(_cache), accsLeft(_accsLeft) {}
+        ReplAccessEvent(TimingCache* _cache, uint32_t _accsLeft, uint32_t preDelay, uint32_t postDelay, int32_t domain) : TimingEvent(preDelay, postDelay, domain), cache(_cache), accsLeft(_accsLeft) {setType(EVT_CACHE_REPL);}
         void simulate(uint64_t startCycle) {cache->simulateReplAccess(this, startCycle);}
 };
 
@@ -87,6 +88,8 @@ TimingCache::TimingCache(uint32_t _numLines, CC* _cc, CacheArray* _array, ReplPo
     assert(numMSHRs > 0);
     activeMisses = 0;
     domain = _domain;
+    //Misses hold an MSHR for their whole latency, so the service time is the measured average miss latency
+    mshrModel = zinfo->analyticalContention? new MD1Model(numMSHRs, 0) : nullptr;
     info("%s: mshrs %d domain %d", name.c_str(), numMSHRs, domain);
 }
 
@@ -107,11 +110,20 @@ void TimingCache::initStats(AggregateStat* parentStat) {
     cacheStat->append(&profMissRespLat);
     cacheStat->append(&profMissLat);
 
+    if (mshrModel) {
+        AggregateStat* mshrStat = new AggregateStat();
+        mshrStat->init("mshrModel", "Analytical MSHR contention model");
+        mshrModel->initStats(mshrStat);
+        cacheStat->append(mshrStat);
+    }
+
     parentStat->append(cacheStat);
 }
 
 // TODO(dsm): This is copied verbatim from Cache. We should split Cache into different methods, then call those.
 uint64_t TimingCache::access(MemReq& req) {
+    if (mshrModel) return analyticalAccess(req);
+
     EventRecorder* evRec = zinfo->eventRecorders[req.srcId];
     assert_msg(evRec, "TimingCache is not connected to TimingCore");
 
@@ -267,6 +279,20 @@ uint64_t TimingCache::access(MemReq& req) {
 }
 
 
+// Bound phase only: a plain cache access, plus the MSHR queueing delay estimated from previous phases
+uint64_t TimingCache::analyticalAccess(MemReq& req) {
+    uint64_t respCycle = Cache::access(req);
+    uint64_t lat = respCycle - req.cycle;
+    if (lat > accLat) { //went to our parent (miss or upgrade), so it held an MSHR
+        mshrModel->record(lat);
+        respCycle += mshrModel->getDelay();
+        profMissLat.atomicInc(respCycle - req.cycle);
+    } else {
+        profHitLat.atomicInc(lat);
+    }
+    return respCycle;
+}
+
 uint64_t TimingCache::highPrioAccess(uint64_t cycle) {
     assert(cycle >= lastFreeCycle);
     uint64_t lookupCycle = MAX(cycle, lastAccCycle+1);
@@ -35,6 +35,7 @@ class MissResponseEvent;
 class MissWritebackEvent;
 class ReplAccessEvent;
 class TimingEvent;
+class MD1Model;
 
 class TimingCache : public Cache {
     private:
@@ -51,6 +52,9 @@ class TimingCache : public Cache {
         // For zcache replacement simulation (pessimistic, assumes we walk the whole tree)
         uint32_t tagLat, ways, cands;
 
+        // Only with sim.analyticalContention: models MSHR queueing instead of simulating it
+        MD1Model* mshrModel;
+
         PAD();
         lock_t topLock;
         PAD();
@@ -69,6 +73,7 @@ class TimingCache : public Cache {
         void simulateReplAccess(ReplAccessEvent* ev, uint64_t cycle);
 
     private:
+        uint64_t analyticalAccess(MemReq& req);
         uint64_t highPrioAccess(uint64_t cycle);
         uint64_t tryLowPrioAccess(uint64_t cycle);
 };
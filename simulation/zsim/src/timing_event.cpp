@@ -27,10 +27,18 @@
 #include <sstream>
 #include <typeinfo>
 #include "contention_sim.h"
+#include "weave_profiler.h"
 #include "zsim.h"
 
 /* TimingEvent */
 
+const char* timingEventTypeNames[EVT_NUM_TYPES] = {
+    "other", "delay", "crossing", "crossingSrc", "tick",
+    "core", "oooIssue", "oooDispatch", "oooResp",
+    "cacheHit", "cacheMissStart", "cacheMissResp", "cacheMissWb", "cacheRepl",
+    "memAccess", "memRefresh", "memSched", "noc"
+};
+
 void TimingEvent::parentDone(uint64_t startCycle) {
     cycle = MAX(cycle, startCycle);
     assert(numParents);
@@ -52,6 +60,7 @@ void TimingEvent::requeue(uint64_t nextCycle) {
     assert(numParents == 0);
     assert(state == EV_RUNNING || state == EV_HELD);
     state = EV_QUEUED;
+    if (unlikely(zinfo->weaveProfiler != nullptr)) zinfo->weaveProfiler->eventRequeued(domain, getType(), nextCycle);
     zinfo->contentionSim->enqueue(this, nextCycle);
 }
 
@@ -82,6 +91,16 @@ void TimingEvent::checkDomain(TimingEvent* ch) {
     //assert(domain == ch->domain || dynamic_cast<CrossingEvent*>(ch));
 }
 
+void TimingEvent::recordDagDone(uint64_t doneCycle) {
+    assert(domain != -1);
+    WeaveProfiler* prof = zinfo->weaveProfiler;
+    auto vLambda = [this, prof, doneCycle](TimingEvent** childPtr) {
+        prof->recordEdge(domain, this, *childPtr, doneCycle+postDelay);
+    };
+    visitChildren< decltype(vLambda) >(vLambda);
+    prof->recordDone(domain, this, doneCycle);
+}
+
 
 /* CrossingEvent */
 
@@ -89,6 +108,8 @@ CrossingEvent::CrossingEvent(TimingEvent* parent, TimingEvent* child, uint64_t _
     : TimingEvent(0, 0, child->domain), cpe(this, parent->domain)
 {
     assert(parent->domain != child->domain);
+    setType(EVT_CROSSING);
+    setParentDoneKind(PD_VIRTUAL);
     parentEv = parent;
     evRec = _evRec;
     srcDomain = parent->domain;
@@ -121,6 +142,8 @@ void CrossingEvent::markSrcEventDone(uint64_t cycle) {
     //Sanity check
     srcDomainCycleAtDone = zinfo->contentionSim->getCurCycle(srcDomain);
     assert(cycle >= srcDomainCycleAtDone);
+    //Link the source-domain event to us (before setting called, so the edge precedes our completion)
+    if (unlikely(zinfo->weaveDagActive)) zinfo->weaveProfiler->recordEdge(srcDomain, &cpe, this, cycle);
     //NOTE: No fencing needed; TSO ensures writes to doneCycle and callled happen in order.
     doneCycle = cycle;
     called = true;
@@ -150,6 +173,7 @@ void CrossingEvent::simulate(uint64_t simCycle) {
         __sync_synchronize(); //not needed --- these are all volatile, and by TSO, if we see a cycle > doneCycle, by force we must see doneCycle set
         if (!called) { //have to check again, AFTER reading the cycles! Otherwise, we have a race
             zinfo->contentionSim->setPrio(domain, (nextCycle == simCycle)? 1 : 2);
+            zinfo->contentionSim->countCrossingStall(domain);
 
 #if PROFILE_CROSSINGS
             simCount++;
@@ -167,6 +191,8 @@ void CrossingEvent::simulate(uint64_t simCycle) {
 #if PROFILE_CROSSINGS
     zinfo->contentionSim->profileCrossing(srcDomain, domain, simCount);
 #endif
+    zinfo->contentionSim->countCrossing(srcDomain, domain);
+    if (unlikely(zinfo->weaveProfiler != nullptr)) zinfo->weaveProfiler->crossingDone(domain, preSlack + postSlack);
 
     uint64_t dCycle = MAX(simCycle, doneCycle);
     //info("Crossing %d->%d done %ld", srcDomain, domain, dCycle);
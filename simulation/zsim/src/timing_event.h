@@ -32,8 +32,12 @@
 #include "bithacks.h"
 #include "event_recorder.h"
 #include "galloc.h"
+#include "zsim.h"
 
-#define TIMING_BLOCK_EVENTS 3
+//Children are stored inline up to TIMING_INLINE_CHILDREN; beyond that, they spill to a
+//list of blocks. Blocks take a cache line, so long fan-outs chase few pointers.
+#define TIMING_INLINE_CHILDREN 2
+#define TIMING_BLOCK_EVENTS 7
 struct TimingEventBlock {
     TimingEvent* events[TIMING_BLOCK_EVENTS];
     TimingEventBlock* next;
@@ -60,45 +64,71 @@ struct TimingEventBlock {
         void* operator new (size_t);
 };
 
-enum EventState {EV_INVALID, EV_NONE, EV_QUEUED, EV_RUNNING, EV_HELD, EV_DONE};
+enum EventState : uint8_t {EV_INVALID, EV_NONE, EV_QUEUED, EV_RUNNING, EV_HELD, EV_DONE};
+
+//Event types, used to break down weave-phase work in stats (names in timingEventTypeNames)
+enum TimingEventType {
+    EVT_OTHER, EVT_DELAY, EVT_CROSSING, EVT_CROSSING_SRC, EVT_TICK,
+    EVT_CORE, EVT_OOO_ISSUE, EVT_OOO_DISPATCH, EVT_OOO_RESP,
+    EVT_CACHE_HIT, EVT_CACHE_MISS_START, EVT_CACHE_MISS_RESP, EVT_CACHE_MISS_WB, EVT_CACHE_REPL,
+    EVT_MEM_ACCESS, EVT_MEM_REFRESH, EVT_MEM_SCHED, EVT_NOC,
+    EVT_NUM_TYPES
+};
+
+extern const char* timingEventTypeNames[EVT_NUM_TYPES];
+
+//How notifyParentDone() reaches parentDone(): events that override it must say so in their constructor
+//(setParentDoneKind(PD_VIRTUAL)), so that the common base and DelayEvent cases skip virtual dispatch
+enum ParentDoneKind {PD_BASE, PD_DELAY, PD_VIRTUAL};
 
 class CrossingEvent;
 
+//Layout is packed to fit a cache line (checked below), as weave-phase work is dominated by misses on events
 class TimingEvent {
     private:
-        uint64_t privCycle; //only touched by ContentionSim
+        //An event waits for its parents (EV_NONE) or sits in a queue, never both, so the cycles share storage
+        union {
+            uint64_t cycle; //while waiting for parents: max of their done cycles
+            uint64_t privCycle; //while queued: only touched by ContentionSim and PrioQueue
+        };
 
     public:
         TimingEvent* next; //used by PrioQueue --- PRIVATE
 
     private:
-        EventState state;
-        uint64_t cycle;
-
         uint64_t minStartCycle;
         union {
-            TimingEvent* child;
-            TimingEventBlock* children;
+            TimingEvent* child[TIMING_INLINE_CHILDREN];
+            TimingEventBlock* children; //if numChildren > TIMING_INLINE_CHILDREN
         };
-        int32_t domain; //-1 if none; if none, it acquires it from the parent. Cannot be a starting event (no parents at enqueue time) and get -1 as domain
-        uint32_t numChildren;
-        uint32_t numParents;
+        int16_t domain; //-1 if none; if none, it acquires it from the parent. Cannot be a starting event (no parents at enqueue time) and get -1 as domain
+        EventState state;
+        uint8_t evType : 6; //TimingEventType
+        uint8_t parentDoneKind : 2; //ParentDoneKind
+        uint16_t numChildren;
+        uint16_t numParents;
         uint32_t preDelay;
         uint32_t postDelay; //we could get by with one delay, but pre/post makes it easier to code
 
     public:
-        TimingEvent(uint32_t _preDelay, uint32_t _postDelay, int32_t _domain = -1) : next(nullptr), state(EV_NONE), cycle(0), minStartCycle(-1L), child(nullptr),
-                    domain(_domain), numChildren(0), numParents(0), preDelay(_preDelay), postDelay(_postDelay) {}
-        explicit TimingEvent(int32_t _domain = -1) : next(nullptr), state(EV_NONE), minStartCycle(-1L), child(nullptr),
-                    domain(_domain), numChildren(0), numParents(0), preDelay(0), postDelay(0) {} //no delegating constructors until gcc 4.7...
+        TimingEvent(uint32_t _preDelay, uint32_t _postDelay, int32_t _domain = -1) : cycle(0), next(nullptr), minStartCycle(-1L),
+                    domain(_domain), state(EV_NONE), evType(EVT_OTHER), parentDoneKind(PD_BASE), numChildren(0), numParents(0), preDelay(_preDelay), postDelay(_postDelay) {
+            for (uint32_t i = 0; i < TIMING_INLINE_CHILDREN; i++) child[i] = nullptr;
+        }
+        explicit TimingEvent(int32_t _domain = -1) : cycle(0), next(nullptr), minStartCycle(-1L),
+                    domain(_domain), state(EV_NONE), evType(EVT_OTHER), parentDoneKind(PD_BASE), numChildren(0), numParents(0), preDelay(0), postDelay(0) { //no delegating constructors until gcc 4.7...
+            for (uint32_t i = 0; i < TIMING_INLINE_CHILDREN; i++) child[i] = nullptr;
+        }
 
         inline uint32_t getDomain() const {return domain;}
         inline uint32_t getNumChildren() const {return numChildren;}
         inline uint32_t getPreDelay() const {return preDelay;}
         inline uint32_t getPostDelay() const {return postDelay;}
+        inline TimingEventType getType() const {return (TimingEventType)evType;}
 
         inline void setPreDelay(uint32_t d) {preDelay = d;}
         inline void setPostDelay(uint32_t d) {postDelay = d;}
+        inline void setType(TimingEventType t) {evType = t;}
 
         inline uint64_t getMinStartCycle() const {return minStartCycle;}
         inline void setMinStartCycle(uint64_t c) {minStartCycle = c;}
@@ -107,17 +137,17 @@ class TimingEvent {
             assert_msg(state == EV_NONE || state == EV_QUEUED, "adding child in invalid state %d %s -> %s", state, typeid(*this).name(), typeid(*childEv).name()); //either not scheduled or not executed yet
             assert(childEv->state == EV_NONE);
 
+            assert(numChildren < UINT16_MAX && childEv->numParents < UINT16_MAX);
+
             TimingEvent* res = childEv;
 
-            if (numChildren == 0) {
-                numChildren = 1;
-                child = childEv;
-            } else if (numChildren == 1) {
-                TimingEvent* firstChild = child;
-                children = new (evRec) TimingEventBlock();
-                children->events[0] = firstChild;
-                children->events[1] = childEv;
-                numChildren = 2;
+            if (numChildren < TIMING_INLINE_CHILDREN) {
+                child[numChildren] = childEv;
+            } else if (numChildren == TIMING_INLINE_CHILDREN) {
+                TimingEventBlock* blk = new (evRec) TimingEventBlock();
+                for (uint32_t i = 0; i < TIMING_INLINE_CHILDREN; i++) blk->events[i] = child[i];
+                blk->events[TIMING_INLINE_CHILDREN] = childEv;
+                children = blk;
             } else {
                 uint32_t idx = numChildren % TIMING_BLOCK_EVENTS;
                 if (idx == 0) {
@@ -126,8 +156,8 @@ class TimingEvent {
                     children->next = tmp;
                 }
                 children->events[idx] = childEv;
-                numChildren++;
             }
+            numChildren++;
 
             if (domain != -1 && childEv->domain == -1) {
                 childEv->propagateDomain(domain);
@@ -143,6 +173,9 @@ class TimingEvent {
 
         virtual void parentDone(uint64_t startCycle); // see cpp
 
+        //Calls parentDone(), skipping virtual dispatch unless the event overrides it (see ParentDoneKind)
+        inline void notifyParentDone(uint64_t startCycle);
+
         //queue for the first time
         //always happens on PHASE 1 (bound), and is synchronized
         void queue(uint64_t qCycle); //see cpp
@@ -179,9 +212,10 @@ class TimingEvent {
         void done(uint64_t doneCycle) {
             assert(state == EV_RUNNING); //ContentionSim sets it when calling simulate()
             state = EV_DONE;
+            if (unlikely(zinfo->weaveDagActive)) recordDagDone(doneCycle);
             auto vLambda = [this, doneCycle](TimingEvent** childPtr) {
                 checkDomain(*childPtr);
-                (*childPtr)->parentDone(doneCycle+postDelay);
+                (*childPtr)->notifyParentDone(doneCycle+postDelay);
             };
             visitChildren< decltype(vLambda) >(vLambda);
             freeEvent();  // NOTE: immediately reclaimed!
@@ -227,10 +261,9 @@ class TimingEvent {
 
         template <typename F> //F has to be decltype(f)
         inline void visitChildren(F f) {
-            if (numChildren == 0) return;
             //info("visit %p nc %d", this, numChildren);
-            if (numChildren == 1) {
-                f(&child);
+            if (numChildren <= TIMING_INLINE_CHILDREN) {
+                for (uint32_t i = 0; i < numChildren; i++) f(&child[i]);
             } else {
                 TimingEventBlock* curBlock = children;
                 uint32_t visitedChildren = 0;
@@ -253,9 +286,11 @@ class TimingEvent {
 
         void checkDomain(TimingEvent* ch);
 
+        void recordDagDone(uint64_t doneCycle); //records our outgoing edges and completion to the weave profiler
+
         void freeEvent() {
             // Free timing event blocks and ourselves
-            if (numChildren > 1) {
+            if (numChildren > TIMING_INLINE_CHILDREN) {
                 TimingEventBlock* teb = children;
                 while (teb) {
                     TimingEventBlock* next = teb->next;
@@ -270,6 +305,9 @@ class TimingEvent {
 
     protected:
 
+        // Every constructor of an event that overrides parentDone() must call this
+        inline void setParentDoneKind(ParentDoneKind k) {parentDoneKind = k;}
+
         // If an event is externally handled, and has no parents or children,
         // it can call this at initialization to always be between RUNNING and
         // QUEUED (through requeue())
@@ -280,13 +318,22 @@ class TimingEvent {
 
 
     friend class ContentionSim;
+    template <typename T, uint32_t B> friend class PrioQueue;
     friend class DelayEvent; //DelayEvent is, for now, the only child of TimingEvent that should do anything other than implement simulate
     friend class CrossingEvent;
 };
 
+static_assert(sizeof(TimingEvent) <= 64, "TimingEvent should fit in a cache line");
+static_assert(EVT_NUM_TYPES <= 64, "TimingEventType must fit in evType's 6 bits");
+static_assert(sizeof(TimingEventBlock) <= 64, "TimingEventBlock should fit in a cache line");
+static_assert(TIMING_INLINE_CHILDREN < TIMING_BLOCK_EVENTS, "Spilled inline children must fit in the first block");
+
 class DelayEvent : public TimingEvent {
     public:
-        explicit DelayEvent(uint32_t delay) : TimingEvent(delay, 0) {}
+        explicit DelayEvent(uint32_t delay) : TimingEvent(delay, 0) {
+            setType(EVT_DELAY);
+            setParentDoneKind(PD_DELAY);
+        }
 
         virtual void parentDone(uint64_t startCycle) {
             cycle = MAX(cycle, startCycle);
@@ -303,6 +350,19 @@ class DelayEvent : public TimingEvent {
         }
 };
 
+inline void TimingEvent::notifyParentDone(uint64_t startCycle) {
+    switch (parentDoneKind) {
+        case PD_BASE:
+            TimingEvent::parentDone(startCycle);
+            break;
+        case PD_DELAY:
+            static_cast<DelayEvent*>(this)->DelayEvent::parentDone(startCycle);
+            break;
+        default:
+            parentDone(startCycle);
+    }
+}
+
 class CrossingEvent : public TimingEvent {
     private:
         uint32_t srcDomain;
@@ -321,6 +381,8 @@ class CrossingEvent : public TimingEvent {
                 CrossingEvent* ce;
             public:
                 CrossingSrcEvent(CrossingEvent* _ce, uint32_t dom) : TimingEvent(0, 0, dom), ce(_ce) {
+                    setType(EVT_CROSSING_SRC);
+                    setParentDoneKind(PD_VIRTUAL);
                     //These are never connected to anything, but substitute an existing event; so, this never gets
                     //numParents incremented, but we set it to 1 to maintain semantics in case we have a walk
                     assert(numParents == 0);
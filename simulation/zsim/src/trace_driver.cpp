@@ -24,10 +24,13 @@
  */
 
 #include <sstream>
+#include "bithacks.h"
+#include "checkpoint.h"
+#include "pin.H"
 #include "trace_driver.h"
 #include "zsim.h"
 
-TraceDriver::TraceDriver(std::string filename, std::string retraceFilename, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets)
+TraceDriver::TraceDriver(std::string filename, std::string retraceFilename, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets, uint32_t _replayThreads)
     : tr(filename), numChildren(proxies.size()), useSkews(_useSkews), playPuts(_playPuts), playAllGets(_playAllGets)
 {
     assert(numChildren > 0);
@@ -36,21 +39,61 @@ TraceDriver::TraceDriver(std::string filename, std::string retraceFilename, std:
     children = new ChildInfo[numChildren];
     futex_init(&lock);
     lastAcc.childId = -1;
-    parent = proxies[0]->getParent();
-    for (uint32_t i = 0; i < numChildren; i++) proxies[i]->setDriver(this);
+    recordsRead = 0;
+    sampleScale = tr.getSampleScale();
+    if (sampleScale > 1) info("Trace driver: %s is sampled, extrapolating driver stats by %ld (cache stats are unscaled)", filename.c_str(), sampleScale);
+    for (uint32_t i = 0; i < numChildren; i++) {
+        children[i].parents = proxies[i]->getParents();
+        children[i].parentChildId = proxies[i]->getChildId();
+        assert(children[i].parents.size() > 0);
+        proxies[i]->setDriver(this, i);
+    }
+
+    // Parallel replay shards by bank, so it needs a single set of banks shared by all children
+    numBanks = children[0].parents.size();
+    numReplayThreads = MAX(1u, MIN(_replayThreads, numBanks));
+    if (numReplayThreads < _replayThreads) warn("Trace driver: %d replay threads requested, but only %d banks to shard; using %d", _replayThreads, numBanks, numReplayThreads);
+    if (numReplayThreads > 1) {
+        for (uint32_t i = 1; i < numChildren; i++) {
+            if (children[i].parents != children[0].parents) panic("Parallel trace replay requires all trace children to share the same (banked) parent cache");
+        }
+        if (useSkews) warn("Trace driver: with parallel replay, skews are applied at phase granularity");
+    }
+    for (uint32_t i = 0; i < numChildren; i++) children[i].cStores = new std::unordered_map<Address, MESIState>[numReplayThreads];
 
     if (retraceFilename != "") { //we're doing retracing with the new skews
         g_string fname(retraceFilename.c_str());
-        atw = new AccessTraceWriter(fname, numChildren);
+        atw = new AccessTraceWriter(fname, numChildren, sampleScale, tr.getSampledSets());
         zinfo->traceWriters->push_back(atw);
     } else {
         atw = nullptr;
     }
+
+    replayThreads = nullptr;
+    if (numReplayThreads > 1) {
+        replayThreads = new ReplayThread[numReplayThreads];
+        for (uint32_t i = 0; i < numReplayThreads; i++) {
+            futex_init(&replayThreads[i].wakeLock);
+            futex_lock(&replayThreads[i].wakeLock); //starts locked, so first actual call to lock blocks
+        }
+        futex_init(&waitLock);
+        futex_lock(&waitLock);
+        threadsDone = 0;
+        threadTicket = 0;
+        __sync_synchronize();
+        for (uint32_t i = 0; i < numReplayThreads; i++) {
+            PIN_SpawnInternalThread(ReplayThreadTrampoline, this, 1024*1024, nullptr);
+        }
+        info("Trace driver: replaying %d banks with %d threads", numBanks, numReplayThreads);
+    }
 }
 
 void TraceDriver::initStats(AggregateStat* parentStat) {
     AggregateStat* drvStat = new AggregateStat(false); //don't make it a regular aggregate... it gets compacted in periodic stats and becomes useless!
     drvStat->init("driver", "Trace driver stats");
+    ProxyStat* scaleStat = new ProxyStat();
+    scaleStat->init("sampleScale", "Trace sample scale (records in the full trace per replayed record)", &sampleScale);
+    drvStat->append(scaleStat);
     for (uint32_t c = 0; c < numChildren; c++) {
         std::stringstream pss;
         pss << "child-" << c;
@@ -58,7 +101,13 @@ void TraceDriver::initStats(AggregateStat* parentStat) {
         cStat->init(gm_strdup(pss.str().c_str()), "Child stats");
         ProxyStat* cycleStat = new ProxyStat();
         cycleStat->init("cycles", "Cycles", &children[c].lastReqCycle);  cStat->append(cycleStat);
+        children[c].profGETs.init("GETs", "Replayed GET requests"); cStat->append(&children[c].profGETs);
         children[c].profLat.init("latGET", "GET request latency"); cStat->append(&children[c].profLat);
+        ChildInfo* ci = &children[c];
+        auto estGETs = makeLambdaStat([this, ci]() { return ci->profGETs.get()*sampleScale; });
+        estGETs->init("estGETs", "GET requests, extrapolated to the full trace"); cStat->append(estGETs);
+        auto estLat = makeLambdaStat([this, ci]() { return ci->profLat.get()*sampleScale; });
+        estLat->init("estLatGET", "GET request latency, extrapolated to the full trace"); cStat->append(estLat);
         ProxyStat* skewStat = new ProxyStat();
         skewStat->init("skew", "Latency skew", (uint64_t*)&children[c].skew);  cStat->append(skewStat);
 
@@ -70,71 +119,132 @@ void TraceDriver::initStats(AggregateStat* parentStat) {
     parentStat->append(drvStat);
 }
 
-void TraceDriver::setParent(MemObject* _parent) {
-    parent = _parent;
+uint64_t TraceDriver::parentAccess(uint32_t childId, MemReq& req) {
+    const g_vector<MemObject*>& parents = children[childId].parents;
+    uint32_t parentId = (parents.size() == 1)? 0 : MESIBottomCC::parentIdHash(req.lineAddr, parents.size());
+    return parents[parentId]->access(req);
 }
 
 uint64_t TraceDriver::invalidate(uint32_t childId, Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId) {
     assert(childId < numChildren);
-    std::unordered_map<Address, MESIState>& cStore = children[childId].cStore;
+    //Called from the replay thread that owns lineAddr's bank (proxies are LLC children, so invalidations never cross banks)
+    std::unordered_map<Address, MESIState>& cStore = children[childId].cStores[getReplayThread(lineAddr)];
     std::unordered_map<Address, MESIState>::iterator it = cStore.find(lineAddr);
     assert((it != cStore.end()));
     *reqWriteback = (it->second == M);
     if (type == INVX) {
         it->second = S;
-        children[childId].profInvx.inc();
+        children[childId].profInvx.atomicInc();
     } else {
         cStore.erase(it);
         if (srcId == childId) {
-            children[childId].profSelfInv.inc();
+            children[childId].profSelfInv.atomicInc();
         } else {
-            children[childId].profCrossInv.inc();
+            children[childId].profCrossInv.atomicInc();
         }
     }
     return 0;
 }
 
-//Returns false if done, true otherwise
-bool TraceDriver::executePhase() {
-    uint64_t limit = zinfo->globPhaseCycles + zinfo->phaseLength;
-
-    //Load valid access
-    AccessRecord acc;
+//Returns false if the trace is done, true otherwise
+bool TraceDriver::readAccess(AccessRecord& acc) {
     if (lastAcc.childId == (uint32_t)-1) {
         if (tr.empty()) return false;
         acc = tr.read();
+        recordsRead++;
         if (useSkews) acc.reqCycle += children[acc.childId].skew;
     } else {
         acc = lastAcc;
         lastAcc.childId = (uint32_t)-1;
     }
+    return true;
+}
+
+//Returns false if done, true otherwise
+bool TraceDriver::executePhase() {
+    uint64_t limit = zinfo->globPhaseCycles + zinfo->phaseLength;
 
     //Run until we reach the cycle limit or run out of phases
-    while (acc.reqCycle < limit) {
-        executeAccess(acc);
-        if (tr.empty()) return false;
-        acc = tr.read();
-        if (useSkews) acc.reqCycle += children[acc.childId].skew;
+    AccessRecord acc;
+    bool more = false;
+    while (readAccess(acc)) {
+        if (acc.reqCycle >= limit) {
+            lastAcc = acc; //save this access for the next phase
+            more = true;
+            break;
+        }
+        if (numReplayThreads == 1) executeAccess(acc);
+        else phaseRecs.push_back(acc);
     }
 
-    lastAcc = acc; //save this access for the next phase
-    return true;
+    if (!phaseRecs.empty()) replayPhaseParallel();
+    return more;
+}
+
+void TraceDriver::executeAccess(const AccessRecord& acc) {
+    int64_t lat;
+    if (replayAccess(acc, lat)) accountAccess(acc, lat);
 }
 
-void TraceDriver::executeAccess(AccessRecord acc) {
+void TraceDriver::replayPhaseParallel() {
+    uint32_t numRecs = phaseRecs.size();
+    phaseLats.resize(numRecs);
+    phasePlayed.resize(numRecs);
+    for (uint32_t t = 0; t < numReplayThreads; t++) replayThreads[t].recs.clear();
+    for (uint32_t i = 0; i < numRecs; i++) {
+        replayThreads[getReplayThread(phaseRecs[i].lineAddr)].recs.push_back(i);
+    }
+    __sync_synchronize();
+
+    //Wake up replay threads and sleep until the phase is replayed
+    for (uint32_t t = 0; t < numReplayThreads; t++) futex_unlock(&replayThreads[t].wakeLock);
+    futex_lock_nospin(&waitLock);
+
+    //Account in trace order, so stats and the retrace match serial replay
+    for (uint32_t i = 0; i < numRecs; i++) {
+        if (phasePlayed[i]) accountAccess(phaseRecs[i], phaseLats[i]);
+    }
+    phaseRecs.clear();
+}
+
+void TraceDriver::ReplayThreadTrampoline(void* arg) {
+    TraceDriver* drv = static_cast<TraceDriver*>(arg);
+    uint32_t thid = __sync_fetch_and_add(&drv->threadTicket, 1);
+    drv->replayThreadLoop(thid);
+}
+
+void TraceDriver::replayThreadLoop(uint32_t thid) {
+    info("Started trace replay thread %d", thid);
+    while (true) {
+        futex_lock_nospin(&replayThreads[thid].wakeLock);
+        for (uint32_t i : replayThreads[thid].recs) {
+            int64_t lat = 0;
+            phasePlayed[i] = replayAccess(phaseRecs[i], lat);
+            phaseLats[i] = lat;
+        }
+        uint32_t val = __sync_add_and_fetch(&threadsDone, 1);
+        if (val == numReplayThreads) {
+            threadsDone = 0;
+            futex_unlock(&waitLock); //unblock caller
+        }
+    }
+}
+
+bool TraceDriver::replayAccess(const AccessRecord& acc, int64_t& lat) {
     assert(acc.childId < numChildren);
-    std::unordered_map<Address, MESIState>& cStore = children[acc.childId].cStore;
+    std::unordered_map<Address, MESIState>& cStore = children[acc.childId].cStores[getReplayThread(acc.lineAddr)];
+    uint32_t pcId = children[acc.childId].parentChildId; //srcId stays the trace child, so self-invalidations are still detected
 
-    int64_t lat = 0;
+    lat = 0;
     switch (acc.type) {
         case PUTS:
         case PUTX:
             {
-                if (!playPuts) return;
+                if (!playPuts) return false;
                 std::unordered_map<Address, MESIState>::iterator it = cStore.find(acc.lineAddr);
-                if (it == cStore.end()) return; //we don't currently have this line, skip
-                MemReq req = {acc.lineAddr, 0, acc.type, acc.childId, &it->second, acc.reqCycle, nullptr, it->second, acc.childId};
-                lat = parent->access(req) - acc.reqCycle; //note that PUT latency does not affect driver latency
+                if (it == cStore.end()) return false; //we don't currently have this line, skip
+                MemReq req = {acc.lineAddr, 0, acc.type, pcId, &it->second, acc.reqCycle, nullptr, it->second, acc.childId};
+                lat = parentAccess(acc.childId, req) - acc.reqCycle; //note that PUT latency does not affect driver latency
                 assert(it->second == I);
                 cStore.erase(it);
             }
@@ -147,21 +257,19 @@ void TraceDriver::executeAccess(AccessRecord acc) {
                 if (it != cStore.end()) {
                     if (!((it->second == S) && (acc.type == GETX))) { //we have the line, and it's not an upgrade miss, we can't replay this access directly
                         if (playAllGets) { //issue a PUT
-                            MemReq req = {acc.lineAddr, 0, (it->second == M)? PUTX : PUTS, acc.childId, &it->second, acc.reqCycle, nullptr, it->second, acc.childId};
-                            parent->access(req);
+                            MemReq req = {acc.lineAddr, 0, (it->second == M)? PUTX : PUTS, pcId, &it->second, acc.reqCycle, nullptr, it->second, acc.childId};
+                            parentAccess(acc.childId, req);
                             assert(it->second == I);
                         } else {
-                            return; //skip
+                            return false; //skip
                         }
                     } else {
                         state = it->second;
                     }
                 }
-                MemReq req = {acc.lineAddr, 0, acc.type, acc.childId, &state, acc.reqCycle, nullptr, state, acc.childId};
-                uint64_t respCycle = parent->access(req);
+                MemReq req = {acc.lineAddr, 0, acc.type, pcId, &state, acc.reqCycle, nullptr, state, acc.childId};
+                uint64_t respCycle = parentAccess(acc.childId, req);
                 lat = respCycle - acc.reqCycle;
-                children[acc.childId].profLat.inc(lat);
-                children[acc.childId].skew += ((int64_t)lat - acc.latency);
                 assert(state != I);
                 cStore[acc.lineAddr] = state;
             }
@@ -169,6 +277,15 @@ void TraceDriver::executeAccess(AccessRecord acc) {
         default:
             panic("Unknown access type %d, trace is probably corrupted", acc.type);
     }
+    return true;
+}
+
+void TraceDriver::accountAccess(const AccessRecord& acc, int64_t lat) {
+    if (IsGet(acc.type)) {
+        children[acc.childId].profGETs.inc();
+        children[acc.childId].profLat.inc(lat);
+        children[acc.childId].skew += ((int64_t)lat - acc.latency);
+    }
 
     children[acc.childId].lastReqCycle = acc.reqCycle;
     if (atw) {
@@ -180,3 +297,52 @@ void TraceDriver::executeAccess(AccessRecord acc) {
     }
 }
 
+void TraceDriver::saveState(CheckpointWriter& cw) {
+    cw.write(numChildren);
+    cw.write(recordsRead);
+    cw.write(lastAcc);
+    for (uint32_t c = 0; c < numChildren; c++) {
+        ChildInfo& ci = children[c];
+        cw.write(ci.skew);
+        cw.write(ci.lastReqCycle);
+        //Flattened, so restores work with a different number of replay threads
+        uint64_t lines = 0;
+        for (uint32_t t = 0; t < numReplayThreads; t++) lines += ci.cStores[t].size();
+        cw.write(lines);
+        for (uint32_t t = 0; t < numReplayThreads; t++) {
+            for (auto& kv : ci.cStores[t]) {
+                cw.write(kv.first);
+                cw.write(kv.second);
+            }
+        }
+    }
+}
+
+void TraceDriver::loadState(CheckpointReader& cr) {
+    uint32_t ckptChildren;
+    cr.read(ckptChildren);
+    if (ckptChildren != numChildren) panic("Checkpoint has %d trace children, trace has %d", ckptChildren, numChildren);
+    uint64_t ckptRecords;
+    cr.read(ckptRecords);
+    cr.read(lastAcc);
+    for (uint32_t c = 0; c < numChildren; c++) {
+        ChildInfo& ci = children[c];
+        cr.read(ci.skew);
+        cr.read(ci.lastReqCycle);
+        uint64_t lines;
+        cr.read(lines);
+        for (uint32_t t = 0; t < numReplayThreads; t++) ci.cStores[t].clear();
+        for (uint64_t i = 0; i < lines; i++) {
+            Address lineAddr;
+            MESIState state;
+            cr.read(lineAddr);
+            cr.read(state);
+            ci.cStores[getReplayThread(lineAddr)][lineAddr] = state;
+        }
+    }
+
+    //Skip the records the checkpointed run already replayed
+    info("Trace driver: skipping %ld records already replayed in the checkpoint", ckptRecords);
+    if (ckptRecords > tr.getNumRecords()) panic("Checkpoint is past the end of the trace (%ld > %ld records)", ckptRecords, tr.getNumRecords());
+    for (; recordsRead < ckptRecords; recordsRead++) tr.read();
+}
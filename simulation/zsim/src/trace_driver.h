@@ -29,21 +29,29 @@
 #include <unordered_map>
 #include <vector>
 #include "access_tracing.h"
+#include "coherence_ctrls.h"
 #include "g_std/g_string.h"
 #include "stats.h"
 
-/* Basic class for trace-driven simulation. Shares the cache interface (invalidate), but it is not a cache in any sense --- it just reads in a single trace and replays it */
+/* Basic class for trace-driven simulation. Shares the cache interface (invalidate), but it is not a cache in any sense --- it just reads in a single trace and replays it.
+ * Each trace child is replayed through its proxy cache's parents; with multi-banked parents, records are routed to banks using the same hash caches use (MESIBottomCC).
+ * With several replay threads, each phase's records are sharded by destination bank and each shard is replayed on its own thread; latencies, skews and
+ * the retrace are then accounted in trace order at the end of the phase, so results match serial replay as long as banks do not interact.
+ */
 
 class TraceDriverProxyCache;
 
 class TraceDriver {
     private:
         struct ChildInfo {
-            std::unordered_map<Address, MESIState> cStore; //holds current sets of lines for each child. Needs to support an arbitrary set, hence the hash table
+            std::unordered_map<Address, MESIState>* cStores; //holds current sets of lines for each child, one per replay thread (each owns a disjoint set of banks). Needs to support an arbitrary set, hence the hash table
             int64_t skew;
             uint64_t lastReqCycle;
+            g_vector<MemObject*> parents; //banks of the parent cache this child is attached to
+            uint32_t parentChildId; //child id the parents know this child by
             //Counter bypassedGETS;
             //Counter bypassedGETX;
+            Counter profGETs;
             Counter profLat;
             Counter profSelfInv; //invalidations in response to our own access
             Counter profCrossInv; //invalidations in response to another access
@@ -54,51 +62,92 @@ class TraceDriver {
         lock_t lock; //NOTE: not needed for now
         AccessTraceReader tr;
         uint32_t numChildren;
+        uint64_t sampleScale; //>1 for sampled traces, extrapolated stats (est*) are scaled by it; cache stats are not
         bool useSkews; //If false, replays the trace using its request cycles. If true, it skews the simulated child. Can only be true with a single child.
         bool playPuts; //If true, issues PUTS/PUTX requests as they appear in the trace. If false, it just issues the GETS/X requests, leaving it up to the parent to decide when to evict something (NOTE: if the parent is running OPT, it knows better!)
         bool playAllGets; //If true, if we have a get to an address that we already have, issue a put immediately before.
-        MemObject* parent;
 
         AccessTraceWriter* atw;
 
         //Last access, childId == -1 if invalid, acts as 1-elem buffer
         AccessRecord lastAcc;
+        uint64_t recordsRead; //trace position, for checkpoints
+
+        //Parallel replay
+        struct ReplayThread {
+            std::vector<uint32_t> recs; //indexes into phaseRecs of the records of this thread's banks
+            lock_t wakeLock;
+        };
+
+        uint32_t numBanks;
+        uint32_t numReplayThreads;
+        ReplayThread* replayThreads;
+        std::vector<AccessRecord> phaseRecs;
+        std::vector<int64_t> phaseLats;
+        std::vector<uint8_t> phasePlayed; //not vector<bool>, threads write adjacent elements
+        volatile uint32_t threadsDone;
+        volatile uint32_t threadTicket;
+        lock_t waitLock;
 
     public:
-        TraceDriver(std::string filename, std::string retracefile, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets);
+        TraceDriver(std::string filename, std::string retracefile, std::vector<TraceDriverProxyCache*>& proxies, bool _useSkews, bool _playPuts, bool _playAllGets, uint32_t _replayThreads);
         void initStats(AggregateStat* parentStat);
-        void setParent(MemObject* _parent);
+
+        uint64_t getSampleScale() const {return sampleScale;}
+        uint32_t getSampledSets() const {return tr.getSampledSets();}
 
         uint64_t invalidate(uint32_t childId, Address lineAddr, InvType type, bool* reqWriteback, uint64_t reqCycle, uint32_t srcId);
 
         //Returns false if done, true otherwise
         bool executePhase();
 
+        //Warm-up checkpoints: children's lines, skews and the trace position
+        void saveState(CheckpointWriter& cw);
+        void loadState(CheckpointReader& cr);
+
     private:
-        inline void executeAccess(AccessRecord acc);
+        inline bool readAccess(AccessRecord& acc);
+        inline void executeAccess(const AccessRecord& acc);
+        inline bool replayAccess(const AccessRecord& acc, int64_t& lat); //false if the access was skipped
+        inline void accountAccess(const AccessRecord& acc, int64_t lat);
+        inline uint64_t parentAccess(uint32_t childId, MemReq& req);
+
+        inline uint32_t getReplayThread(Address lineAddr) const {
+            return (numReplayThreads == 1)? 0 : MESIBottomCC::parentIdHash(lineAddr, numBanks) % numReplayThreads;
+        }
+
+        void replayPhaseParallel();
+        static void ReplayThreadTrampoline(void* arg);
+        void replayThreadLoop(uint32_t thid);
 };
 
 
 class TraceDriverProxyCache : public BaseCache {
     private:
         TraceDriver* drv;
-        uint32_t id;
+        uint32_t id; //child id in the parents
+        uint32_t streamId; //child id in the trace
         g_string name;
-        MemObject* parent;
+        g_vector<MemObject*> parents;
     public:
-        TraceDriverProxyCache(g_string& _name) : drv(nullptr), id(-1), name(_name) {}
+        TraceDriverProxyCache(g_string& _name) : drv(nullptr), id(-1), streamId(-1), name(_name) {}
         const char* getName() {return name.c_str();}
 
-        void setParents(uint32_t _childId, const g_vector<MemObject*>& parents, Network* network) {id = _childId; assert(parents.size() == 1); parent = parents[0];}; //FIXME: Support multi-banked caches...
+        void setParents(uint32_t _childId, const g_vector<MemObject*>& _parents, Network* network) {id = _childId; parents = _parents; assert(parents.size() > 0);}
         void setChildren(const g_vector<BaseCache*>& children, Network* network) {panic("Should not be called, this must be terminal");};
 
-        MemObject* getParent() const {return parent;}
-        void setDriver(TraceDriver* driver) {drv = driver;}
+        const g_vector<MemObject*>& getParents() const {return parents;}
+        uint32_t getChildId() const {return id;}
+        void setDriver(TraceDriver* driver, uint32_t _streamId) {drv = driver; streamId = _streamId;}
 
         uint64_t access(MemReq& req) {panic("Should never be called");}
         uint64_t invalidate(const InvReq& req) {
-            return drv->invalidate(id, req.lineAddr, req.type, req.writeback, req.cycle, req.srcId);
+            return drv->invalidate(streamId, req.lineAddr, req.type, req.writeback, req.cycle, req.srcId);
         }
+
+        //Proxies hold no state, the driver checkpoints its children's lines
+        void saveState(CheckpointWriter& cw) {}
+        void loadState(CheckpointReader& cr) {}
 };
 
 #endif /*__TRACE_DRIVER_H__*/
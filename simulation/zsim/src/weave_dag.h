@@ -0,0 +1,63 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEAVE_DAG_H_
+#define WEAVE_DAG_H_
+
+/* Format of the weave-phase event DAG files written by WeaveProfiler and
+ * analyzed by weavedag. A file starts with WEAVE_DAG_MAGIC, the number of
+ * event types, and their names (uint32_t length + chars each), followed by
+ * WeaveDagRecords. Records are flushed per domain at the end of each phase,
+ * so they are not in order in the file; seq gives their global order.
+ *
+ * Events are identified by their address, which is only unique while the
+ * event is live: after its DONE record, the address may be reused by a new
+ * event. Edges are recorded when the parent is done, before the child can
+ * run, and crossings are recorded as an edge from their source-domain event
+ * (CrossingSrcEvent) to the CrossingEvent.
+ */
+
+#include <stdint.h>
+
+#define WEAVE_DAG_MAGIC 0x3167616465766177ul  // "wavedag1"
+
+enum WeaveDagRecordKind {
+    DAG_RUN,   // event simulated; arg = minStartCycle, cycle = start cycle (once per requeue)
+    DAG_EDGE,  // parent done; arg = child address, cycle = earliest start cycle of the child through this edge
+    DAG_DONE,  // event done (and freed); cycle = done cycle
+};
+
+struct WeaveDagRecord {
+    uint64_t seq;
+    uint64_t ev;
+    uint64_t arg;
+    uint64_t cycle;
+    uint8_t kind;  // WeaveDagRecordKind
+    uint8_t type;  // TimingEventType
+    uint16_t domain;
+    uint32_t pad;
+};
+
+#endif  // WEAVE_DAG_H_
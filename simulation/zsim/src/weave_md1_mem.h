@@ -40,7 +40,7 @@ class WeaveMemAccEvent : public TimingEvent {
         uint32_t lat;
 
     public:
-        WeaveMemAccEvent(uint32_t _lat, int32_t domain, uint32_t preDelay, uint32_t postDelay) :  TimingEvent(preDelay, postDelay, domain), lat(_lat) {}
+        WeaveMemAccEvent(uint32_t _lat, int32_t domain, uint32_t preDelay, uint32_t postDelay) :  TimingEvent(preDelay, postDelay, domain), lat(_lat) {setType(EVT_MEM_ACCESS);}
 
         void simulate(uint64_t startCycle) {
             done(startCycle + lat);
@@ -0,0 +1,105 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "weave_profiler.h"
+#include <string.h>
+#include "log.h"
+
+WeaveProfiler::WeaveProfiler(uint32_t _numDomains, uint64_t _dagStart, uint64_t _dagPhases, const char* _dagFile)
+    : numDomains(_numDomains), dagStart(_dagStart), dagEnd(_dagStart + _dagPhases), dagFile(_dagFile), dagOut(nullptr), dagRecordsWritten(0), dagSeq(0)
+{
+    doms = gm_calloc<DomainProf>(numDomains);
+    for (uint32_t i = 0; i < numDomains; i++) new (&doms[i].dagRecords) g_vector<WeaveDagRecord>();
+    zinfo->weaveDagActive = false;
+    if (dagStart < dagEnd) info("Weave profiler: recording event DAG of phases [%ld, %ld) to %s", dagStart, dagEnd, dagFile.c_str());
+}
+
+void WeaveProfiler::initStats(uint32_t domain, AggregateStat* domStat) {
+    DomainProf& dp = doms[domain];
+    new (&dp.typeCycles) VectorCounter();
+    new (&dp.typeRequeues) VectorCounter();
+    new (&dp.typeWaitCycles) VectorCounter();
+    new (&dp.crossingSlack) Counter();
+    dp.typeCycles.init("evTypeCycles", "Host cycles spent simulating each event type", EVT_NUM_TYPES, timingEventTypeNames);
+    dp.typeRequeues.init("evTypeRequeues", "Events requeued by type (crossings: polls of a stalled source domain)", EVT_NUM_TYPES, timingEventTypeNames);
+    dp.typeWaitCycles.init("evTypeWait", "Cycles events were pushed back by requeues, by type", EVT_NUM_TYPES, timingEventTypeNames);
+    dp.crossingSlack.init("xingSlack", "Pre+post slack of completed incoming crossings");
+    domStat->append(&dp.typeCycles);
+    domStat->append(&dp.typeRequeues);
+    domStat->append(&dp.typeWaitCycles);
+    domStat->append(&dp.crossingSlack);
+}
+
+void WeaveProfiler::startPhase(uint64_t phase) {
+    bool active = phase >= dagStart && phase < dagEnd;
+    if (active && !dagOut) {
+        dagOut = fopen(dagFile.c_str(), "w");
+        if (!dagOut) panic("Could not open %s for writing", dagFile.c_str());
+        uint64_t magic = WEAVE_DAG_MAGIC;
+        uint32_t numTypes = EVT_NUM_TYPES;
+        fwrite(&magic, sizeof(magic), 1, dagOut);
+        fwrite(&numTypes, sizeof(numTypes), 1, dagOut);
+        for (uint32_t t = 0; t < numTypes; t++) {
+            uint32_t len = strlen(timingEventTypeNames[t]);
+            fwrite(&len, sizeof(len), 1, dagOut);
+            fwrite(timingEventTypeNames[t], len, 1, dagOut);
+        }
+    }
+    zinfo->weaveDagActive = active;
+    __sync_synchronize();
+}
+
+void WeaveProfiler::endPhase() {
+    if (!zinfo->weaveDagActive) return;
+    zinfo->weaveDagActive = false;
+    for (uint32_t i = 0; i < numDomains; i++) {
+        g_vector<WeaveDagRecord>& recs = doms[i].dagRecords;
+        if (recs.empty()) continue;
+        if (fwrite(&recs[0], sizeof(WeaveDagRecord), recs.size(), dagOut) != recs.size()) panic("Error writing %s", dagFile.c_str());
+        dagRecordsWritten += recs.size();
+        recs.clear();
+    }
+    if (zinfo->numPhases + 1 >= dagEnd) finish();
+}
+
+void WeaveProfiler::finish() {
+    if (!dagOut) return;
+    fclose(dagOut);
+    dagOut = nullptr;
+    dagEnd = 0;  // done, don't reopen
+    info("Weave profiler: wrote %ld event DAG records to %s", dagRecordsWritten, dagFile.c_str());
+}
+
+void WeaveProfiler::recordRun(uint32_t domain, TimingEvent* ev, uint64_t cycle) {
+    record(domain, DAG_RUN, ev, ev->getMinStartCycle(), cycle);
+}
+
+void WeaveProfiler::recordEdge(uint32_t domain, TimingEvent* parent, TimingEvent* child, uint64_t cycle) {
+    record(domain, DAG_EDGE, parent, (uint64_t)child, cycle);
+}
+
+void WeaveProfiler::recordDone(uint32_t domain, TimingEvent* ev, uint64_t cycle) {
+    record(domain, DAG_DONE, ev, 0, cycle);
+}
@@ -0,0 +1,123 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WEAVE_PROFILER_H_
+#define WEAVE_PROFILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "g_std/g_string.h"
+#include "g_std/g_vector.h"
+#include "galloc.h"
+#include "pad.h"
+#include "stats.h"
+#include "timing_event.h"
+#include "weave_dag.h"
+#include "zsim.h"
+
+/* Opt-in weave-phase profiler (sim.profileWeave). Adds per-event-type stats
+ * to each domain: host cycles spent in simulate(), requeues and the simulated
+ * cycles they pushed events back by (i.e., contention at the component the
+ * event models; for crossings, cycles stalled on their source domain), plus
+ * the slack of completed crossings.
+ *
+ * It can also record the event DAG of a window of phases (sim.weaveDagStart,
+ * sim.weaveDagPhases) to a file (sim.weaveDagFile); the weavedag tool finds
+ * its critical path and most contended components. Per-domain hooks are only
+ * called by the thread simulating the domain, so they are unsynchronized.
+ */
+class WeaveProfiler : public GlobAlloc {
+    private:
+        struct DomainProf {
+            VectorCounter typeCycles;
+            VectorCounter typeRequeues;
+            VectorCounter typeWaitCycles;
+            Counter crossingSlack;
+            uint64_t runCycle;  // start cycle of the event being simulated
+            g_vector<WeaveDagRecord> dagRecords;  // current phase, flushed at its end
+            PAD();
+        };
+
+        DomainProf* doms;
+        uint32_t numDomains;
+
+        uint64_t dagStart, dagEnd;  // phases [dagStart, dagEnd) are recorded; empty range if disabled
+        g_string dagFile;
+        FILE* dagOut;
+        uint64_t dagRecordsWritten;
+        PAD();
+        volatile uint64_t dagSeq;
+        PAD();
+
+    public:
+        WeaveProfiler(uint32_t _numDomains, uint64_t _dagStart, uint64_t _dagPhases, const char* _dagFile);
+
+        void initStats(uint32_t domain, AggregateStat* domStat);
+
+        // Called by ContentionSim around the weave phase
+        void startPhase(uint64_t phase);
+        void endPhase();
+        void finish();
+
+        inline void eventRun(uint32_t domain, TimingEvent* ev, uint64_t cycle) {
+            doms[domain].runCycle = cycle;
+            if (unlikely(zinfo->weaveDagActive)) recordRun(domain, ev, cycle);
+        }
+
+        inline void eventSimulated(uint32_t domain, TimingEventType type, uint64_t hostCycles) {
+            doms[domain].typeCycles.inc(type, hostCycles);
+        }
+
+        inline void eventRequeued(uint32_t domain, TimingEventType type, uint64_t cycle) {
+            DomainProf& dp = doms[domain];
+            dp.typeRequeues.inc(type);
+            if (cycle > dp.runCycle) dp.typeWaitCycles.inc(type, cycle - dp.runCycle);
+        }
+
+        inline void crossingDone(uint32_t domain, uint32_t slack) {
+            doms[domain].crossingSlack.inc(slack);
+        }
+
+        // DAG recording, only called when zinfo->weaveDagActive is set
+        void recordRun(uint32_t domain, TimingEvent* ev, uint64_t cycle);
+        void recordEdge(uint32_t domain, TimingEvent* parent, TimingEvent* child, uint64_t cycle);
+        void recordDone(uint32_t domain, TimingEvent* ev, uint64_t cycle);
+
+    private:
+        inline void record(uint32_t domain, WeaveDagRecordKind kind, TimingEvent* ev, uint64_t arg, uint64_t cycle) {
+            WeaveDagRecord r;
+            r.seq = __sync_fetch_and_add(&dagSeq, 1);
+            r.ev = (uint64_t)ev;
+            r.arg = arg;
+            r.cycle = cycle;
+            r.kind = kind;
+            r.type = ev->getType();
+            r.domain = domain;
+            r.pad = 0;
+            doms[domain].dagRecords.push_back(r);
+        }
+};
+
+#endif  // WEAVE_PROFILER_H_
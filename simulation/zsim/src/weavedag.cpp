@@ -0,0 +1,251 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Analyzes a weave-phase event DAG recorded by WeaveProfiler (see
+ * weave_dag.h). Reports, for the recorded window:
+ *  - Events and runs per event type
+ *  - The most contended components (event type and domain), by the cycles
+ *    their events were pushed back by requeues (firstRun -> lastRun) and by
+ *    the cycles they waited to start since their last parent finished
+ *  - The critical path: the longest chain of latest-arriving parents that
+ *    ends in a finished event, with its cycles broken down by event type and
+ *    domain
+ */
+
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bithacks.h"
+#include "log.h"
+#include "weave_dag.h"
+
+using namespace std;
+
+struct DagNode {
+    uint64_t ev;
+    uint32_t type;
+    uint32_t domain;
+    int64_t pred;  // latest-arriving parent, -1 if none (queued directly)
+    uint64_t ready;  // cycle the latest parent allowed us to start at (valid if pred != -1)
+    uint64_t firstRun;
+    uint64_t lastRun;
+    uint64_t runs;
+    uint64_t done;  // valid if isDone
+    bool isDone;
+
+    // Cycle the event became ready: when its last parent finished, or its first run if it was queued directly
+    uint64_t start() const {
+        return (pred != -1)? ready : (runs? firstRun : done);
+    }
+};
+
+struct ComponentSummary {
+    uint64_t events;
+    uint64_t runs;
+    uint64_t requeueCycles;
+    uint64_t waitCycles;
+    uint64_t pathEvents;
+    uint64_t pathCycles;
+    ComponentSummary() : events(0), runs(0), requeueCycles(0), waitCycles(0), pathEvents(0), pathCycles(0) {}
+};
+
+static void readOrDie(void* buf, size_t sz, FILE* f, const char* fname) {
+    if (fread(buf, sz, 1, f) != 1) panic("%s is truncated", fname);
+}
+
+int main(int argc, const char* argv[]) {
+    InitLog(""); //no log header
+    if (argc < 2 || argc > 3) {
+        info("Finds the critical path and most contended components of a weave-phase event DAG");
+        info("Usage: %s <dag_file> [top_entries]", argv[0]);
+        exit(1);
+    }
+    const char* fname = argv[1];
+    uint32_t topEntries = (argc > 2)? strtoul(argv[2], nullptr, 0) : 10;
+
+    FILE* f = fopen(fname, "r");
+    if (!f) panic("Could not open %s", fname);
+    uint64_t magic;
+    readOrDie(&magic, sizeof(magic), f, fname);
+    if (magic != WEAVE_DAG_MAGIC) panic("%s is not a weave DAG file", fname);
+    uint32_t numTypes;
+    readOrDie(&numTypes, sizeof(numTypes), f, fname);
+    vector<string> typeNames;
+    for (uint32_t t = 0; t < numTypes; t++) {
+        uint32_t len;
+        readOrDie(&len, sizeof(len), f, fname);
+        string name(len, ' ');
+        if (len) readOrDie(&name[0], len, f, fname);
+        typeNames.push_back(name);
+    }
+
+    vector<WeaveDagRecord> recs;
+    WeaveDagRecord r;
+    while (fread(&r, sizeof(r), 1, f) == 1) recs.push_back(r);
+    fclose(f);
+    // Files are written per domain and phase; replay records in the order they happened
+    sort(recs.begin(), recs.end(), [](const WeaveDagRecord& a, const WeaveDagRecord& b) { return a.seq < b.seq; });
+    info("Read %ld records, %d event types", recs.size(), numTypes);
+
+    // Rebuild event instances; addresses are only unique while events are live
+    vector<DagNode> nodes;
+    unordered_map<uint64_t, uint64_t> liveNodes;
+    uint32_t maxDomain = 0;
+    auto getNode = [&](uint64_t ev) -> uint64_t {
+        auto it = liveNodes.find(ev);
+        if (it != liveNodes.end()) return it->second;
+        DagNode n = {ev, 0, 0, -1, 0, 0, 0, 0, 0, false};
+        nodes.push_back(n);
+        liveNodes[ev] = nodes.size() - 1;
+        return nodes.size() - 1;
+    };
+
+    for (const WeaveDagRecord& rec : recs) {
+        if (rec.type >= numTypes) panic("Record %ld has invalid event type %d", rec.seq, rec.type);
+        maxDomain = max(maxDomain, (uint32_t)rec.domain);
+        uint64_t idx = getNode(rec.ev);
+        DagNode& n = nodes[idx];
+        n.type = rec.type;
+        n.domain = rec.domain;
+        switch (rec.kind) {
+            case DAG_RUN:
+                if (!n.runs) n.firstRun = rec.cycle;
+                n.lastRun = rec.cycle;
+                n.runs++;
+                break;
+            case DAG_EDGE:
+                {
+                    uint64_t c = getNode(rec.arg);  // NOTE: may reallocate nodes
+                    DagNode& child = nodes[c];
+                    if (child.pred == -1 || rec.cycle >= child.ready) {
+                        child.pred = idx;
+                        child.ready = rec.cycle;
+                    }
+                }
+                break;
+            case DAG_DONE:
+                n.done = rec.cycle;
+                n.isDone = true;
+                liveNodes.erase(rec.ev);
+                break;
+            default:
+                panic("Record %ld has invalid kind %d", rec.seq, rec.kind);
+        }
+    }
+    uint32_t numDomains = maxDomain + 1;
+
+    // Per-component (type x domain) summary
+    vector<ComponentSummary> comps(numTypes*numDomains);
+    vector<uint64_t> typeEvents(numTypes, 0), typeRuns(numTypes, 0);
+    for (uint64_t i = 0; i < nodes.size(); i++) {
+        const DagNode& n = nodes[i];
+        ComponentSummary& cs = comps[n.type*numDomains + n.domain];
+        cs.events++;
+        cs.runs += n.runs;
+        typeEvents[n.type]++;
+        typeRuns[n.type] += n.runs;
+        if (n.runs) {
+            cs.requeueCycles += n.lastRun - n.firstRun;
+            if (n.pred != -1 && n.firstRun > n.ready) cs.waitCycles += n.firstRun - n.ready;
+        }
+    }
+
+    // Find where each event's chain of latest-arriving parents starts. Parents
+    // may have higher indexes than their children, so walk chains explicitly
+    // (iteratively, as they can be very long), memoizing their starts
+    const uint64_t UNKNOWN = (uint64_t)-1L;
+    vector<uint64_t> chainStart(nodes.size(), UNKNOWN);
+    vector<uint64_t> chain;
+    for (uint64_t i = 0; i < nodes.size(); i++) {
+        int64_t cur = i;
+        while (cur != -1 && chainStart[cur] == UNKNOWN) {
+            chain.push_back(cur);
+            cur = nodes[cur].pred;
+        }
+        uint64_t s = (cur == -1)? UNKNOWN : chainStart[cur];
+        while (!chain.empty()) {
+            uint64_t c = chain.back();
+            chain.pop_back();
+            s = MIN(s, nodes[c].start());
+            chainStart[c] = s;
+        }
+    }
+    int64_t last = -1;
+    for (uint64_t i = 0; i < nodes.size(); i++) {
+        const DagNode& n = nodes[i];
+        if (n.isDone && (last == -1 || n.done - chainStart[i] > nodes[last].done - chainStart[last])) last = i;
+    }
+
+    info("Events by type (events / runs):");
+    for (uint32_t t = 0; t < numTypes; t++) {
+        if (typeEvents[t]) info("  %16s %12ld %12ld", typeNames[t].c_str(), typeEvents[t], typeRuns[t]);
+    }
+    info("%ld events, %ld still live at the end of the window", nodes.size(), liveNodes.size());
+
+    vector<uint32_t> order;
+    for (uint32_t i = 0; i < comps.size(); i++) if (comps[i].events) order.push_back(i);
+    auto printComponents = [&](const char* title, uint64_t ComponentSummary::*key) {
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return comps[a].*key > comps[b].*key; });
+        info("%s (type @ domain: events, requeue cycles, wait cycles, path events, path cycles):", title);
+        for (uint32_t i = 0; i < MIN((uint32_t)order.size(), topEntries); i++) {
+            const ComponentSummary& cs = comps[order[i]];
+            if (!(cs.*key)) break;
+            info("  %16s @ %3d: %10ld %12ld %12ld %10ld %12ld", typeNames[order[i] / numDomains].c_str(), order[i] % numDomains,
+                    cs.events, cs.requeueCycles, cs.waitCycles, cs.pathEvents, cs.pathCycles);
+        }
+    };
+
+    // Critical path: walk back from its last event. Each event on the path is
+    // charged the cycles from when it became ready to when its successor
+    // became ready (or, for the last one, to when it finished).
+    if (last == -1) {
+        info("No events finished in the window, no critical path");
+    } else {
+        uint64_t pathLen = 0;
+        uint64_t endCycle = nodes[last].done;
+        uint64_t succStart = endCycle;
+        int64_t cur = last;
+        uint64_t startCycle = endCycle;
+        while (cur != -1) {
+            const DagNode& n = nodes[cur];
+            uint64_t s = n.start();
+            ComponentSummary& cs = comps[n.type*numDomains + n.domain];
+            cs.pathEvents++;
+            cs.pathCycles += (succStart > s)? succStart - s : 0;
+            succStart = s;
+            startCycle = MIN(startCycle, s);
+            pathLen++;
+            cur = n.pred;
+        }
+        info("Critical path: %ld events, cycles %ld -> %ld (%ld cycles)", pathLen, startCycle, endCycle, endCycle - startCycle);
+        printComponents("Critical path by component", &ComponentSummary::pathCycles);
+    }
+    printComponents("Most contended components", &ComponentSummary::requeueCycles);
+    printComponents("Components with the longest start waits", &ComponentSummary::waitCycles);
+    return 0;
+}
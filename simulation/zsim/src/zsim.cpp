@@ -43,17 +43,20 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include "access_tracing.h"
+#include "checkpoint.h"
 #include "constants.h"
 #include "contention_sim.h"
 #include "core.h"
 #include "cpuenum.h"
 #include "cpuid.h"
 #include "debug_zsim.h"
+#include "domain_map.h"
 #include "event_queue.h"
 #include "galloc.h"
 #include "init.h"
 #include "log.h"
 #include "pin.H"
+#include "phase_controller.h"
 #include "pin_cmd.h"
 #include "process_tree.h"
 #include "profile_stats.h"
@@ -301,7 +304,7 @@ VOID FFITrackNFFInterval() {
         *_ffiPrevFFStartInstrs = *_ffiFFStartInstrs;
         *_ffiFFStartInstrs = zinfo->processStats->getProcessInstrs(p);
     };
-    zinfo->eventQueue->insert(makeAdaptiveEvent(ffiGet, ffiFire, 0, ffiInstrsLimit - ffiInstrsDone, MAX_IPC*zinfo->phaseLength));
+    zinfo->eventQueue->insert(makeAdaptiveEvent(ffiGet, ffiFire, 0, ffiInstrsLimit - ffiInstrsDone, MAX_IPC*zinfo->maxPhaseLength));
 
     ffiNFF = true;
 }
@@ -492,6 +495,9 @@ VOID EndOfPhaseActions() {
     CheckForTermination();
     zinfo->contentionSim->simulatePhase(zinfo->globPhaseCycles + zinfo->phaseLength);
     zinfo->eventQueue->tick();
+    if (zinfo->checkpointer) zinfo->checkpointer->endOfPhase();
+    zinfo->domainMapper->endOfPhase();
+    if (zinfo->phaseController) zinfo->phaseController->endOfPhase();
     zinfo->profSimTime->transition(PROF_BOUND);
 }
 
@@ -1561,6 +1567,7 @@ int main(int argc, char *argv[]) {
             EndOfPhaseActions();
             zinfo->numPhases++;
             zinfo->globPhaseCycles += zinfo->phaseLength;
+            zinfo->phaseLength = zinfo->nextPhaseLength;
         }
         info("Finished trace-driven simulation");
         SimEnd();
@@ -48,6 +48,10 @@ class PortVirtualizer;
 class VectorCounter;
 class AccessTraceWriter;
 class TraceDriver;
+class Checkpointer;
+class DomainMapper;
+class WeaveProfiler;
+class PhaseLengthController;
 template <typename T> class g_vector;
 
 struct ClockDomainInfo {
@@ -88,12 +92,19 @@ struct GlobSimInfo {
     //Contention simulation
     uint32_t numDomains;
     ContentionSim* contentionSim;
+    DomainMapper* domainMapper;
+    WeaveProfiler* weaveProfiler; //nullptr unless sim.profileWeave
+    bool analyticalContention; //if set, there is no weave phase; memory components estimate queueing delays in the bound phase
+    volatile bool weaveDagActive; //set during the weave phases whose event DAG is recorded
     EventRecorder** eventRecorders; //CID->EventRecorder* array
 
     PAD();
 
     //World-readable
-    uint32_t phaseLength;
+    uint32_t phaseLength; //of the current phase; only changes across phases if sim.adaptivePhaseLength is set
+    uint32_t nextPhaseLength; //phaseLength takes this value at the end of every phase
+    uint32_t maxPhaseLength; //upper bound on phaseLength
+    PhaseLengthController* phaseController; //nullptr unless sim.adaptivePhaseLength
     uint32_t statsPhaseInterval;
     uint32_t freqMHz;
 
@@ -181,6 +192,9 @@ struct GlobSimInfo {
     // Trace-driven simulation (no cores)
     bool traceDriven;
     TraceDriver* traceDriver;
+
+    // Warm-up checkpoints (always present, saves only if configured to)
+    Checkpointer* checkpointer;
 };
 
 
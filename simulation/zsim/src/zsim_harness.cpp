@@ -202,7 +202,7 @@ static time_t lastHeartbeatTime;
 static uint64_t lastCycles = 0;
 
 static void printHeartbeat(GlobSimInfo* zinfo) {
-    uint64_t cycles = zinfo->numPhases*zinfo->phaseLength;
+    uint64_t cycles = zinfo->globPhaseCycles;
     time_t curTime = time(nullptr);
     time_t elapsedSecs = curTime - startTime;
     time_t heartbeatSecs = curTime - lastHeartbeatTime;